@@ -1,5 +1,9 @@
 ﻿#include <iostream>         // cout, cerr
 #include <cstdlib>          // EXIT_FAILURE
+#include <vector>
+#include <cstring>          // strcmp
+#include <cstdio>           // sscanf
+#include <thread>           // hardware_concurrency
 #include <GL/glew.h>        // GLEW library
 #include <GLFW/glfw3.h>     // GLFW library
 
@@ -12,6 +16,25 @@
 #include "stb_image.h"      // Image loading Utility functions
 
 #include "meshes.h"
+#include "uniforms.h"
+#include "scene.h"
+#include "scenegraph.h"
+#include "culling.h"
+#include "bvh.h"
+#include "occlusion.h"
+#include "softocclusion.h"
+#include "lod.h"
+#include "frametiming.h"
+#include "camerapath.h"
+#include "benchreport.h"
+#include "gpuprofiler.h"
+#include "headless.h"
+#include "glstate.h"
+#include "textureatlas.h"
+#include "texturearray.h"
+#include "renderqueue.h"
+#include "shaderblocks.h"
+#include "workerpool.h"
 
 #include "camera.h"
 
@@ -28,29 +51,137 @@ namespace
 	const int WINDOW_WIDTH = 1600;
 	const int WINDOW_HEIGHT = 900;
 
-	// Main GLFW window
+	// Main GLFW window, null in headless runs
 	GLFWwindow* gWindow = nullptr;
+	// Size of the window, or of the offscreen target, in pixels
+	int gViewportWidth = WINDOW_WIDTH;
+	int gViewportHeight = WINDOW_HEIGHT;
+	// Framebuffer object drawn into when there is no window
+	OffscreenTarget gOffscreen;
 	// Shader program
 	GLuint gProgramId1;
 	GLuint gProgramId2;
-	// Texture Ids
-	GLuint gTextureId; //brick (unused)
-	GLuint gTextureId2; // aluminum
-	GLuint gTextureId3; //black stripes (cap)
-	GLuint gTextureId4; //red + white pattern for trimmer line
-	GLuint gTextureId5; //label for trimmer spool
-	GLuint gTextureId6; //gas can label
-	GLuint gTextureId7; //chainsaw
-	GLuint gTextureId8; //concrete
-	GLuint gTextureId9; //red for trimmer box (substitute for untextured)
+	// Uniform locations resolved when the program is linked
+	UniformLayout gUniforms1;
+	UniformLayout gUniforms2;
+	// Depth-only versions of both programs, drawn first while the depth pre-pass is on
+	GLuint gDepthProgramId1;
+	GLuint gDepthProgramId2;
+	UniformLayout gDepthUniforms1;
+	UniformLayout gDepthUniforms2;
+	// Persistently mapped per-frame data: the FrameBlock, object entries and indirect commands
+	RingBuffer gRingBuffer;
+	const int RING_ALLOCATIONS_PER_FRAME = 3;
+	// Layers of the scene texture array, the files of TEXTURE_FILES then the label atlas
+	enum TextureLayer
+	{
+		LAYER_BRICK,        //brick (unused)
+		LAYER_ALUMINUM,     // aluminum
+		LAYER_TRIMMER_LINE, //red + white pattern for trimmer line
+		LAYER_CONCRETE,     //concrete
+		LAYER_RED,          //red for trimmer box (substitute for untextured)
+		LAYER_LABELS,       //atlas of the ATLAS_FILES images
+		TEXTURE_LAYERS
+	};
+	const char* const TEXTURE_FILES[LAYER_LABELS] =
+	{
+		"Brick.jpg", "alum.jpg", "red+white.jpg", "concrete.jpg", "red.jpg"
+	};
+	// Images of the label atlas, in the order of ATLAS_FILES
+	enum AtlasImage
+	{
+		ATLAS_CAP,          //black stripes (cap)
+		ATLAS_SPOOL_LABEL,  //label for trimmer spool
+		ATLAS_GAS_CAN,      //gas can label
+		ATLAS_CHAINSAW,     //chainsaw
+		ATLAS_IMAGES
+	};
+	const char* const ATLAS_FILES[ATLAS_IMAGES] =
+	{
+		"capTex.jpg", "spool_top.jpg", "gasCan.jpg", "chainsaw1.jpg"
+	};
+	// Labels packed into LAYER_LABELS, objects pick their image with its UV rect
+	TextureAtlas gLabelAtlas;
+	// Every scene texture, so one bind serves all the draws of a frame
+	GLuint gTextureArray;
+	// Fallback for drivers without fast texture arrays: each layer as a plain GL_TEXTURE_2D
+	bool gTextureArrayEnabled = true;
+	GLuint gLayerTextures[TEXTURE_LAYERS];
 
 	Meshes meshes;
 
+	// Objects drawn every frame, in draw order
+	std::vector<SceneObject> gScene;
+	// Transform hierarchy placing the objects of gScene
+	SceneGraph gSceneGraph;
+	// Sorted draws of the current frame
+	RenderQueue gRenderQueue;
+	bool gRenderStatsReported = false;
+	// World matrices rebuilt during the last frame, zero while nothing moves
+	unsigned int gMatricesRecomputed = 0;
+
+	// World bounding spheres of gScene, tested against the view frustum
+	FrustumCuller gCuller;
+	// Hierarchy over the world boxes of gScene, used instead of the flat test when enabled
+	Bvh gBvh;
+	std::vector<glm::vec3> gWorldBoundsMin;
+	std::vector<glm::vec3> gWorldBoundsMax;
+	bool gBvhEnabled = true;
+	size_t gBvhNodesVisited = 0;
+	std::vector<unsigned char> gVisible;
+	bool gCullingEnabled = true;
+	size_t gVisibleCount = 0;
+	size_t gCulledCount = 0;
+	// Hi-Z test of the multi-draw commands against last frame's depth
+	OcclusionCuller gOcclusion;
+	// Occluders rasterized on the CPU, tested on a worker thread while the queue is built
+	SoftwareOcclusion gSoftwareOcclusion;
+	size_t gSoftwareOccludedCount = 0;
+	// Detail level of the cylinders, cones and tori from their size on screen
+	LodSelector gLodSelector;
+	// Job system running the per-object frame stages, T switches them to the render thread
+	WorkerPool gWorkerPool;
+	bool gParallelFrame = true;
+
+	// Number of extra shelf units (a box with a gas can on top) added behind the set
+	int gShelfUnits = 0;
+
+	// Benchmark run: vsync off, stop after a number of frames or seconds and print the frame times
+	const int BENCHMARK_WARMUP_FRAMES = 30;
+	int gBenchmarkFrames = 0;
+	double gBenchmarkSeconds = 0.0;
+	int gWarmupFrames = 0;
+	// Frame times since the start of the run, or of the benchmark, or since F was last pressed
+	FrameTimer gFrameTimer;
+	// Camera replayed by benchmark runs, one fixed simulated step per frame whatever the frame time
+	const float BENCHMARK_TIMESTEP = 1.0f / 60.0f;
+	CameraPath gCameraPath;
+	bool gCameraPathLoaded = false;
+	// Counters of the measured frames, written as JSON at the end of the benchmark
+	BenchmarkReport gBenchmarkReport;
+	// Optional cap on the interactive frame rate
+	FrameLimiter gFrameLimiter;
+	// GPU and CPU time of the passes of Render() and of every draw batch
+	GpuProfiler gProfiler;
+
 	Camera gCamera(glm::vec3(-20.0f, 50.0f, 50.0f));
 	GLint gCurrentCameraIndex = 1;
 
-	float gDeltaTime = 0.0f; // Time between current frame and last frame
-	float gLastFrame = 0.0f;
+	// Interactive camera, moved by fixed simulation steps and drawn between its last two states
+	const double SIMULATION_RATE = 120.0;
+	FixedTimestep gSimulation;
+	struct CameraState
+	{
+		glm::vec3 position;
+		float yaw;
+		float pitch;
+	};
+	CameraState gPreviousCamera;
+	// Camera the frame is drawn from
+	Camera gViewCamera = gCamera;
+	// Mouse movement since the last step, applied by the next one
+	float gMouseOffsetX = 0.0f;
+	float gMouseOffsetY = 0.0f;
 
 	float gLastX = WINDOW_WIDTH / 2.0f;
 	float gLastY = WINDOW_HEIGHT / 2.0f;
@@ -60,14 +191,19 @@ namespace
 // User-defined Function prototypes //
 bool Initialize(int, char* [], GLFWwindow** window);
 void ProcessInput(GLFWwindow* window);
+void SimulateStep(GLFWwindow* window);
 void Render();
-bool CreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+void CreateScene();
+void CreateShelfScene(int units);
+void SetFrameData(FrameData& frame, const glm::mat4& view, const glm::mat4& projection);
+bool CreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId, UniformLayout& uniforms);
 void DestroyShaderProgram(GLuint programId);
 bool CreateTexture(const char* filename, GLuint& textureId);
 void DestroyTexture(GLuint textureId);
 void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
 void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 void UMouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+void UKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
 // Shader program Macro //
 #ifndef GLSL
@@ -85,11 +221,24 @@ layout(location = 2) in vec2 textureCoordinate;
 out vec3 vertexFragmentNormal; // For outgoing normals to fragment shader
 out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
 out vec2 vertexTextureCoordinate;
+invariant gl_Position; // Same depth as the depth pre-pass, which the GL_EQUAL test needs
 
 //Uniform / Global variables for the  transform matrices
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform vec4 uvScale; // Image of the object inside its texture layer, scale in xy and offset in zw
+
+//Per-frame block shared by every program, see FrameData
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 light1Color;
+	vec4 light1Position;
+	vec4 light2Color;
+	vec4 light2Position;
+	vec4 viewPosition;
+	vec4 ambient; // rgb color, a strength
+};
 
 void main()
 {
@@ -98,7 +247,7 @@ void main()
 	vertexFragmentPos = vec3(model * vec4(vertexPosition, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
 
 	vertexFragmentNormal = mat3(transpose(inverse(model))) * vertexNormal; // get normal vectors in world space only and exclude normal translation properties
-	vertexTextureCoordinate = textureCoordinate;
+	vertexTextureCoordinate = textureCoordinate * uvScale.xy + uvScale.zw; // Region of the texture holding the image of the object
 }
 );
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -112,18 +261,24 @@ in vec2 vertexTextureCoordinate;
 
 out vec4 fragmentColor; // For outgoing cube color to the GPU
 
-// Uniform / Global variables for object color, light color, light position, and camera/view position
+//Per-frame block shared by every program, see FrameData
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 light1Color;
+	vec4 light1Position;
+	vec4 light2Color;
+	vec4 light2Position;
+	vec4 viewPosition;
+	vec4 ambient; // rgb color, a strength
+};
+
+// Uniform / Global variables for object color and material, lights and camera come from the frame block
 uniform vec4 objectColor;
-uniform vec3 ambientColor;
-uniform vec3 light1Color;
-uniform vec3 light1Position;
-uniform vec3 light2Color;
-uniform vec3 light2Position;
-uniform vec3 viewPosition;
-uniform sampler2D uTexture; // Useful when working with multiple textures
-uniform vec2 uvScale;
+uniform sampler2DArray uTexture; // Every scene texture, one per layer
+uniform int uTextureLayer;
 uniform bool ubHasTexture;
-uniform float ambientStrength; // Set ambient or global lighting strength
 uniform float specularIntensity1;
 uniform float highlightSize1;
 uniform float specularIntensity2;
@@ -134,43 +289,43 @@ void main()
 	/*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
 
 	//Calculate Ambient lighting
-	vec3 ambient = ambientStrength * ambientColor; // Generate ambient light color
+	vec3 ambientLight = ambient.a * ambient.rgb; // Generate ambient light color
 
 	//**Calculate Diffuse lighting**
 	vec3 norm = normalize(vertexFragmentNormal); // Normalize vectors to 1 unit
-	vec3 light1Direction = normalize(light1Position - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+	vec3 light1Direction = normalize(light1Position.xyz - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
 	float impact1 = max(dot(norm, light1Direction), 0.0);// Calculate diffuse impact by generating dot product of normal and light
-	vec3 diffuse1 = impact1 * light1Color; // Generate diffuse light color
-	vec3 light2Direction = normalize(light2Position - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+	vec3 diffuse1 = impact1 * light1Color.rgb; // Generate diffuse light color
+	vec3 light2Direction = normalize(light2Position.xyz - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
 	float impact2 = max(dot(norm, light2Direction), 0.0);// Calculate diffuse impact by generating dot product of normal and light
-	vec3 diffuse2 = impact2 * light2Color; // Generate diffuse light color
+	vec3 diffuse2 = impact2 * light2Color.rgb; // Generate diffuse light color
 
 	//**Calculate Specular lighting**
-	vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
+	vec3 viewDir = normalize(viewPosition.xyz - vertexFragmentPos); // Calculate view direction
 	vec3 reflectDir1 = reflect(-light1Direction, norm);// Calculate reflection vector
 	//Calculate specular component
 	float specularComponent1 = pow(max(dot(viewDir, reflectDir1), 0.0), highlightSize1);
-	vec3 specular1 = specularIntensity1 * specularComponent1 * light1Color;
+	vec3 specular1 = specularIntensity1 * specularComponent1 * light1Color.rgb;
 	vec3 reflectDir2 = reflect(-light2Direction, norm);// Calculate reflection vector
 	//Calculate specular component
 	float specularComponent2 = pow(max(dot(viewDir, reflectDir2), 0.0), highlightSize2);
-	vec3 specular2 = specularIntensity2 * specularComponent2 * light2Color;
+	vec3 specular2 = specularIntensity2 * specularComponent2 * light2Color.rgb;
 
 	//**Calculate phong result**
 	//Texture holds the color to be used for all three components
-	vec4 textureColor = texture(uTexture, vertexTextureCoordinate * uvScale);
+	vec4 textureColor = texture(uTexture, vec3(vertexTextureCoordinate, uTextureLayer));
 	vec3 phong1;
 	vec3 phong2;
 
 	if (ubHasTexture == true)
 	{
-		phong1 = (ambient + diffuse1 + specular1) * textureColor.xyz;
-		phong2 = (ambient + diffuse2 + specular2) * textureColor.xyz;
+		phong1 = (ambientLight + diffuse1 + specular1) * textureColor.xyz;
+		phong2 = (ambientLight + diffuse2 + specular2) * textureColor.xyz;
 	}
 	else
 	{
-		phong1 = (ambient + diffuse1 + specular1) * objectColor.xyz;
-		phong2 = (ambient + diffuse2 + specular2) * objectColor.xyz;
+		phong1 = (ambientLight + diffuse1 + specular1) * objectColor.xyz;
+		phong2 = (ambientLight + diffuse2 + specular2) * objectColor.xyz;
 	}
 
 	fragmentColor = vec4(phong1 + phong2, 1.0); // Send lighting results to GPU
@@ -179,18 +334,542 @@ void main()
 );
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Instanced Vertex Shader Source Code*/
+const GLchar* vertexShaderSource2 = GLSL(440,
+
+	layout(location = 0) in vec3 vertexPosition; // VAP position 0 for vertex position data
+layout(location = 1) in vec3 vertexNormal; // VAP position 1 for normals
+layout(location = 2) in vec2 textureCoordinate;
+layout(location = 3) in uint drawId; // Per-instance index into the object buffer (baseInstance + gl_InstanceID)
+
+out vec3 vertexFragmentNormal; // For outgoing normals to fragment shader
+out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
+out vec2 vertexTextureCoordinate;
+flat out vec4 vertexSpecular; // specularIntensity1, highlightSize1, specularIntensity2, highlightSize2
+flat out vec4 vertexObjectColor; // objectColor.rgb, texture layer or -1
+invariant gl_Position; // Same depth as the depth pre-pass, which the GL_EQUAL test needs
+
+//Per-frame block shared by every program, see FrameData
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 light1Color;
+	vec4 light1Position;
+	vec4 light2Color;
+	vec4 light2Position;
+	vec4 viewPosition;
+	vec4 ambient; // rgb color, a strength
+};
+
+//Per-object block written by the render queue, see ObjectData
+struct ObjectData
+{
+	mat4 model;
+	vec4 specular; // specularIntensity1, highlightSize1, specularIntensity2, highlightSize2
+	vec4 color; // objectColor.rgb, texture layer or -1
+	vec4 uvScale; // Image of the object inside its texture layer, scale in xy and offset in zw
+	vec4 boundsMin; // Mesh space box, read by the occlusion test
+	vec4 boundsMax;
+};
+layout(std430, binding = 1) readonly buffer ObjectBlock
+{
+	ObjectData objects[];
+};
+//Object buffer entry of each instance slot, compacted when occlusion culling runs
+layout(std430, binding = 2) readonly buffer VisibleBlock
+{
+	uint visibleObjects[];
+};
+
+void main()
+{
+	uint object = visibleObjects[drawId];
+	mat4 model = objects[object].model;
+	gl_Position = projection * view * model * vec4(vertexPosition, 1.0f); // Transforms vertices into clip coordinates
+
+	vertexFragmentPos = vec3(model * vec4(vertexPosition, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
+
+	vertexFragmentNormal = mat3(transpose(inverse(model))) * vertexNormal; // get normal vectors in world space only and exclude normal translation properties
+	vec4 uvScale = objects[object].uvScale;
+	vertexTextureCoordinate = textureCoordinate * uvScale.xy + uvScale.zw; // Region of the texture holding the image of the object
+
+	vertexSpecular = objects[object].specular;
+	vertexObjectColor = objects[object].color;
+}
+);
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Instanced Fragment Shader Source Code*/
+const GLchar* fragmentShaderSource2 = GLSL(440,
+
+	in vec3 vertexFragmentNormal; // For incoming normals
+in vec3 vertexFragmentPos; // For incoming fragment position
+in vec2 vertexTextureCoordinate;
+flat in vec4 vertexSpecular; // Material of this instance
+flat in vec4 vertexObjectColor;
+
+out vec4 fragmentColor; // For outgoing cube color to the GPU
+
+//Per-frame block shared by every program, see FrameData
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 light1Color;
+	vec4 light1Position;
+	vec4 light2Color;
+	vec4 light2Position;
+	vec4 viewPosition;
+	vec4 ambient; // rgb color, a strength
+};
+
+// Uniform / Global variables, lights and camera come from the frame block
+uniform sampler2DArray uTexture; // Every scene texture, one per layer
+
+void main()
+{
+	/*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
+
+	//Calculate Ambient lighting
+	vec3 ambientLight = ambient.a * ambient.rgb; // Generate ambient light color
+
+	//**Calculate Diffuse lighting**
+	vec3 norm = normalize(vertexFragmentNormal); // Normalize vectors to 1 unit
+	vec3 light1Direction = normalize(light1Position.xyz - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+	float impact1 = max(dot(norm, light1Direction), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+	vec3 diffuse1 = impact1 * light1Color.rgb; // Generate diffuse light color
+	vec3 light2Direction = normalize(light2Position.xyz - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+	float impact2 = max(dot(norm, light2Direction), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+	vec3 diffuse2 = impact2 * light2Color.rgb; // Generate diffuse light color
+
+	//**Calculate Specular lighting**
+	vec3 viewDir = normalize(viewPosition.xyz - vertexFragmentPos); // Calculate view direction
+	vec3 reflectDir1 = reflect(-light1Direction, norm);// Calculate reflection vector
+	//Calculate specular component
+	float specularComponent1 = pow(max(dot(viewDir, reflectDir1), 0.0), vertexSpecular.y);
+	vec3 specular1 = vertexSpecular.x * specularComponent1 * light1Color.rgb;
+	vec3 reflectDir2 = reflect(-light2Direction, norm);// Calculate reflection vector
+	//Calculate specular component
+	float specularComponent2 = pow(max(dot(viewDir, reflectDir2), 0.0), vertexSpecular.w);
+	vec3 specular2 = vertexSpecular.z * specularComponent2 * light2Color.rgb;
+
+	//**Calculate phong result**
+	//Texture holds the color to be used for all three components
+	vec4 textureColor = texture(uTexture, vec3(vertexTextureCoordinate, max(vertexObjectColor.w, 0.0)));
+	vec3 phong1;
+	vec3 phong2;
+
+	if (vertexObjectColor.w >= 0.0)
+	{
+		phong1 = (ambientLight + diffuse1 + specular1) * textureColor.xyz;
+		phong2 = (ambientLight + diffuse2 + specular2) * textureColor.xyz;
+	}
+	else
+	{
+		phong1 = (ambientLight + diffuse1 + specular1) * vertexObjectColor.xyz;
+		phong2 = (ambientLight + diffuse2 + specular2) * vertexObjectColor.xyz;
+	}
+
+	fragmentColor = vec4(phong1 + phong2, 1.0); // Send lighting results to GPU
+}
+);
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Fragment Shader Source Code sampling a plain GL_TEXTURE_2D, used when texture arrays are off*/
+const GLchar* texture2DFragmentShaderSource1 = GLSL(440,
+
+	in vec3 vertexFragmentNormal; // For incoming normals
+in vec3 vertexFragmentPos; // For incoming fragment position
+in vec2 vertexTextureCoordinate;
+
+out vec4 fragmentColor; // For outgoing cube color to the GPU
+
+//Per-frame block shared by every program, see FrameData
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 light1Color;
+	vec4 light1Position;
+	vec4 light2Color;
+	vec4 light2Position;
+	vec4 viewPosition;
+	vec4 ambient; // rgb color, a strength
+};
+
+// Uniform / Global variables for object color and material, lights and camera come from the frame block
+uniform vec4 objectColor;
+uniform sampler2D uTexture; // Texture of the object, the labels share the atlas
+uniform bool ubHasTexture;
+uniform float specularIntensity1;
+uniform float highlightSize1;
+uniform float specularIntensity2;
+uniform float highlightSize2;
+
+void main()
+{
+	/*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
+
+	//Calculate Ambient lighting
+	vec3 ambientLight = ambient.a * ambient.rgb; // Generate ambient light color
+
+	//**Calculate Diffuse lighting**
+	vec3 norm = normalize(vertexFragmentNormal); // Normalize vectors to 1 unit
+	vec3 light1Direction = normalize(light1Position.xyz - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+	float impact1 = max(dot(norm, light1Direction), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+	vec3 diffuse1 = impact1 * light1Color.rgb; // Generate diffuse light color
+	vec3 light2Direction = normalize(light2Position.xyz - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+	float impact2 = max(dot(norm, light2Direction), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+	vec3 diffuse2 = impact2 * light2Color.rgb; // Generate diffuse light color
+
+	//**Calculate Specular lighting**
+	vec3 viewDir = normalize(viewPosition.xyz - vertexFragmentPos); // Calculate view direction
+	vec3 reflectDir1 = reflect(-light1Direction, norm);// Calculate reflection vector
+	//Calculate specular component
+	float specularComponent1 = pow(max(dot(viewDir, reflectDir1), 0.0), highlightSize1);
+	vec3 specular1 = specularIntensity1 * specularComponent1 * light1Color.rgb;
+	vec3 reflectDir2 = reflect(-light2Direction, norm);// Calculate reflection vector
+	//Calculate specular component
+	float specularComponent2 = pow(max(dot(viewDir, reflectDir2), 0.0), highlightSize2);
+	vec3 specular2 = specularIntensity2 * specularComponent2 * light2Color.rgb;
+
+	//**Calculate phong result**
+	//Texture holds the color to be used for all three components
+	vec4 textureColor = texture(uTexture, vertexTextureCoordinate);
+	vec3 phong1;
+	vec3 phong2;
+
+	if (ubHasTexture == true)
+	{
+		phong1 = (ambientLight + diffuse1 + specular1) * textureColor.xyz;
+		phong2 = (ambientLight + diffuse2 + specular2) * textureColor.xyz;
+	}
+	else
+	{
+		phong1 = (ambientLight + diffuse1 + specular1) * objectColor.xyz;
+		phong2 = (ambientLight + diffuse2 + specular2) * objectColor.xyz;
+	}
+
+	fragmentColor = vec4(phong1 + phong2, 1.0); // Send lighting results to GPU
+	//fragmentColor = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+}
+);
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Instanced Fragment Shader Source Code sampling a plain GL_TEXTURE_2D, used when texture arrays are off*/
+const GLchar* texture2DFragmentShaderSource2 = GLSL(440,
+
+	in vec3 vertexFragmentNormal; // For incoming normals
+in vec3 vertexFragmentPos; // For incoming fragment position
+in vec2 vertexTextureCoordinate;
+flat in vec4 vertexSpecular; // Material of this instance
+flat in vec4 vertexObjectColor;
+
+out vec4 fragmentColor; // For outgoing cube color to the GPU
+
+//Per-frame block shared by every program, see FrameData
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 light1Color;
+	vec4 light1Position;
+	vec4 light2Color;
+	vec4 light2Position;
+	vec4 viewPosition;
+	vec4 ambient; // rgb color, a strength
+};
+
+// Uniform / Global variables, lights and camera come from the frame block
+uniform sampler2D uTexture; // Texture of the run, the labels share the atlas
+
+void main()
+{
+	/*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
+
+	//Calculate Ambient lighting
+	vec3 ambientLight = ambient.a * ambient.rgb; // Generate ambient light color
+
+	//**Calculate Diffuse lighting**
+	vec3 norm = normalize(vertexFragmentNormal); // Normalize vectors to 1 unit
+	vec3 light1Direction = normalize(light1Position.xyz - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+	float impact1 = max(dot(norm, light1Direction), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+	vec3 diffuse1 = impact1 * light1Color.rgb; // Generate diffuse light color
+	vec3 light2Direction = normalize(light2Position.xyz - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+	float impact2 = max(dot(norm, light2Direction), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+	vec3 diffuse2 = impact2 * light2Color.rgb; // Generate diffuse light color
+
+	//**Calculate Specular lighting**
+	vec3 viewDir = normalize(viewPosition.xyz - vertexFragmentPos); // Calculate view direction
+	vec3 reflectDir1 = reflect(-light1Direction, norm);// Calculate reflection vector
+	//Calculate specular component
+	float specularComponent1 = pow(max(dot(viewDir, reflectDir1), 0.0), vertexSpecular.y);
+	vec3 specular1 = vertexSpecular.x * specularComponent1 * light1Color.rgb;
+	vec3 reflectDir2 = reflect(-light2Direction, norm);// Calculate reflection vector
+	//Calculate specular component
+	float specularComponent2 = pow(max(dot(viewDir, reflectDir2), 0.0), vertexSpecular.w);
+	vec3 specular2 = vertexSpecular.z * specularComponent2 * light2Color.rgb;
+
+	//**Calculate phong result**
+	//Texture holds the color to be used for all three components
+	vec4 textureColor = texture(uTexture, vertexTextureCoordinate);
+	vec3 phong1;
+	vec3 phong2;
+
+	if (vertexObjectColor.w >= 0.0)
+	{
+		phong1 = (ambientLight + diffuse1 + specular1) * textureColor.xyz;
+		phong2 = (ambientLight + diffuse2 + specular2) * textureColor.xyz;
+	}
+	else
+	{
+		phong1 = (ambientLight + diffuse1 + specular1) * vertexObjectColor.xyz;
+		phong2 = (ambientLight + diffuse2 + specular2) * vertexObjectColor.xyz;
+	}
+
+	fragmentColor = vec4(phong1 + phong2, 1.0); // Send lighting results to GPU
+}
+);
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Depth Pre-Pass Vertex Shader Source Code, position only, same transform as vertexShaderSource1*/
+const GLchar* depthVertexShaderSource1 = GLSL(440,
+
+	layout(location = 0) in vec3 vertexPosition; // VAP position 0 for vertex position data
+invariant gl_Position;
+
+uniform mat4 model;
+
+//Per-frame block shared by every program, see FrameData
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 light1Color;
+	vec4 light1Position;
+	vec4 light2Color;
+	vec4 light2Position;
+	vec4 viewPosition;
+	vec4 ambient; // rgb color, a strength
+};
+
+void main()
+{
+	gl_Position = projection * view * model * vec4(vertexPosition, 1.0f); // Transforms vertices into clip coordinates
+}
+);
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Instanced Depth Pre-Pass Vertex Shader Source Code, same transform as vertexShaderSource2*/
+const GLchar* depthVertexShaderSource2 = GLSL(440,
+
+	layout(location = 0) in vec3 vertexPosition; // VAP position 0 for vertex position data
+layout(location = 3) in uint drawId; // Per-instance index into the object buffer (baseInstance + gl_InstanceID)
+invariant gl_Position;
+
+//Per-frame block shared by every program, see FrameData
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 light1Color;
+	vec4 light1Position;
+	vec4 light2Color;
+	vec4 light2Position;
+	vec4 viewPosition;
+	vec4 ambient; // rgb color, a strength
+};
+
+//Per-object block written by the render queue, see ObjectData
+struct ObjectData
+{
+	mat4 model;
+	vec4 specular;
+	vec4 color;
+	vec4 uvScale;
+	vec4 boundsMin;
+	vec4 boundsMax;
+};
+layout(std430, binding = 1) readonly buffer ObjectBlock
+{
+	ObjectData objects[];
+};
+layout(std430, binding = 2) readonly buffer VisibleBlock
+{
+	uint visibleObjects[];
+};
+
+void main()
+{
+	uint object = visibleObjects[drawId];
+	mat4 model = objects[object].model;
+	gl_Position = projection * view * model * vec4(vertexPosition, 1.0f); // Transforms vertices into clip coordinates
+}
+);
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Depth Pre-Pass Fragment Shader Source Code, color writes are off and only depth is kept*/
+const GLchar* depthFragmentShaderSource = GLSL(440,
+
+	void main()
+{
+}
+);
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 // main function. Entry point to the OpenGL program //
 int main(int argc, char* argv[])
 {
-	if (!Initialize(argc, argv, &gWindow))
-		return EXIT_FAILURE;
+	// Culling and job system benchmarks on synthetic data, need no window: -cullbench, -jobbench.
+	// -jobbench first runs the job system stress test and fails when it does.
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-cullbench") == 0)
+		{
+			RunCullingBenchmark();
+			return EXIT_SUCCESS;
+		}
+		if (strcmp(argv[i], "-jobbench") == 0)
+		{
+			if (!RunJobStressTest())
+				return EXIT_FAILURE;
+			RunJobBenchmark();
+			return EXIT_SUCCESS;
+		}
+	}
+
+	// Headless run without a window: -headless <frames> [-resolution <width>x<height>] [-png <file.png>]
+	// The frames are the timed ones, drawn after the benchmark warm-up (see -warmup), and the PNG holds the last
+	int headlessFrames = 0;
+	const char* pngPath = nullptr;
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (strcmp(argv[i], "-headless") == 0)
+			headlessFrames = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-resolution") == 0)
+			sscanf(argv[i + 1], "%dx%d", &gViewportWidth, &gViewportHeight);
+		else if (strcmp(argv[i], "-png") == 0)
+			pngPath = argv[i + 1];
+	}
+
+	// Self-test: -selftest renders one headless frame and fails if it queried a uniform location
+	bool selfTest = false;
+	unsigned int selfTestQueries = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-selftest") == 0)
+			selfTest = true;
+	}
+	if (selfTest && headlessFrames <= 0)
+		headlessFrames = 1;
+
+	if (headlessFrames > 0)
+	{
+		if (gViewportWidth <= 0 || gViewportHeight <= 0)
+		{
+			cout << "ERROR::HEADLESS::INVALID_RESOLUTION" << endl;
+			return EXIT_FAILURE;
+		}
+		if (!CreateHeadlessContext() || !gOffscreen.Create(gViewportWidth, gViewportHeight))
+			return EXIT_FAILURE;
+	}
+	else
+	{
+		// The window keeps its fixed size
+		gViewportWidth = WINDOW_WIDTH;
+		gViewportHeight = WINDOW_HEIGHT;
+		if (!Initialize(argc, argv, &gWindow))
+			return EXIT_FAILURE;
+	}
+
+	// Optional stress scene: -shelves <units>
+	// Benchmark: -benchmark <frames> or -benchtime <seconds>
+	// Interactive: -fpslimit <fps>, -vsync <0|1>
+	// Profiler, off otherwise, with its CSV: -profile <file.csv>
+	// Scripted camera: -camerapath <file>, report: -report <file.json>
+	// Frame stage threads: -threads <count>, 1 runs them on the render thread
+	// Depth pre-pass: -prepass <0|1>
+	// Untimed frames before a benchmark: -warmup <frames>, 0 renders exactly the benchmark frames
+	// Scene textures in one array, or one GL_TEXTURE_2D each with the labels in the atlas: -texturearray <0|1>
+	int swapInterval = 1;
+	int warmupFrames = BENCHMARK_WARMUP_FRAMES;
+	int threadCount = (int)std::thread::hardware_concurrency();
+	const char* profilePath = nullptr;
+	const char* cameraPathFile = nullptr;
+	const char* reportPath = nullptr;
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (strcmp(argv[i], "-shelves") == 0)
+			gShelfUnits = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-benchmark") == 0)
+			gBenchmarkFrames = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-benchtime") == 0)
+			gBenchmarkSeconds = atof(argv[i + 1]);
+		else if (strcmp(argv[i], "-fpslimit") == 0)
+			gFrameLimiter.SetTargetFps(atof(argv[i + 1]));
+		else if (strcmp(argv[i], "-vsync") == 0)
+			swapInterval = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-profile") == 0)
+			profilePath = argv[i + 1];
+		else if (strcmp(argv[i], "-camerapath") == 0)
+			cameraPathFile = argv[i + 1];
+		else if (strcmp(argv[i], "-report") == 0)
+			reportPath = argv[i + 1];
+		else if (strcmp(argv[i], "-threads") == 0)
+			threadCount = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-prepass") == 0)
+			gRenderQueue.SetDepthPrePass(atoi(argv[i + 1]) != 0);
+		else if (strcmp(argv[i], "-warmup") == 0)
+			warmupFrames = atoi(argv[i + 1]) > 0 ? atoi(argv[i + 1]) : 0;
+		else if (strcmp(argv[i], "-texturearray") == 0)
+			gTextureArrayEnabled = atoi(argv[i + 1]) != 0;
+	}
+
+	// Headless runs are benchmarks of the given frame count
+	if (headlessFrames > 0)
+		gBenchmarkFrames = headlessFrames;
+
+	// A camera path is a benchmark of the frames covering it, unless a frame count is given
+	if (cameraPathFile)
+	{
+		if (!gCameraPath.Load(cameraPathFile))
+			return EXIT_FAILURE;
+		gCameraPathLoaded = true;
+		if (gBenchmarkFrames <= 0)
+			gBenchmarkFrames = (int)(gCameraPath.GetDuration() / BENCHMARK_TIMESTEP) + 1;
+		gBenchmarkSeconds = 0.0;
+	}
+
+	// Benchmarks run uncapped, whatever the display refresh
+	const bool benchmark = gBenchmarkFrames > 0 || gBenchmarkSeconds > 0.0;
+	if (benchmark)
+	{
+		swapInterval = 0;
+		gFrameLimiter.SetTargetFps(0.0);
+		gWarmupFrames = warmupFrames;
+	}
+	if (gWindow)
+		glfwSwapInterval(swapInterval);
 
 	// Create the mesh, send data to VBO
 	meshes.CreateMeshes();
+	// Pack every mesh into one vertex and index buffer for multi-draw indirect
+	meshes.CreateMeshArena();
 
-	// Create the shader program
-	if (!CreateShaderProgram(vertexShaderSource1, fragmentShaderSource1, gProgramId1))
+	// Create the shader program, sampling the texture array or plain 2D textures
+	if (!CreateShaderProgram(vertexShaderSource1, gTextureArrayEnabled ? fragmentShaderSource1 : texture2DFragmentShaderSource1,
+		gProgramId1, gUniforms1))
+		return EXIT_FAILURE;
+	// Instanced variant used for runs of objects sharing mesh and texture
+	if (!CreateShaderProgram(vertexShaderSource2, gTextureArrayEnabled ? fragmentShaderSource2 : texture2DFragmentShaderSource2,
+		gProgramId2, gUniforms2))
+		return EXIT_FAILURE;
+	// Position-only variants laying down the depth before the Phong programs run
+	if (!CreateShaderProgram(depthVertexShaderSource1, depthFragmentShaderSource, gDepthProgramId1, gDepthUniforms1))
+		return EXIT_FAILURE;
+	if (!CreateShaderProgram(depthVertexShaderSource2, depthFragmentShaderSource, gDepthProgramId2, gDepthUniforms2))
 		return EXIT_FAILURE;
 
 	// Load texture data from file
@@ -201,90 +880,262 @@ int main(int argc, char* argv[])
 	//	return EXIT_FAILURE;
 	//}
 	//Texture Prep
-	const char* texFilename = "brick.jpg";
-	if (!CreateTexture(texFilename, gTextureId))
-	{
-		cout << "Failed to load texture " << texFilename << endl;
+	if (!gLabelAtlas.Build(ATLAS_FILES, ATLAS_IMAGES, TEXTURE_ARRAY_MAX_SIZE))
 		return EXIT_FAILURE;
-	}
-	const char* texFilename2 = "alum.jpg";
-	if (!CreateTexture(texFilename2, gTextureId2))
+	const TextureImage labels = gLabelAtlas.GetImage();
+	if (gTextureArrayEnabled)
 	{
-		cout << "Failed to load texture " << texFilename2 << endl;
-		return EXIT_FAILURE;
+		if (!CreateTextureArray(TEXTURE_FILES, LAYER_LABELS, &labels, 1, TEXTURE_ARRAY_MAX_SIZE, gTextureArray))
+			return EXIT_FAILURE;
 	}
-	const char* texFilename3 = "capTex.jpg";
-	if (!CreateTexture(texFilename3, gTextureId3))
-	{
-		cout << "Failed to load texture " << texFilename3 << endl;
-		return EXIT_FAILURE;
-	}
-	const char* texFilename4 = "red+white.jpg";
-	if (!CreateTexture(texFilename4, gTextureId4))
+	else
 	{
-		cout << "Failed to load texture " << texFilename4 << endl;
-		return EXIT_FAILURE;
+		// One texture per file, the labels still share the atlas and its bind
+		for (int layer = 0; layer < LAYER_LABELS; ++layer)
+		{
+			if (!CreateTexture(TEXTURE_FILES[layer], gLayerTextures[layer]))
+			{
+				cout << "ERROR::TEXTURE::IMAGE_NOT_LOADED " << TEXTURE_FILES[layer] << endl;
+				return EXIT_FAILURE;
+			}
+		}
+		if (!CreateImageTexture(labels, gLayerTextures[LAYER_LABELS]))
+			return EXIT_FAILURE;
+		gRenderQueue.SetTextureTarget(GL_TEXTURE_2D);
+		cout << "INFO: Texture array off, " << TEXTURE_LAYERS << " 2D textures" << endl;
 	}
-	const char* texFilename5 = "spool_top.jpg";
-	if (!CreateTexture(texFilename5, gTextureId5))
+	gLabelAtlas.ReleasePixels();
+	// Describe the objects of the scene now that meshes and textures exist
+	CreateScene();
+	if (gShelfUnits > 0)
+		CreateShelfScene(gShelfUnits);
+	// The objects name array layers, without the array each layer is a whole texture of its own
+	if (!gTextureArrayEnabled)
 	{
-		cout << "Failed to load texture " << texFilename5 << endl;
-		return EXIT_FAILURE;
+		for (SceneObject& object : gScene)
+		{
+			object.texture = gLayerTextures[object.textureLayer];
+			object.textureLayer = 0;
+		}
 	}
-	const char* texFilename6 = "gasCan.jpg";
-	if (!CreateTexture(texFilename6, gTextureId6))
+
+	// Give every mesh VAO in the scene, each of its levels, and the arena, the per-instance draw ID
+	gRenderQueue.CreateBuffers();
+	for (const SceneObject& object : gScene)
 	{
-		cout << "Failed to load texture " << texFilename6 << endl;
-		return EXIT_FAILURE;
+		gRenderQueue.AttachDrawIdAttribute(object.mesh->vao);
+		for (int level = 1; object.lod && level < Meshes::LOD_LEVELS; ++level)
+			gRenderQueue.AttachDrawIdAttribute(object.lod->levels[level]->vao);
 	}
-	const char* texFilename7 = "chainsaw1.jpg";
-	if (!CreateTexture(texFilename7, gTextureId7))
-	{
-		cout << "Failed to load texture " << texFilename7 << endl;
+	gRenderQueue.AttachDrawIdAttribute(meshes.gArena.vao);
+	gRenderQueue.SetInstancedProgram(gProgramId2);
+	gRenderQueue.SetDepthPrograms(gDepthProgramId1, &gDepthUniforms1, gDepthProgramId2);
+	gRenderQueue.SetMeshArena(meshes.gArena.vao);
+
+	// Hi-Z pyramid built from the depth buffer of each frame, at the framebuffer's size
+	int framebufferWidth = gViewportWidth, framebufferHeight = gViewportHeight;
+	if (gWindow)
+		glfwGetFramebufferSize(gWindow, &framebufferWidth, &framebufferHeight);
+	if (!gOcclusion.Create(framebufferWidth, framebufferHeight))
 		return EXIT_FAILURE;
-	}
-	const char* texFilename8 = "concrete.jpg";
-	if (!CreateTexture(texFilename8, gTextureId8))
+	gRenderQueue.SetOcclusionCuller(&gOcclusion);
+
+	// Timestamp queries read back a few frames late. Off unless -profile is given or G is pressed,
+	// G then prints the summary.
+	gProfiler.Create();
+	if (profilePath)
 	{
-		cout << "Failed to load texture " << texFilename8 << endl;
-		return EXIT_FAILURE;
+		if (!gProfiler.OpenCsv(profilePath))
+			return EXIT_FAILURE;
+		gProfiler.SetEnabled(true);
 	}
-	const char* texFilename9 = "red.jpg";
-	if (!CreateTexture(texFilename9, gTextureId9))
-	{
-		cout << "Failed to load texture " << texFilename9 << endl;
+	gRenderQueue.SetProfiler(&gProfiler);
+
+	// View, projection, lighting and the queue's object entries and commands are written every
+	// frame into a region of the ring buffer, sized for the whole scene
+	if (!gRingBuffer.Create(sizeof(FrameData) + RenderQueue::GetFrameBytes(gScene.size()), RING_ALLOCATIONS_PER_FRAME))
 		return EXIT_FAILURE;
-	}
-	// Activate the program that will reference the texture
+	gRenderQueue.SetRingBuffer(&gRingBuffer);
+
+	// Transforms, culling, LOD and the queue run on slices of the scene, only the render thread calls GL
+	gWorkerPool.Start(threadCount);
+	gParallelFrame = gWorkerPool.GetThreadCount() > 1;
+	gRenderQueue.SetWorkerPool(gParallelFrame ? &gWorkerPool : nullptr);
+	cout << "INFO: Frame stages run on " << gWorkerPool.GetThreadCount() << " threads" << endl;
+
+	// Activate the programs that will reference the texture
 	glUseProgram(gProgramId1);
 	// We set the texture as texture unit 0
-	glUniform1i(glGetUniformLocation(gProgramId1, "uTexture"), 0);
+	glUniform1i(gUniforms1.uTexture, 0);
+	glUseProgram(gProgramId2);
+	glUniform1i(gUniforms2.uTexture, 0);
 
 	// Sets the background color of the window to black (it will be implicitely used by glClear)
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
+	// Identify the run so numbers from different builds and machines can be compared
+	if (benchmark)
+	{
+		cout << "INFO: Benchmark on " << glGetString(GL_RENDERER) << ", " << gViewportWidth << "x" << gViewportHeight
+			<< ", " << gScene.size() << " objects, " << (gWindow ? "vsync off" : "headless") << ", " << gWarmupFrames << " warm-up frames"
+			<< ", depth pre-pass " << (gRenderQueue.GetDepthPrePass() ? "on" : "off")
+			<< ", texture array " << (gTextureArrayEnabled ? "on" : "off") << endl;
+		if (gCameraPathLoaded)
+		{
+			cout << "INFO: Camera path " << gCameraPath.GetName() << ", " << gCameraPath.GetKeyCount() << " keys over "
+				<< gCameraPath.GetDuration() << " s, " << gBenchmarkFrames << " frames" << endl;
+		}
+	}
+
+
+	// Setup above bound and enabled state behind the cache's back
+	GLState().Invalidate();
+
+	// The camera starts at rest, both simulated states equal
+	gSimulation.SetRate(SIMULATION_RATE);
+	gPreviousCamera = { gCamera.Position, gCamera.Yaw, gCamera.Pitch };
+
+	// The clock starts now without a warm-up, otherwise as the last warm-up frame ends
+	if (gWarmupFrames == 0)
+		gFrameTimer.Tick();
 
 	// Render loop
-	while (!glfwWindowShouldClose(gWindow))
+	bool running = true;
+	while (running && (gWindow == nullptr || !glfwWindowShouldClose(gWindow)))
 	{
-		float currentFrame = glfwGetTime();
-		gDeltaTime = currentFrame - gLastFrame;
-		gLastFrame = currentFrame;
-		// Process keyboard input before rendering
-		ProcessInput(gWindow);
+		// A camera path sets the pose from the frame number alone, warm-up frames hold the first key.
+		// Headless runs without a path take no input, the camera stays where it starts.
+		if (gCameraPathLoaded)
+		{
+			const CameraKey key = gCameraPath.Sample(gFrameTimer.GetFrameCount() * BENCHMARK_TIMESTEP);
+			gCamera.SetPose(key.position, key.yaw, key.pitch);
+			if (gWindow && glfwGetKey(gWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+				glfwSetWindowShouldClose(gWindow, true);
+		}
+		else if (gWindow)
+		{
+			// Process keyboard input before rendering, then run the steps the elapsed time covers
+			ProcessInput(gWindow);
+			gSimulation.Advance(glfwGetTime());
+			while (gSimulation.Step())
+			{
+				gPreviousCamera = { gCamera.Position, gCamera.Yaw, gCamera.Pitch };
+				SimulateStep(gWindow);
+			}
+		}
+
+		// Draw between the last two simulated states, the camera path and headless runs have only one
+		gViewCamera = gCamera;
+		if (gWindow && !gCameraPathLoaded)
+		{
+			const float alpha = gSimulation.GetAlpha();
+			gViewCamera.SetPose(glm::mix(gPreviousCamera.position, gCamera.Position, alpha),
+				glm::mix(gPreviousCamera.yaw, gCamera.Yaw, alpha), glm::mix(gPreviousCamera.pitch, gCamera.Pitch, alpha));
+		}
 
 		// Render this frame
+		const unsigned int uniformQueries = GetUniformQueryCount();
 		Render();
 
-		glfwPollEvents();
+		// Uniform locations are cached at link time, so a frame must not query any
+		if (selfTest)
+		{
+			selfTestQueries = GetUniformQueryCount() - uniformQueries;
+			break;
+		}
+
+		// Hold the interactive frame rate, then time the whole frame including the wait
+		gFrameLimiter.Wait();
+		if (gWarmupFrames > 0)
+		{
+			if (--gWarmupFrames == 0)
+				gFrameTimer.Tick();
+		}
+		else
+		{
+			// The first tick after a reset only restarts the clock, count the frames that got a time
+			const size_t timedFrames = gFrameTimer.GetFrameCount();
+			gFrameTimer.Tick();
+			if (benchmark && gFrameTimer.GetFrameCount() > timedFrames)
+			{
+				const CullingCounters culling = { (unsigned int)gVisibleCount, (unsigned int)gCulledCount, (unsigned int)gBvhNodesVisited,
+					gOcclusion.GetTestedCount(), gOcclusion.GetOccludedCount() };
+				gBenchmarkReport.AddFrame(gRenderQueue.GetStats(), gLodSelector.GetTriangleCount(), culling, GLState().GetCounters());
+			}
+		}
+
+		if (benchmark && ((gBenchmarkFrames > 0 && (int)gFrameTimer.GetFrameCount() >= gBenchmarkFrames)
+			|| (gBenchmarkSeconds > 0.0 && gFrameTimer.GetElapsedSeconds() >= gBenchmarkSeconds)))
+		{
+			gFrameTimer.PrintSummary(cout, "Benchmark");
+			cout << "INFO: " << gRingBuffer.GetWaitCount() << " frames waited for the GPU to release their ring buffer region" << endl;
+			if (reportPath)
+			{
+				BenchmarkInfo info;
+				info.renderer = (const char*)glGetString(GL_RENDERER);
+				info.width = gViewportWidth;
+				info.height = gViewportHeight;
+				info.objects = gScene.size();
+				info.cameraPath = gCameraPathLoaded ? gCameraPath.GetName() : "";
+				info.timestep = gCameraPathLoaded ? BENCHMARK_TIMESTEP : 0.0;
+				info.warmupFrames = warmupFrames;
+				info.depthPrePass = gRenderQueue.GetDepthPrePass();
+				info.textureArray = gTextureArrayEnabled;
+				if (gBenchmarkReport.Write(reportPath, info, gFrameTimer))
+					cout << "INFO: Wrote the benchmark report to " << reportPath << endl;
+			}
+			running = false;
+		}
+
+		if (gWindow)
+			glfwPollEvents();
+	}
+
+	// Last headless frame, still in the offscreen target
+	if (!gWindow && pngPath)
+	{
+		if (gOffscreen.SavePng(pngPath))
+			cout << "INFO: Saved the last frame to " << pngPath << endl;
 	}
 
 	// Release mesh data
 	meshes.DestroyMeshes();
+	meshes.DestroyMeshArena();
+	gRenderQueue.DestroyBuffers();
+	gOcclusion.Destroy();
+	gProfiler.Destroy();
+	gSoftwareOcclusion.Stop();
+	gWorkerPool.Stop();
+	gRingBuffer.Destroy();
 	// Release shader program
 	DestroyShaderProgram(gProgramId1);
+	DestroyShaderProgram(gProgramId2);
+	DestroyShaderProgram(gDepthProgramId1);
+	DestroyShaderProgram(gDepthProgramId2);
 	// Release the textures
-	//DestroyTexture(gTextureId);
+	if (gTextureArrayEnabled)
+		DestroyTextureArray(gTextureArray);
+	else
+	{
+		for (int layer = 0; layer < TEXTURE_LAYERS; ++layer)
+			DestroyTexture(gLayerTextures[layer]);
+	}
+
+	if (!gWindow)
+	{
+		gOffscreen.Destroy();
+		DestroyHeadlessContext();
+	}
+
+	if (selfTest)
+	{
+		if (selfTestQueries > 0)
+		{
+			cout << "ERROR::SELFTEST::UNIFORM_QUERIES_IN_FRAME: " << selfTestQueries << endl;
+			exit(EXIT_FAILURE);
+		}
+		cout << "INFO: Self-test passed, no uniform location queried while rendering" << endl;
+	}
 
 	exit(EXIT_SUCCESS); // Terminates the program successfully
 }
@@ -312,6 +1163,7 @@ bool Initialize(int argc, char* argv[], GLFWwindow** window)
 	glfwSetMouseButtonCallback(*window, UMouseButtonCallback);
 	glfwSetScrollCallback(*window, UMouseScrollCallback);
 	glfwSetCursorPosCallback(*window, UMousePositionCallback);
+	glfwSetKeyCallback(*window, UKeyCallback);
 	// GLEW: initialize
 	// ----------------
 	// Note: if using GLEW version 1.13 or earlier
@@ -348,90 +1200,59 @@ void ProcessInput(GLFWwindow* window)
 
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
+}
+
+// Advance the camera by one fixed step from the held keys and the mouse movement since the last step
+void SimulateStep(GLFWwindow* window)
+{
+	const float step = (float)gSimulation.GetStepSeconds();
+
+	gCamera.ProcessMouseMovement(gMouseOffsetX, gMouseOffsetY);
+	gMouseOffsetX = 0.0f;
+	gMouseOffsetY = 0.0f;
 
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(FORWARD, gDeltaTime);
+		gCamera.ProcessKeyboard(FORWARD, step);
 	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(BACKWARD, gDeltaTime);
+		gCamera.ProcessKeyboard(BACKWARD, step);
 	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(LEFT, gDeltaTime);
+		gCamera.ProcessKeyboard(LEFT, step);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(RIGHT, gDeltaTime);
+		gCamera.ProcessKeyboard(RIGHT, step);
 	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(UP, gDeltaTime);
+		gCamera.ProcessKeyboard(UP, step);
 	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(DOWN, gDeltaTime);
+		gCamera.ProcessKeyboard(DOWN, step);
 }
 
 // Render the next frame to the OpenGL viewport //
 void Render()
 {
-	/*     Uniform Declarations      */
-	//Uniforms for Vertex Shader 
-	GLint modelLoc;
-	GLint viewLoc;
-	GLint projectionLoc;
-
-
-	//Uniform Locations for fragment shader
-	GLint objectColorLoc;
-	GLint ambientColorLoc;
-	GLint light1ColorLoc;
-	GLint light1PositionLoc;
-	GLint light2ColorLoc;
-	GLint light2PositionLoc;
-	GLint viewPositionLoc;
-	GLint uTextureLoc; // Useful when working with multiple textures
-	GLint uvScaleLoc;
-	GLint ubHasTextureLoc;
-	GLint ambientStrengthLoc; // Set ambient or global lighting strength
-	GLint specularIntensity1Loc;
-	GLint highlightSize1Loc;
-	GLint specularIntensity2Loc;
-	GLint highlightSize2Loc;
-
+	// Uniform locations cached when the program was linked
+	const UniformLayout& uniforms = gUniforms1;
 
 	glm::mat4 projection;
-	glm::mat4 model;
-	glm::mat4 scale;
-	glm::mat4 rotation;
-	glm::mat4 translation;
-
-	bool ubHasTextureVal;
-
-	/*     Defining Uniform Locations     */
-	// Retrieves and passes transform matrices to the Shader program. Utilized by individual objects in later sections
-	modelLoc = glGetUniformLocation(gProgramId1, "model");
-	viewLoc = glGetUniformLocation(gProgramId1, "view");
-	projectionLoc = glGetUniformLocation(gProgramId1, "projection");
-	objectColorLoc = glGetUniformLocation(gProgramId1, "objectColor");
-	light1ColorLoc = glGetUniformLocation(gProgramId1, "light1Color");
-	light1PositionLoc = glGetUniformLocation(gProgramId1, "light1Position");
-	light2ColorLoc = glGetUniformLocation(gProgramId1, "light2Color");
-	light2PositionLoc = glGetUniformLocation(gProgramId1, "light2Position");
-	viewPositionLoc = glGetUniformLocation(gProgramId1, "viewPosition");
-	uTextureLoc = glGetUniformLocation(gProgramId1, "uTexture");
-	ubHasTextureLoc = glGetUniformLocation(gProgramId1, "ubHasTexture");
-	ambientStrengthLoc = glGetUniformLocation(gProgramId1, "ambientStrength");
-	specularIntensity1Loc = glGetUniformLocation(gProgramId1, "specularIntensity1");
-	highlightSize1Loc = glGetUniformLocation(gProgramId1, "highlightSize1");
-	specularIntensity2Loc = glGetUniformLocation(gProgramId1, "specularIntensity2");
-	highlightSize2Loc = glGetUniformLocation(gProgramId1, "highlightSize2");
-	uvScaleLoc = glGetUniformLocation(gProgramId1, "uvScale");
-	ambientColorLoc = glGetUniformLocation(gProgramId1, "ambientColor");
+
+	// Every pass below is timed on the GPU and the CPU
+	gProfiler.BeginFrame();
+	gProfiler.BeginScope("frame setup");
+	GLState().BeginFrame();
+
+	// Blocks only when the GPU is still reading the region from RingBuffer::FRAMES frames ago
+	gRingBuffer.BeginFrame();
 
 	// Enable z-depth
-	glEnable(GL_DEPTH_TEST);
+	GLState().SetCapability(GL_DEPTH_TEST, true);
 
 	// Clear the background
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	GLState().ClearColor(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	// allows camera to switch between perspective and orthographic projections
 	switch (gCurrentCameraIndex)
 	{
 	case 1:
-		projection = glm::perspective(glm::radians(50.0f), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 200.0f);
+		projection = glm::perspective(glm::radians(50.0f), (GLfloat)gViewportWidth / (GLfloat)gViewportHeight, 0.1f, 200.0f);
 		break;
 	case 2:
 		projection = glm::ortho(-50.0f, 50.0f, -50.0f, 50.0f, 0.1f, 100.0f);
@@ -439,366 +1260,307 @@ void Render()
 	}
 
 
-	glm::mat4 view = gCamera.GetViewMatrix();
-	// Set Active Shader Program
-	glUseProgram(gProgramId1);
-
-
-	//Set Universal Things (Will not change from object to object)
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view)); // sends view data to projection loc which is then read by shader
-	glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection)); // sends projection data to projection loc which is then read by shader
-	glUniform3f(light1ColorLoc, 1.0f, 1.0f, 1.0f);
-	glUniform3f(light1PositionLoc, 50.0f, 70.0f, 10.0f);
-	glUniform3f(light2ColorLoc, 1.0f, 1.0f, 1.0f);
-	glUniform3f(light2PositionLoc, -20.0f, 70.0f, 10.0f);
-	const glm::vec3 cameraPosition = gCamera.Position;
-	glUniform3f(viewPositionLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-	glUniform3f(ambientColorLoc, 1.0, 1.0, 1.0);
-	glUniform1f(ambientStrengthLoc, 0.1f);
-	glUniform2f(uvScaleLoc, 1.0f, 1.0f);
-
-	/*          TruFuel Can          */
-	/*     Main Cylinder Body     */
+	glm::mat4 view = gViewCamera.GetViewMatrix();
 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
+	//Set Universal Things (Will not change from object to object), shared by both programs
+	FrameData frame;
+	SetFrameData(frame, view, projection);
+	WriteFrameData(gRingBuffer, frame);
+	gProfiler.EndScope();
 
-	// Set the mesh transfomation values
-	scale = glm::scale(glm::vec3(3.0f, 8.0f, 3.0f));
-	rotation = glm::rotate(0.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-	translation = glm::translate(glm::vec3(0.0f, 0.0f, 0.0f));
-	model = translation * rotation * scale;
+	// Per-object stages below run on slices of the scene in the job system
+	WorkerPool* pool = gParallelFrame ? &gWorkerPool : nullptr;
 
+	// Only subtrees whose transform changed get new world matrices
+	gProfiler.BeginScope("scene update");
+	gMatricesRecomputed = gSceneGraph.Update(pool);
+	if (gMatricesRecomputed > 0 || gCuller.GetCount() != gScene.size())
+	{
+		auto updateSpheres = [pool] { gCuller.UpdateSpheres(gScene, gSceneGraph, pool); };
+		auto computeBounds = [pool] { ComputeWorldBounds(gScene, gSceneGraph, gWorldBoundsMin, gWorldBoundsMax, pool); };
+		auto updateBvh = []
+		{
+			// Objects added or removed need a new tree, moved ones only a refit
+			if (gBvh.GetObjectCount() != gScene.size())
+				gBvh.Build(gWorldBoundsMin, gWorldBoundsMax);
+			else
+				gBvh.Refit(gWorldBoundsMin, gWorldBoundsMax);
+		};
+
+		if (pool)
+		{
+			// The spheres run beside the boxes and the BVH, which needs the boxes first
+			JobCounter boundsDone, sceneDone;
+			pool->Run(pool->CreateJob(computeBounds), boundsDone);
+			pool->RunAfter(pool->CreateJob(updateBvh), sceneDone, boundsDone);
+			pool->Run(pool->CreateJob(updateSpheres), sceneDone);
+			pool->Wait(sceneDone);
+			pool->Wait(boundsDone);
+		}
+		else
+		{
+			updateSpheres();
+			computeBounds();
+			updateBvh();
+		}
+	}
+	gProfiler.EndScope();
+
+	gProfiler.BeginScope("culling");
+
+	// Skip the objects entirely outside the view
+	Frustum frustum;
+	ExtractFrustumPlanes(projection * view, frustum);
+	gBvhNodesVisited = 0;
+	if (gCullingEnabled && gBvhEnabled)
+		gVisibleCount = gBvh.Cull(frustum, gVisible, &gBvhNodesVisited, pool);
+	else if (gCullingEnabled)
+		gVisibleCount = gCuller.Cull(frustum, gVisible, pool);
+	else
+	{
+		gVisible.assign(gScene.size(), 1);
+		gVisibleCount = gScene.size();
+	}
+	gCulledCount = gScene.size() - gVisibleCount;
+
+	// Coarser meshes for the visible objects that are small on screen
+	gLodSelector.Select(gScene, gVisible, gSceneGraph, projection * view, projection[1][1], gViewportHeight, pool);
+
+	// Occluders are rasterized on the worker while the queue is built here. LOD selection swaps
+	// the meshes the worker reads, so it must be done before the worker starts.
+	const bool softwareOcclusion = gSoftwareOcclusion.GetEnabled();
+	if (softwareOcclusion)
+		gSoftwareOcclusion.Start(projection * view, gScene, gSceneGraph, gWorldBoundsMin, gWorldBoundsMax);
+	gProfiler.EndScope();
+
+	// Queue every visible object of the scene table, sort by state and submit
+	gProfiler.BeginScope("queue build");
+	gRenderQueue.Clear();
+	gRenderQueue.PushScene(gScene, gVisible, gSceneGraph, gProgramId1, uniforms);
+	gRenderQueue.Sort();
+
+	// Drop what the occluders hide before anything reaches GL
+	gSoftwareOccludedCount = 0;
+	if (softwareOcclusion)
+	{
+		gProfiler.BeginScope("software occlusion wait");
+		gSoftwareOccludedCount = gRenderQueue.RemoveHidden(gSoftwareOcclusion.Finish(), gScene.data());
+		gProfiler.EndScope();
+	}
+	gProfiler.EndScope();
 
-	ubHasTextureVal = true;
-	glUniform1i(ubHasTextureLoc, ubHasTextureVal);
+	gProfiler.BeginScope("submit");
+	gRenderQueue.Submit();
+	gProfiler.EndScope();
 
+	// Occluders for next frame's test, while the back buffer still holds this frame's depth
+	gProfiler.BeginScope("hi-z pyramid");
+	gOcclusion.BuildPyramid(projection * view);
+	gProfiler.EndScope();
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureId6);
+	// Every command reading this frame's ring region has been issued
+	gRingBuffer.EndFrame();
+	gProfiler.EndFrame();
 
+	// Report the bind counts of the first frame against scene order
+	if (!gRenderStatsReported)
+	{
+		const RenderStats& stats = gRenderQueue.GetStats();
+		cout << "INFO: Render queue: " << stats.objects << " objects, " << stats.drawCalls << " draw calls, "
+			<< stats.programBinds << " program binds" << endl;
+		cout << "INFO:   VAO binds " << stats.unsortedVaoBinds << " -> " << stats.vaoBinds
+			<< ", texture binds " << stats.unsortedTextureBinds << " -> " << stats.textureBinds
+			<< ", material updates " << stats.unsortedMaterialUpdates << " -> " << stats.materialUpdates << endl;
+		cout << "INFO:   " << stats.instances << " objects drawn by " << stats.instancedDraws << " instanced draw calls and "
+			<< stats.multiDrawCalls << " multi-draws of " << stats.indirectCommands << " indirect commands" << endl;
+		cout << "INFO:   " << gMatricesRecomputed << " world matrices recomputed" << endl;
+		cout << "INFO:   " << gVisibleCount << " objects visible, " << gCulledCount << " culled by the view frustum";
+		if (gCullingEnabled && gBvhEnabled)
+			cout << " (" << gBvhNodesVisited << " of " << gBvh.GetNodeCount() << " BVH nodes tested)";
+		cout << endl;
+		if (softwareOcclusion)
+			cout << "INFO:   " << gSoftwareOccludedCount << " visible objects hidden by " << gSoftwareOcclusion.GetOccluderCount()
+				<< " software occluders (" << gSoftwareOcclusion.GetTriangleCount() << " triangles rasterized)" << endl;
+		cout << "INFO:   " << gLodSelector.GetTriangleCount() << " triangles in view with LOD " << (gLodSelector.GetEnabled() ? "on" : "off")
+			<< ", " << gLodSelector.GetFullDetailTriangleCount() << " at full detail (objects per level";
+		for (int level = 0; level < Meshes::LOD_LEVELS; ++level)
+			cout << " " << gLodSelector.GetLevelCount(level);
+		cout << ")" << endl;
+		if (gRenderQueue.GetDepthPrePass())
+			cout << "INFO:   Depth pre-pass on, " << stats.depthDrawCalls << " of the draw calls lay down depth only" << endl;
+		if (!gOcclusion.GetEnabled() || !gRenderQueue.GetMultiDrawIndirect())
+			cout << "INFO:   Occlusion culling off, it needs multi-draw indirect" << endl;
+		else
+			cout << "INFO:   Hi-Z occlusion: " << gOcclusion.GetOccludedCount() << " of " << gOcclusion.GetTestedCount()
+				<< " draws occluded (read back a few frames late)" << endl;
+		cout << "INFO:   ";
+		GLState().PrintCounters(cout);
+		cout << endl;
+		cout << "INFO:   " << gRingBuffer.GetUsedBytes() << " of " << gRingBuffer.GetRegionBytes() << " ring buffer bytes written, "
+			<< gRingBuffer.GetWaitCount() << " frames waited for the GPU so far" << endl;
+		gRenderStatsReported = true;
+	}
 
-	// Remaining Object Specific Uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(objectColorLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniform1f(specularIntensity1Loc, 1.0f);
-	glUniform1f(specularIntensity2Loc, 1.0f);
-	glUniform1f(highlightSize1Loc, 16.0f);
-	glUniform1f(highlightSize2Loc, 16.0f);
+	if (gWindow)
+		glfwSwapBuffers(gWindow);
+}
+// Fill the values shared by every object of the frame //
+void SetFrameData(FrameData& frame, const glm::mat4& view, const glm::mat4& projection)
+{
+	frame.view = view;
+	frame.projection = projection;
+	frame.light1Color = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+	frame.light1Position = glm::vec4(50.0f, 70.0f, 10.0f, 1.0f);
+	frame.light2Color = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+	frame.light2Position = glm::vec4(-20.0f, 70.0f, 10.0f, 1.0f);
+	frame.viewPosition = glm::vec4(gViewCamera.Position, 1.0f);
+	frame.ambient = glm::vec4(1.0f, 1.0f, 1.0f, 0.1f); // white at 10% strength
+}
+// Fill the scene table with every object of the final project scene //
+void CreateScene()
+{
+	SceneObject object;
+	int group;
+	const glm::vec3 unitScale(1.0f, 1.0f, 1.0f);
+	const glm::vec3 yAxis(0.0f, 1.0f, 0.0f);
 
-	//glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	//glDrawArrays(GL_TRIANGLE_FAN, 36, 72);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
+	/*          TruFuel Can          */
+	// Assembly node, the parts below are placed relative to the base of the can
+	group = gSceneGraph.AddNode(NO_PARENT, MakeTransform(unitScale, 0.0f, yAxis, glm::vec3(0.0f, 0.0f, 0.0f)));
 
-	// Deactivate the VAO for box
-	glBindVertexArray(0);
+	/*     Main Cylinder Body     */
+	object = MakeSceneObject("can body", meshes.gCylinderMesh, gTextureArray, LAYER_LABELS,
+		MakeMaterial(1.0f, 16.0f, 1.0f, 16.0f),
+		gSceneGraph.AddNode(group, MakeTransform(glm::vec3(3.0f, 8.0f, 3.0f), 0.0f, glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f))));
+	SetTextureRegion(object, gLabelAtlas.GetUvRect(ATLAS_GAS_CAN));
+	AddDrawRange(object, ArraysRange(GL_TRIANGLE_STRIP, 72, 146));	//sides
+	SetMeshLod(object, meshes.gCylinderLod);
+	SetOccluder(object, glm::vec3(0.7f, 1.0f, 0.7f));				//square inside the round body
+	gScene.push_back(object);
 
 	/*     Tapered Aluminum Portion     */
+	object = MakeSceneObject("can cone", meshes.gConeMesh, gTextureArray, LAYER_ALUMINUM,
+		MakeMaterial(1.0f, 30.0f, 1.0f, 30.0f),
+		gSceneGraph.AddNode(group, MakeTransform(glm::vec3(3.0f, 2.0f, 3.0f), 0.0f, glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 8.0f, 0.0f))));
+	AddDrawRange(object, ArraysRange(GL_TRIANGLE_STRIP, 36, 108));
+	SetMeshLod(object, meshes.gConeLod);
+	gScene.push_back(object);
 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gConeMesh.vao);
-
-	// Set the mesh transfomation values
-	scale = glm::scale(glm::vec3(3.0f, 2.0f, 3.0f));
-	rotation = glm::rotate(0.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-	translation = glm::translate(glm::vec3(0.0f, 8.0f, 0.0f));
-	model = translation * rotation * scale;
-
-
-	ubHasTextureVal = true;
-	glUniform1i(ubHasTextureLoc, ubHasTextureVal);
-
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureId2);
-
-
-	// Remaining Object Specific Uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(objectColorLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniform1f(specularIntensity1Loc, 1.0f);
-	glUniform1f(specularIntensity2Loc, 1.0f);
-	glUniform1f(highlightSize1Loc, 30.0f);
-	glUniform1f(highlightSize2Loc, 30.0f);
-
-	//glDrawElements(GL_TRIANGLES, meshes.gPyramid4Mesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-	glDrawArrays(GL_TRIANGLE_STRIP, 36, 108);
-
-	// Deactivate the VAO for box
-	glBindVertexArray(0);
 	/*     Rim Around Aluminum     */
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTorusMesh.vao);
-
-	// Set the mesh transfomation values
-	scale = glm::scale(glm::vec3(2.9f, 2.9f, 1.0f));
-	rotation = glm::rotate(1.57f, glm::vec3(1.0f, 0.0f, 0.0f));
-	translation = glm::translate(glm::vec3(0.0f, 8.0f, 0.0f));
-	model = translation * rotation * scale;
-
-
-	ubHasTextureVal = true;
-	glUniform1i(ubHasTextureLoc, ubHasTextureVal);
-
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureId2);
+	object = MakeSceneObject("can rim", meshes.gTorusMesh, gTextureArray, LAYER_ALUMINUM,
+		MakeMaterial(1.0f, 16.0f, 1.0f, 16.0f),
+		gSceneGraph.AddNode(group, MakeTransform(glm::vec3(2.9f, 2.9f, 1.0f), 1.57f, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 8.0f, 0.0f))));
+	AddDrawRange(object, ArraysRange(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices));
+	SetMeshLod(object, meshes.gTorusLod);
+	gScene.push_back(object);
 
-
-	// Remaining Object Specific Uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(objectColorLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniform1f(specularIntensity1Loc, 1.0f);
-	glUniform1f(specularIntensity2Loc, 1.0f);
-	glUniform1f(highlightSize1Loc, 16.0f);
-	glUniform1f(highlightSize2Loc, 16.0f);
-
-	//glDrawElements(GL_TRIANGLES, meshes.gPyramid4Mesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-	glDrawArrays(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices);
-
-	// Deactivate the VAO for box
-	glBindVertexArray(0);
 	/*     Cap     */
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-
-	// Set the mesh transfomation values
-	scale = glm::scale(glm::vec3(1.0f, 1.5f, 1.0f));
-	rotation = glm::rotate(0.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-	translation = glm::translate(glm::vec3(0.0f, 9.0f, 0.0f));
-	model = translation * rotation * scale;
-
-
-	ubHasTextureVal = true;
-	glUniform1i(ubHasTextureLoc, ubHasTextureVal);
-
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureId3);
+	object = MakeSceneObject("can cap", meshes.gCylinderMesh, gTextureArray, LAYER_LABELS,
+		MakeMaterial(1.0f, 16.0f, 0.1f, 16.0f),
+		gSceneGraph.AddNode(group, MakeTransform(glm::vec3(1.0f, 1.5f, 1.0f), 0.0f, glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 9.0f, 0.0f))));
+	SetTextureRegion(object, gLabelAtlas.GetUvRect(ATLAS_CAP));
+	AddDrawRange(object, ArraysRange(GL_TRIANGLE_FAN, 0, 36));		//bottom
+	AddDrawRange(object, ArraysRange(GL_TRIANGLE_FAN, 36, 72));		//top
+	AddDrawRange(object, ArraysRange(GL_TRIANGLE_STRIP, 72, 146));	//sides
+	SetMeshLod(object, meshes.gCylinderLod);
+	gScene.push_back(object);
 
-
-	// Remaining Object Specific Uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(objectColorLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniform1f(specularIntensity1Loc, 1.0f);
-	glUniform1f(specularIntensity2Loc, 0.1f);
-	glUniform1f(highlightSize1Loc, 16.0f);
-	glUniform1f(highlightSize2Loc, 16.0f);
-
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 72);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the VAO for box
-	glBindVertexArray(0);
 	/*          Trimmer Spool          */
+	group = gSceneGraph.AddNode(NO_PARENT, MakeTransform(unitScale, 0.0f, yAxis, glm::vec3(15.0f, 0.0f, 0.0f)));
 
 	/*     Torus     */
-
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTorusMesh.vao);
-
-	// Set the mesh transfomation values
-	scale = glm::scale(glm::vec3(8.0f, 8.0f, 12.0f));
-	rotation = glm::rotate(1.57f, glm::vec3(1.0f, 0.0f, 0.0f));
-	translation = glm::translate(glm::vec3(15.0f, 1.2f, 0.0f));
-	model = translation * rotation * scale;
-
-
-	ubHasTextureVal = true;
-	glUniform1i(ubHasTextureLoc, ubHasTextureVal);
-
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureId4);
-
-
-	// Remaining Object Specific Uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(objectColorLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniform1f(specularIntensity1Loc, 0.1f);
-	glUniform1f(specularIntensity2Loc, 0.1f);
-	glUniform1f(highlightSize1Loc, 16.0f);
-	glUniform1f(highlightSize2Loc, 16.0f);
-
-	//glDrawElements(GL_TRIANGLES, meshes.gPyramid4Mesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-	glDrawArrays(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices);
-
-	// Deactivate the VAO for box
-	glBindVertexArray(0);
-	// Flips the the back buffer with the front buffer every frame (refresh)
+	object = MakeSceneObject("spool line", meshes.gTorusMesh, gTextureArray, LAYER_TRIMMER_LINE,
+		MakeMaterial(0.1f, 16.0f, 0.1f, 16.0f),
+		gSceneGraph.AddNode(group, MakeTransform(glm::vec3(8.0f, 8.0f, 12.0f), 1.57f, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.2f, 0.0f))));
+	AddDrawRange(object, ArraysRange(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices));
+	SetMeshLod(object, meshes.gTorusLod);
+	gScene.push_back(object);
 
 	/*     Inner Portion     */
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-
-	// Set the mesh transfomation values
-	scale = glm::scale(glm::vec3(8.0f, 2.4f, 8.0f));
-	rotation = glm::rotate(0.0f, glm::vec3(1.0f, 0.0f, 0.0f));
-	translation = glm::translate(glm::vec3(15.0f, 0.0f, 0.0f));
-	model = translation * rotation * scale;
-
+	object = MakeSceneObject("spool label", meshes.gCylinderMesh, gTextureArray, LAYER_LABELS,
+		MakeMaterial(0.1f, .01f, 0.1f, .01f),
+		gSceneGraph.AddNode(group, MakeTransform(glm::vec3(8.0f, 2.4f, 8.0f), 0.0f, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f))));
+	SetTextureRegion(object, gLabelAtlas.GetUvRect(ATLAS_SPOOL_LABEL));
+	AddDrawRange(object, ArraysRange(GL_TRIANGLE_FAN, 36, 72));		//top
+	SetMeshLod(object, meshes.gCylinderLod);
+	gScene.push_back(object);
 
-	ubHasTextureVal = true;
-	glUniform1i(ubHasTextureLoc, ubHasTextureVal);
-
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureId5);
-
-
-	// Remaining Object Specific Uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(objectColorLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniform1f(specularIntensity1Loc, 0.1f);
-	glUniform1f(specularIntensity2Loc, 0.1f);
-	glUniform1f(highlightSize1Loc, .01f);
-	glUniform1f(highlightSize2Loc, .01f);
-
-	//glDrawElements(GL_TRIANGLES, meshes.gPyramid4Mesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-	//glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 72);		//top
-	//glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the VAO for box
-	glBindVertexArray(0);
 	/*          Chainsaw Box          */
-	/*     Box     */
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gBoxMesh.vao);
-
-	// Set the mesh transfomation values
-	scale = glm::scale(glm::vec3(15.0f, 30.0f, 15.0f));
-	rotation = glm::rotate(0.25f, glm::vec3(0.0f, 1.0f, 0.0f));
-	translation = glm::translate(glm::vec3(-15.0f, 15.0f, 0.0f));
-	model = translation * rotation * scale;
+	object = MakeSceneObject("chainsaw box", meshes.gBoxMesh, gTextureArray, LAYER_LABELS,
+		MakeMaterial(0.1f, 16.0f, 0.1f, 16.0f),
+		gSceneGraph.AddNode(NO_PARENT, MakeTransform(glm::vec3(15.0f, 30.0f, 15.0f), 0.25f, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(-15.0f, 15.0f, 0.0f))));
+	SetTextureRegion(object, gLabelAtlas.GetUvRect(ATLAS_CHAINSAW));
+	AddDrawRange(object, ElementsRange(GL_TRIANGLES, 0, meshes.gBoxMesh.nIndices));
+	SetOccluder(object, glm::vec3(1.0f, 1.0f, 1.0f));
+	gScene.push_back(object);
 
-
-	ubHasTextureVal = true;
-	glUniform1i(ubHasTextureLoc, ubHasTextureVal);
-
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureId7);
-
-
-	// Remaining Object Specific Uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(objectColorLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniform1f(specularIntensity1Loc, 0.1f);
-	glUniform1f(specularIntensity2Loc, 0.1f);
-	glUniform1f(highlightSize1Loc, 16.0f);
-	glUniform1f(highlightSize2Loc, 16.0f);
-
-	//glDrawElements(GL_TRIANGLES, meshes.gPyramid4Mesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-	glDrawElements(GL_TRIANGLES, meshes.gBoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	// Deactivate the VAO for box
-	glBindVertexArray(0);
 	/*          Trimmer Box          */
-	/*     Big Box     */
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gBoxMesh.vao);
-
-	// Set the mesh transfomation values
-	scale = glm::scale(glm::vec3(20.0f, 40.0f, 10.0f));
-	rotation = glm::rotate(0.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-	translation = glm::translate(glm::vec3(-50.0f, 20.0f, 0.0f));
-	model = translation * rotation * scale;
-
-
-	ubHasTextureVal = true;
-	glUniform1i(ubHasTextureLoc, ubHasTextureVal);
-
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureId9);
-
-
-	// Remaining Object Specific Uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(objectColorLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniform1f(specularIntensity1Loc, 1.0f);
-	glUniform1f(specularIntensity2Loc, 0.1f);
-	glUniform1f(highlightSize1Loc, 16.0f);
-	glUniform1f(highlightSize2Loc, 16.0f);
+	group = gSceneGraph.AddNode(NO_PARENT, MakeTransform(unitScale, 0.0f, yAxis, glm::vec3(-50.0f, 0.0f, 0.0f)));
 
-	//glDrawElements(GL_TRIANGLES, meshes.gPyramid4Mesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-	glDrawElements(GL_TRIANGLES, meshes.gBoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+	/*     Big Box     */
+	object = MakeSceneObject("trimmer box", meshes.gBoxMesh, gTextureArray, LAYER_RED,
+		MakeMaterial(1.0f, 16.0f, 0.1f, 16.0f),
+		gSceneGraph.AddNode(group, MakeTransform(glm::vec3(20.0f, 40.0f, 10.0f), 0.0f, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 20.0f, 0.0f))));
+	AddDrawRange(object, ElementsRange(GL_TRIANGLES, 0, meshes.gBoxMesh.nIndices));
+	SetOccluder(object, glm::vec3(1.0f, 1.0f, 1.0f));
+	gScene.push_back(object);
 
-	// Deactivate the VAO for box
-	glBindVertexArray(0);
 	/*     Small Box     */
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gBoxMesh.vao);
-
-	// Set the mesh transfomation values
-	scale = glm::scale(glm::vec3(20.0f, 15.0f, 10.0f));
-	rotation = glm::rotate(0.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-	translation = glm::translate(glm::vec3(-50.0f, 7.5f, 10.0f));
-	model = translation * rotation * scale;
-
-
-	ubHasTextureVal = true;
-	glUniform1i(ubHasTextureLoc, ubHasTextureVal);
-
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureId9);
-
+	object = MakeSceneObject("trimmer box base", meshes.gBoxMesh, gTextureArray, LAYER_RED,
+		MakeMaterial(1.0f, 16.0f, 0.1f, 16.0f),
+		gSceneGraph.AddNode(group, MakeTransform(glm::vec3(20.0f, 15.0f, 10.0f), 0.0f, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 7.5f, 10.0f))));
+	AddDrawRange(object, ElementsRange(GL_TRIANGLES, 0, meshes.gBoxMesh.nIndices));
+	SetOccluder(object, glm::vec3(1.0f, 1.0f, 1.0f));
+	gScene.push_back(object);
 
-	// Remaining Object Specific Uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(objectColorLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniform1f(specularIntensity1Loc, 1.0f);
-	glUniform1f(specularIntensity2Loc, 0.1f);
-	glUniform1f(highlightSize1Loc, 16.0f);
-	glUniform1f(highlightSize2Loc, 16.0f);
-
-	//glDrawElements(GL_TRIANGLES, meshes.gPyramid4Mesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-	glDrawElements(GL_TRIANGLES, meshes.gBoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	// Deactivate the VAO for box
-	glBindVertexArray(0);
 	/*          Plane          */
-	glBindVertexArray(meshes.gPlaneMesh.vao);
-
-	// Set the mesh transfomation values
-	scale = glm::scale(glm::vec3(100.0f, 100.0f, 100.0f));
-	rotation = glm::rotate(0.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-	translation = glm::translate(glm::vec3(0.0f, 0.0f, 0.0f));
-	model = translation * rotation * scale;
-
-
-	ubHasTextureVal = true;
-	glUniform1i(ubHasTextureLoc, ubHasTextureVal);
-
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureId8);
-
-
-	// Remaining Object Specific Uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(objectColorLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniform1f(specularIntensity1Loc, 0.001f);
-	glUniform1f(specularIntensity2Loc, 0.001f);
-	glUniform1f(highlightSize1Loc, 50.0f);
-	glUniform1f(highlightSize2Loc, 50.0f);
-
-	glDrawElements(GL_TRIANGLES, meshes.gPlaneMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	// Deactivate the VAO for box
-	glBindVertexArray(0);
+	object = MakeSceneObject("floor", meshes.gPlaneMesh, gTextureArray, LAYER_CONCRETE,
+		MakeMaterial(0.001f, 50.0f, 0.001f, 50.0f),
+		gSceneGraph.AddNode(NO_PARENT, MakeTransform(glm::vec3(100.0f, 100.0f, 100.0f), 0.0f, glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f))));
+	AddDrawRange(object, ElementsRange(GL_TRIANGLES, 0, meshes.gPlaneMesh.nIndices));
+	SetOccluder(object, glm::vec3(1.0f, 1.0f, 1.0f));
+	gScene.push_back(object);
+}
+void CreateShelfScene(int units)
+{
+	const int unitsPerRow = 40;
+	SceneObject object;
 
-	glfwSwapBuffers(gWindow);
+	for (int i = 0; i < units; ++i)
+	{
+		const float x = -80.0f + 4.0f * (i % unitsPerRow);
+		const float z = -40.0f - 6.0f * (i / unitsPerRow);
+
+		// Assembly node, moving it moves the box and the can on top
+		const int unit = gSceneGraph.AddNode(NO_PARENT, MakeTransform(glm::vec3(1.0f, 1.0f, 1.0f), 0.0f, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(x, 0.0f, z)));
+
+		/*     Shelf Box     */
+		object = MakeSceneObject("shelf box", meshes.gBoxMesh, gTextureArray, LAYER_LABELS,
+			MakeMaterial(0.1f, 16.0f, 0.1f, 16.0f),
+			gSceneGraph.AddNode(unit, MakeTransform(glm::vec3(3.5f, 2.0f, 3.5f), 0.0f, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f))));
+		SetTextureRegion(object, gLabelAtlas.GetUvRect(ATLAS_CHAINSAW));
+		AddDrawRange(object, ElementsRange(GL_TRIANGLES, 0, meshes.gBoxMesh.nIndices));
+		SetOccluder(object, glm::vec3(1.0f, 1.0f, 1.0f));
+		gScene.push_back(object);
+
+		/*     Gas Can     */
+		object = MakeSceneObject("shelf can", meshes.gCylinderMesh, gTextureArray, LAYER_LABELS,
+			MakeMaterial(1.0f, 16.0f, 1.0f, 16.0f),
+			gSceneGraph.AddNode(unit, MakeTransform(glm::vec3(1.0f, 2.5f, 1.0f), 0.0f, glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 2.0f, 0.0f))));
+		SetTextureRegion(object, gLabelAtlas.GetUvRect(ATLAS_GAS_CAN));
+		AddDrawRange(object, ArraysRange(GL_TRIANGLE_STRIP, 72, 146));	//sides
+		SetMeshLod(object, meshes.gCylinderLod);
+		SetOccluder(object, glm::vec3(0.7f, 1.0f, 0.7f));
+		gScene.push_back(object);
+	}
 }
 //****************************************************
 //  const char* vtxShaderSource: vertex shader source code
 //  const char* fragShaderSource: fragment shader source code
 //  GLuint &programId: unique ID of program associated with shaders
+//  UniformLayout &uniforms: uniform locations, resolved once after linking
 //****************************************************
-bool CreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+bool CreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId, UniformLayout& uniforms)
 {
 	// Compilation and linkage error reporting
 	int success = 0;
@@ -852,6 +1614,9 @@ bool CreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSour
 		return false;
 	}
 
+	// Cache the uniform locations so the render loop never looks them up by name
+	CreateUniformLayout(programId, uniforms);
+
 	// Uses the shader program
 	glUseProgram(programId);
 
@@ -923,7 +1688,7 @@ bool CreateTexture(const char* filename, GLuint& textureId)
 // Release the texture attached to textureId //
 void DestroyTexture(GLuint textureId)
 {
-	glGenTextures(1, &textureId);
+	glDeleteTextures(1, &textureId);
 }
 void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos) //callback for mouse x,y
 {
@@ -940,7 +1705,9 @@ void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos) //call
 	gLastX = xpos;
 	gLastY = ypos;
 
-	gCamera.ProcessMouseMovement(xoffset, yoffset);
+	// Turned by the next simulation step, like the keys
+	gMouseOffsetX += xoffset;
+	gMouseOffsetY += yoffset;
 }
 void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset) //call back for scroll wheel
 {
@@ -981,4 +1748,112 @@ void UMouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 		std::cout << "Unhandled mouse button event" << std::endl;
 		break;
 	}
+}
+void UKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) //callback for single key presses
+{
+	if (action != GLFW_PRESS)
+		return;
+
+	switch (key)
+	{
+	case GLFW_KEY_M:
+	{
+		// Switch between multi-draw indirect from the arena and per-batch draws
+		gRenderQueue.SetMultiDrawIndirect(!gRenderQueue.GetMultiDrawIndirect());
+		std::cout << "Multi-draw indirect " << (gRenderQueue.GetMultiDrawIndirect() ? "on" : "off") << std::endl;
+		gRenderStatsReported = false;
+	}
+	break;
+
+	case GLFW_KEY_T:
+	{
+		// Switch the per-object frame stages between the job system and the render thread
+		gParallelFrame = !gParallelFrame && gWorkerPool.GetThreadCount() > 1;
+		gRenderQueue.SetWorkerPool(gParallelFrame ? &gWorkerPool : nullptr);
+		std::cout << "Parallel frame stages " << (gParallelFrame ? "on" : "off") << std::endl;
+		gRenderStatsReported = false;
+	}
+	break;
+
+	case GLFW_KEY_Z:
+	{
+		// Switch the depth-only pass ahead of the Phong shading on or off
+		gRenderQueue.SetDepthPrePass(!gRenderQueue.GetDepthPrePass());
+		std::cout << "Depth pre-pass " << (gRenderQueue.GetDepthPrePass() ? "on" : "off") << std::endl;
+		gRenderStatsReported = false;
+	}
+	break;
+
+	case GLFW_KEY_B:
+	{
+		// Switch between the BVH and the flat frustum test
+		gBvhEnabled = !gBvhEnabled;
+		std::cout << "BVH culling " << (gBvhEnabled ? "on" : "off") << std::endl;
+		gRenderStatsReported = false;
+	}
+	break;
+
+	case GLFW_KEY_O:
+	{
+		// Switch the Hi-Z occlusion test of the multi-draw commands on or off
+		gOcclusion.SetEnabled(!gOcclusion.GetEnabled());
+		std::cout << "Occlusion culling " << (gOcclusion.GetEnabled() ? "on" : "off") << std::endl;
+		gRenderStatsReported = false;
+	}
+	break;
+
+	case GLFW_KEY_R:
+	{
+		// Switch the CPU occlusion pass on or off
+		gSoftwareOcclusion.SetEnabled(!gSoftwareOcclusion.GetEnabled());
+		std::cout << "Software occlusion culling " << (gSoftwareOcclusion.GetEnabled() ? "on" : "off") << std::endl;
+		gRenderStatsReported = false;
+	}
+	break;
+
+	case GLFW_KEY_L:
+	{
+		// Switch level-of-detail selection on or off
+		gLodSelector.SetEnabled(!gLodSelector.GetEnabled());
+		std::cout << "Level of detail " << (gLodSelector.GetEnabled() ? "on" : "off") << std::endl;
+		gRenderStatsReported = false;
+	}
+	break;
+
+	case GLFW_KEY_F:
+	{
+		// Frame times since the last press
+		gFrameTimer.PrintSummary(std::cout, "Frame times");
+		gFrameTimer.Reset();
+		std::cout << "INFO: " << gSimulation.GetStepCount() << " simulation steps of " << gSimulation.GetStepSeconds() * 1000.0
+			<< " ms, " << gSimulation.GetSimulatedSeconds() << " s simulated, " << gSimulation.GetDroppedSteps() << " steps dropped" << std::endl;
+	}
+	break;
+
+	case GLFW_KEY_G:
+	{
+		// The first press starts the profiler, the next ones print the GPU and CPU time per pass
+		// and per batch since the last press
+		if (!gProfiler.GetEnabled())
+		{
+			gProfiler.SetEnabled(true);
+			std::cout << "GPU profiler on, press G again for the summary" << std::endl;
+		}
+		else
+			gProfiler.PrintSummary(std::cout);
+	}
+	break;
+
+	case GLFW_KEY_C:
+	{
+		// Switch view-frustum culling on or off
+		gCullingEnabled = !gCullingEnabled;
+		std::cout << "Frustum culling " << (gCullingEnabled ? "on" : "off") << std::endl;
+		gRenderStatsReported = false;
+	}
+	break;
+
+	default:
+		break;
+	}
 }
\ No newline at end of file
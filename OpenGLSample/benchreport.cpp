@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchreport.cpp
+// ========
+// JSON report of a benchmark run
+///////////////////////////////////////////////////////////////////////////////
+
+#include "benchreport.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+	// Field names of the counters, in the order AddFrame stores them
+	const char* const COUNTER_NAMES[] =
+	{
+		"draw_calls", "triangles", "objects", "program_binds", "vao_binds",
+		"texture_binds", "material_updates", "instanced_draws", "multi_draw_calls", "indirect_commands",
+		"visible_objects", "culled_objects", "bvh_nodes_tested", "hiz_tested", "hiz_occluded", "gl_state_calls_issued", "gl_state_calls_elided"
+	};
+
+	// String with the quotes, backslashes and control characters escaped
+	std::string JsonString(const std::string& text)
+	{
+		std::string quoted = "\"";
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+			{
+				quoted += '\\';
+				quoted += c;
+			}
+			else if ((unsigned char)c < 0x20)
+				quoted += ' ';
+			else
+				quoted += c;
+		}
+		return quoted + "\"";
+	}
+}
+
+BenchmarkReport::BenchmarkReport()
+	: mFrames(0)
+{
+	for (int i = 0; i < COUNTERS; ++i)
+	{
+		mTotals[i] = 0;
+		mMaxima[i] = 0;
+	}
+}
+
+///////////////////////////////////////////////////
+//	AddFrame(const RenderStats&, unsigned int, const CullingCounters&, const GLStateCounters&)
+///////////////////////////////////////////////////
+void BenchmarkReport::AddFrame(const RenderStats& stats, unsigned int triangles, const CullingCounters& culling, const GLStateCounters& glCalls)
+{
+	const uint64_t counters[COUNTERS] =
+	{
+		stats.drawCalls, triangles, stats.objects, stats.programBinds, stats.vaoBinds,
+		stats.textureBinds, stats.materialUpdates, stats.instancedDraws, stats.multiDrawCalls, stats.indirectCommands,
+		culling.visible, culling.culled, culling.bvhNodes, culling.hizTested, culling.hizOccluded, glCalls.GetIssued(), glCalls.GetElided()
+	};
+	for (int i = 0; i < COUNTERS; ++i)
+	{
+		mTotals[i] += counters[i];
+		mMaxima[i] = std::max(mMaxima[i], counters[i]);
+	}
+	++mFrames;
+}
+
+///////////////////////////////////////////////////
+//	Write(const char*, const BenchmarkInfo&, const FrameTimer&)
+//
+//	Every counter appears as a total over the
+//	measured frames, a per-frame mean and a maximum
+///////////////////////////////////////////////////
+bool BenchmarkReport::Write(const char* path, const BenchmarkInfo& info, const FrameTimer& timer) const
+{
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "ERROR::BENCHMARK::REPORT_NOT_WRITTEN " << path << std::endl;
+		return false;
+	}
+
+	FrameSummary summary = {};
+	timer.GetSummary(summary);
+
+	file << std::fixed << std::setprecision(4);
+	file << "{\n";
+	file << "  \"renderer\": " << JsonString(info.renderer) << ",\n";
+	file << "  \"width\": " << info.width << ",\n";
+	file << "  \"height\": " << info.height << ",\n";
+	file << "  \"objects\": " << info.objects << ",\n";
+	file << "  \"camera_path\": " << JsonString(info.cameraPath) << ",\n";
+	file << "  \"timestep\": " << std::setprecision(6) << info.timestep << std::setprecision(4) << ",\n";
+	file << "  \"warmup_frames\": " << info.warmupFrames << ",\n";
+	file << "  \"depth_prepass\": " << (info.depthPrePass ? "true" : "false") << ",\n";
+	file << "  \"texture_array\": " << (info.textureArray ? "true" : "false") << ",\n";
+	file << "  \"frames\": " << summary.frames << ",\n";
+	file << "  \"seconds\": " << summary.seconds << ",\n";
+	file << "  \"fps\": " << summary.fps << ",\n";
+	file << "  \"frame_ms\": { \"min\": " << summary.min << ", \"mean\": " << summary.mean
+		<< ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95
+		<< ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << " },\n";
+	file << "  \"counters\": {\n";
+	for (int i = 0; i < COUNTERS; ++i)
+	{
+		const double mean = mFrames > 0 ? (double)mTotals[i] / mFrames : 0.0;
+		file << "    " << JsonString(COUNTER_NAMES[i]) << ": { \"total\": " << mTotals[i]
+			<< ", \"per_frame\": " << mean << ", \"max\": " << mMaxima[i] << " }"
+			<< (i + 1 < COUNTERS ? ",\n" : "\n");
+	}
+	file << "  }\n";
+	file << "}\n";
+
+	if (!file.good())
+	{
+		std::cout << "ERROR::BENCHMARK::REPORT_NOT_WRITTEN " << path << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchreport.h
+// ========
+// JSON report of a benchmark run
+//
+//	The counters of the render queue are summed over the measured frames
+//	and written next to the frame-time percentiles, with the renderer,
+//	resolution and camera path that produced them. Two builds run on the
+//	same path draw the same frames, so their reports can be diffed field
+//	by field.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "frametiming.h"
+#include "glstate.h"
+#include "renderqueue.h"
+
+// Conditions of the run, copied into the report
+struct BenchmarkInfo
+{
+	std::string renderer;
+	int width;
+	int height;
+	size_t objects;             // Entries of the scene table
+	std::string cameraPath;     // Empty when the camera did not move
+	double timestep;            // Simulated seconds per frame
+	int warmupFrames;
+	bool depthPrePass;          // Scene drawn after a depth-only pass
+	bool textureArray;          // Scene textures in one array, else one GL_TEXTURE_2D each
+};
+
+// Culling results of a frame that the render queue does not count itself
+struct CullingCounters
+{
+	unsigned int visible;       // Objects passing the view frustum test
+	unsigned int culled;        // Objects rejected by it
+	unsigned int bvhNodes;      // BVH nodes tested, 0 when the flat test ran
+	unsigned int hizTested;     // Objects of the multi-draws tested against the Hi-Z pyramid
+	unsigned int hizOccluded;   // Of those, found hidden, read back a few frames late
+};
+
+class BenchmarkReport
+{
+public:
+	BenchmarkReport();
+
+	// Add the counters of one measured frame, triangles as counted by the LodSelector
+	void AddFrame(const RenderStats& stats, unsigned int triangles, const CullingCounters& culling, const GLStateCounters& glCalls);
+
+	// Write the report, prints an error and returns false when the file cannot be written
+	bool Write(const char* path, const BenchmarkInfo& info, const FrameTimer& timer) const;
+
+private:
+	static const int COUNTERS = 17;
+
+	uint64_t mTotals[COUNTERS];
+	uint64_t mMaxima[COUNTERS];
+	uint64_t mFrames;
+};
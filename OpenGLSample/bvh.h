@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+// bvh.h
+// ========
+// bounding volume hierarchy over the world boxes of the scene objects
+//
+//	The tree is built top-down with the surface area heuristic and stored as
+//	one array of nodes. The two children of a node are adjacent and always
+//	come after it, so a reverse walk of the array refits the boxes bottom-up
+//	when objects move. Every node covers a contiguous range of the object
+//	index array, which lets the frustum test accept a whole subtree at once.
+//	Given a worker pool, the subtrees below the top levels are tested in
+//	parallel.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+
+class WorkerPool;
+
+// One node of the linear tree, 36 bytes
+struct BvhNode
+{
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	int firstObject;    // Range of the object index array covered by the node
+	int objectCount;
+	int leftChild;      // Right child is leftChild + 1, 0 for leaves (the root is never a child)
+};
+
+class Bvh
+{
+public:
+	// Build the tree over one box per object
+	void Build(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax);
+
+	// Keep the topology and recompute the node boxes from moved objects
+	void Refit(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax);
+
+	// Same contract as FrustumCuller::Cull. nodesVisited receives the number of nodes tested.
+	size_t Cull(const Frustum& frustum, std::vector<unsigned char>& visible, size_t* nodesVisited = nullptr, WorkerPool* pool = nullptr) const;
+
+	size_t GetObjectCount() const { return mObjectMin.size(); }
+	size_t GetNodeCount() const { return mNodes.size(); }
+
+private:
+	// Node still to test and the planes its parent straddled
+	struct CullEntry
+	{
+		int node;
+		unsigned int planeMask;
+		int depth;
+	};
+
+	// Test the subtree of start, handing the children at SPLIT_DEPTH to subtrees when given
+	size_t CullSubtree(const Frustum& frustum, const CullEntry& start, std::vector<unsigned char>& visible, size_t& visited,
+		std::vector<CullEntry>* subtrees) const;
+
+	void UpdateNodeBounds(BvhNode& node) const;
+	void Subdivide(int nodeIndex, const std::vector<glm::vec3>& centroids);
+
+	std::vector<BvhNode> mNodes;
+	std::vector<int> mIndices;          // Object ids, reordered so each node's objects are contiguous
+	std::vector<glm::vec3> mObjectMin;
+	std::vector<glm::vec3> mObjectMax;
+};
+
+// Time flat and hierarchical culling of 1k, 10k and 100k synthetic objects
+void RunCullingBenchmark();
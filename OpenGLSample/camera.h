@@ -118,6 +118,15 @@ public:
 			Zoom = 45.0f;
 	}
 
+	// places the camera at a position facing the given Euler angles, used to replay a recorded path
+	void SetPose(glm::vec3 position, float yaw, float pitch)
+	{
+		Position = position;
+		Yaw = yaw;
+		Pitch = pitch;
+		updateCameraVectors();
+	}
+
 private:
 	// calculates the front vector from the Camera's (updated) Euler Angles
 	void updateCameraVectors()
@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.cpp
+// ========
+// keyframed camera path replayed by benchmark runs
+///////////////////////////////////////////////////////////////////////////////
+
+#include "camerapath.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	// Catmull-Rom segment from b to c at t in [0, 1]
+	template <typename T>
+	T CatmullRom(const T& a, const T& b, const T& c, const T& d, float t)
+	{
+		const float t2 = t * t;
+		const float t3 = t2 * t;
+		return 0.5f * ((2.0f * b) + (c - a) * t + (2.0f * a - 5.0f * b + 4.0f * c - d) * t2
+			+ (3.0f * b - a - 3.0f * c + d) * t3);
+	}
+}
+
+///////////////////////////////////////////////////
+//	Load(const char*)
+//
+//	A path needs two keys at least, with times
+//	strictly increasing
+///////////////////////////////////////////////////
+bool CameraPath::Load(const char* path)
+{
+	mKeys.clear();
+	mName = path;
+
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		std::cout << "ERROR::CAMERAPATH::FILE_NOT_FOUND " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		++lineNumber;
+		std::istringstream fields(line);
+		std::string first;
+		if (!(fields >> first) || first[0] == '#')
+			continue;
+
+		CameraKey key;
+		fields.clear();
+		fields.str(line);
+		if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch))
+		{
+			std::cout << "ERROR::CAMERAPATH::BAD_KEY " << path << ":" << lineNumber << std::endl;
+			mKeys.clear();
+			return false;
+		}
+		if (!mKeys.empty() && key.time <= mKeys.back().time)
+		{
+			std::cout << "ERROR::CAMERAPATH::TIME_NOT_INCREASING " << path << ":" << lineNumber << std::endl;
+			mKeys.clear();
+			return false;
+		}
+		mKeys.push_back(key);
+	}
+
+	if (mKeys.size() < 2)
+	{
+		std::cout << "ERROR::CAMERAPATH::TOO_FEW_KEYS " << path << std::endl;
+		mKeys.clear();
+		return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	Sample(float)
+//
+//	The end keys are repeated to stand in for the
+//	missing neighbours of the first and last segment.
+//	Yaw and pitch are splined as plain numbers, so a
+//	path turning past 180 degrees lists yaw values
+//	beyond that rather than wrapping.
+///////////////////////////////////////////////////
+CameraKey CameraPath::Sample(float time) const
+{
+	if (mKeys.empty())
+		return CameraKey{ time, glm::vec3(0.0f), -90.0f, 0.0f };
+	if (time <= mKeys.front().time)
+		return mKeys.front();
+	if (time >= mKeys.back().time)
+		return mKeys.back();
+
+	size_t segment = 0;
+	while (mKeys[segment + 1].time <= time)
+		++segment;
+
+	const CameraKey& b = mKeys[segment];
+	const CameraKey& c = mKeys[segment + 1];
+	const CameraKey& a = segment > 0 ? mKeys[segment - 1] : b;
+	const CameraKey& d = segment + 2 < mKeys.size() ? mKeys[segment + 2] : c;
+	const float t = (time - b.time) / (c.time - b.time);
+
+	CameraKey key;
+	key.time = time;
+	key.position = CatmullRom(a.position, b.position, c.position, d.position, t);
+	key.yaw = CatmullRom(a.yaw, b.yaw, c.yaw, d.yaw, t);
+	key.pitch = CatmullRom(a.pitch, b.pitch, c.pitch, d.pitch, t);
+	return key;
+}
+
+///////////////////////////////////////////////////
+//	GetDuration()
+///////////////////////////////////////////////////
+float CameraPath::GetDuration() const
+{
+	return mKeys.empty() ? 0.0f : mKeys.back().time;
+}
@@ -0,0 +1,48 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.h
+// ========
+// keyframed camera path replayed by benchmark runs
+//
+//	A path is a list of keys, each a time in seconds, a position and the
+//	yaw and pitch of the camera in degrees. The file holds one key per line
+//	as "time x y z yaw pitch", blank lines and lines starting with # are
+//	skipped, and times must increase. Between two keys the pose follows a
+//	Catmull-Rom spline through the neighbouring keys, so the camera moves
+//	without a jolt at each key. Sampling depends only on the time passed
+//	in, never on the clock, so every run of a path draws the same frames.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Camera pose at one point of the path
+struct CameraKey
+{
+	float time;         // Seconds from the start of the path
+	glm::vec3 position;
+	float yaw;          // Degrees, as Camera::Yaw
+	float pitch;        // Degrees, as Camera::Pitch
+};
+
+class CameraPath
+{
+public:
+	// Read the keys of a path file, prints an error and returns false on a bad file
+	bool Load(const char* path);
+
+	// Pose at a time, held at the first and last key outside the path
+	CameraKey Sample(float time) const;
+
+	// Time of the last key
+	float GetDuration() const;
+	size_t GetKeyCount() const { return mKeys.size(); }
+	const std::string& GetName() const { return mName; }
+
+private:
+	std::vector<CameraKey> mKeys;
+	std::string mName;
+};
@@ -0,0 +1,241 @@
+///////////////////////////////////////////////////////////////////////////////
+// culling.cpp
+// ========
+// view-frustum culling of the scene objects
+///////////////////////////////////////////////////////////////////////////////
+
+#include "culling.h"
+
+#include <atomic>
+
+#include "workerpool.h"
+
+// Every x64 compiler provides SSE, x86 builds need /arch:SSE or -msse
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULLING_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	// Objects per slice handed to a worker, a multiple of the four SSE lanes
+	const size_t CULLING_GRAIN = 4096;
+}
+
+///////////////////////////////////////////////////
+//	ExtractFrustumPlanes(const mat4&, Frustum&)
+//
+//	Each plane is the sum or difference of the last
+//	row of the matrix with one of the other rows.
+//	glm is column major, so row r is m[0..3][r].
+///////////////////////////////////////////////////
+void ExtractFrustumPlanes(const glm::mat4& viewProjection, Frustum& frustum)
+{
+	const glm::mat4& m = viewProjection;
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; ++r)
+		rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+
+	frustum.planes[0] = rows[3] + rows[0];  // left
+	frustum.planes[1] = rows[3] - rows[0];  // right
+	frustum.planes[2] = rows[3] + rows[1];  // bottom
+	frustum.planes[3] = rows[3] - rows[1];  // top
+	frustum.planes[4] = rows[3] + rows[2];  // near
+	frustum.planes[5] = rows[3] - rows[2];  // far
+
+	// Unit normals make the plane distance comparable with the radius
+	for (int p = 0; p < 6; ++p)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		frustum.planes[p] = plane / glm::length(glm::vec3(plane.x, plane.y, plane.z));
+	}
+}
+
+///////////////////////////////////////////////////
+//	ComputeWorldBounds(const std::vector<SceneObject>&, const SceneGraph&, ..., WorkerPool*)
+//
+//	World AABB of each object from the local AABB of
+//	its mesh. Each output axis takes, per matrix
+//	column, the smaller and larger of the column
+//	times the local min and max (Arvo's method), so
+//	the box is exact for the transformed corners.
+///////////////////////////////////////////////////
+void ComputeWorldBounds(const std::vector<SceneObject>& scene, const SceneGraph& graph, std::vector<glm::vec3>& boundsMin, std::vector<glm::vec3>& boundsMax,
+	WorkerPool* pool)
+{
+	boundsMin.resize(scene.size());
+	boundsMax.resize(scene.size());
+	auto compute = [&](size_t first, size_t last, size_t)
+	{
+		for (size_t i = first; i < last; ++i)
+		{
+			const SceneObject& object = scene[i];
+			const glm::mat4& world = graph.GetWorldMatrix(object.node);
+
+			glm::vec3 worldMin(world[3]);
+			glm::vec3 worldMax(world[3]);
+			for (int column = 0; column < 3; ++column)
+			{
+				const glm::vec3 axis(world[column]);
+				const glm::vec3 a = axis * object.mesh->boundsMin[column];
+				const glm::vec3 b = axis * object.mesh->boundsMax[column];
+				worldMin += glm::min(a, b);
+				worldMax += glm::max(a, b);
+			}
+			boundsMin[i] = worldMin;
+			boundsMax[i] = worldMax;
+		}
+	};
+
+	if (pool)
+		pool->ParallelFor(scene.size(), CULLING_GRAIN, compute);
+	else
+		compute(0, scene.size(), 0);
+}
+
+FrustumCuller::FrustumCuller()
+	: mCount(0)
+{
+}
+
+///////////////////////////////////////////////////
+//	UpdateSpheres(const std::vector<SceneObject>&, const SceneGraph&, WorkerPool*)
+//
+//	Only needed when objects moved. The radius is
+//	scaled by the largest axis scale of the world
+//	matrix, so non-uniform scales stay conservative.
+///////////////////////////////////////////////////
+void FrustumCuller::UpdateSpheres(const std::vector<SceneObject>& scene, const SceneGraph& graph, WorkerPool* pool)
+{
+	std::vector<glm::vec4> spheres(scene.size());
+	auto update = [&](size_t first, size_t last, size_t)
+	{
+		for (size_t i = first; i < last; ++i)
+		{
+			const SceneObject& object = scene[i];
+			const glm::mat4& world = graph.GetWorldMatrix(object.node);
+
+			const glm::vec4 center = world * glm::vec4(object.mesh->sphereCenter, 1.0f);
+			const float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+			spheres[i] = glm::vec4(center.x, center.y, center.z, object.mesh->sphereRadius * scale);
+		}
+	};
+
+	if (pool)
+		pool->ParallelFor(scene.size(), CULLING_GRAIN, update);
+	else
+		update(0, scene.size(), 0);
+	SetSpheres(spheres);
+}
+
+///////////////////////////////////////////////////
+//	SetSpheres(const std::vector<vec4>&)
+//
+//	Scatter (center, radius) entries into the
+//	padded structure-of-arrays layout
+///////////////////////////////////////////////////
+void FrustumCuller::SetSpheres(const std::vector<glm::vec4>& spheres)
+{
+	mCount = spheres.size();
+	const size_t padded = (mCount + 3) & ~(size_t)3;
+	mCenterX.assign(padded, 0.0f);
+	mCenterY.assign(padded, 0.0f);
+	mCenterZ.assign(padded, 0.0f);
+	mRadius.assign(padded, 0.0f);
+
+	for (size_t i = 0; i < mCount; ++i)
+	{
+		mCenterX[i] = spheres[i].x;
+		mCenterY[i] = spheres[i].y;
+		mCenterZ[i] = spheres[i].z;
+		mRadius[i] = spheres[i].w;
+	}
+}
+
+///////////////////////////////////////////////////
+//	Cull(const Frustum&, std::vector<unsigned char>&, WorkerPool*)
+//
+//	Slices of CULLING_GRAIN objects are tested in
+//	parallel when a pool is given
+///////////////////////////////////////////////////
+size_t FrustumCuller::Cull(const Frustum& frustum, std::vector<unsigned char>& visible, WorkerPool* pool) const
+{
+	visible.resize(mCount);
+	if (pool == nullptr)
+		return CullRange(frustum, visible, 0, mCount);
+
+	std::atomic<size_t> visibleCount(0);
+	pool->ParallelFor(mCount, CULLING_GRAIN, [&](size_t first, size_t last, size_t)
+	{
+		visibleCount += CullRange(frustum, visible, first, last);
+	});
+	return visibleCount;
+}
+
+///////////////////////////////////////////////////
+//	CullRange(const Frustum&, std::vector<unsigned char>&, size_t, size_t)
+//
+//	A sphere is outside when its center is farther
+//	than its radius behind any plane. The SSE path
+//	tests four spheres against a plane per step and
+//	only branches once per group of four, so first
+//	must be a multiple of four.
+///////////////////////////////////////////////////
+size_t FrustumCuller::CullRange(const Frustum& frustum, std::vector<unsigned char>& visible, size_t first, size_t last) const
+{
+	size_t visibleCount = 0;
+
+#ifdef CULLING_SSE
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (size_t i = first; i < last; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&mCenterX[i]);
+		const __m128 y = _mm_loadu_ps(&mCenterY[i]);
+		const __m128 z = _mm_loadu_ps(&mCenterZ[i]);
+		const __m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(&mRadius[i]));
+
+		__m128 outside = zero;
+		for (int p = 0; p < 6; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], x), planeW[p]);
+			distance = _mm_add_ps(distance, _mm_mul_ps(planeY[p], y));
+			distance = _mm_add_ps(distance, _mm_mul_ps(planeZ[p], z));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negRadius));
+		}
+
+		const int outsideMask = _mm_movemask_ps(outside);
+		const size_t lanes = (last - i < 4) ? last - i : 4;
+		for (size_t lane = 0; lane < lanes; ++lane)
+		{
+			const unsigned char inside = ((outsideMask >> lane) & 1) ? 0 : 1;
+			visible[i + lane] = inside;
+			visibleCount += inside;
+		}
+	}
+#else
+	for (size_t i = first; i < last; ++i)
+	{
+		unsigned char inside = 1;
+		for (int p = 0; p < 6 && inside; ++p)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			const float distance = plane.x * mCenterX[i] + plane.y * mCenterY[i] + plane.z * mCenterZ[i] + plane.w;
+			if (distance < -mRadius[i])
+				inside = 0;
+		}
+		visible[i] = inside;
+		visibleCount += inside;
+	}
+#endif
+
+	return visibleCount;
+}
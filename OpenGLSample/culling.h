@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// culling.h
+// ========
+// view-frustum culling of the scene objects
+//
+//	Every object is tested through the bounding sphere of its mesh moved to
+//	world space. The spheres are kept in structure-of-arrays form so the
+//	test runs on four objects at a time with SSE. Given a worker pool, the
+//	per-object passes run on slices of the scene in parallel.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+#include "scenegraph.h"
+
+class WorkerPool;
+
+// Six planes (left, right, bottom, top, near, far), xyz normal pointing inside
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+// Planes of the clip volume of a view-projection matrix, normalized
+void ExtractFrustumPlanes(const glm::mat4& viewProjection, Frustum& frustum);
+
+// World-space axis-aligned box of every object, from the AABB of its mesh
+void ComputeWorldBounds(const std::vector<SceneObject>& scene, const SceneGraph& graph, std::vector<glm::vec3>& boundsMin, std::vector<glm::vec3>& boundsMax,
+	WorkerPool* pool = nullptr);
+
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	// Move the mesh spheres of the objects to world space
+	void UpdateSpheres(const std::vector<SceneObject>& scene, const SceneGraph& graph, WorkerPool* pool = nullptr);
+
+	// Use the given world spheres, xyz center and w radius
+	void SetSpheres(const std::vector<glm::vec4>& spheres);
+
+	// Set visible[i] to 1 for objects touching the frustum and 0 otherwise, returns the visible count
+	size_t Cull(const Frustum& frustum, std::vector<unsigned char>& visible, WorkerPool* pool = nullptr) const;
+
+	size_t GetCount() const { return mCount; }
+
+private:
+	size_t CullRange(const Frustum& frustum, std::vector<unsigned char>& visible, size_t first, size_t last) const;
+
+	// Padded to a multiple of four entries
+	std::vector<float> mCenterX;
+	std::vector<float> mCenterY;
+	std::vector<float> mCenterZ;
+	std::vector<float> mRadius;
+	size_t mCount;
+};
@@ -0,0 +1,279 @@
+///////////////////////////////////////////////////////////////////////////////
+// frametiming.cpp
+// ========
+// frame-time statistics, a frame rate limiter and a fixed simulation step
+///////////////////////////////////////////////////////////////////////////////
+
+#include "frametiming.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+namespace
+{
+	// Nearest-rank percentile of sorted values
+	double Percentile(const std::vector<double>& sorted, double percent)
+	{
+		size_t rank = (size_t)(percent / 100.0 * sorted.size() + 0.5);
+		rank = std::min(std::max(rank, (size_t)1), sorted.size());
+		return sorted[rank - 1];
+	}
+}
+
+FrameTimer::FrameTimer()
+	: mStarted(false)
+	, mElapsed(0.0)
+{
+}
+
+///////////////////////////////////////////////////
+//	Reset()
+//
+//	Drop the recorded frames and stop the clock
+///////////////////////////////////////////////////
+void FrameTimer::Reset()
+{
+	mFrameTimes.clear();
+	mStarted = false;
+	mElapsed = 0.0;
+}
+
+///////////////////////////////////////////////////
+//	Tick()
+//
+//	Record the time since the previous call
+///////////////////////////////////////////////////
+void FrameTimer::Tick()
+{
+	const Clock::time_point now = Clock::now();
+	if (mStarted)
+	{
+		const double milliseconds = std::chrono::duration<double, std::milli>(now - mLast).count();
+		mFrameTimes.push_back(milliseconds);
+		mElapsed += milliseconds / 1000.0;
+	}
+	mLast = now;
+	mStarted = true;
+}
+
+///////////////////////////////////////////////////
+//	GetSummary(FrameSummary&)
+//
+//	FPS is frames over elapsed time, not the inverse
+//	of the mean, so both stay consistent when the
+//	frame times are uneven
+///////////////////////////////////////////////////
+bool FrameTimer::GetSummary(FrameSummary& summary) const
+{
+	if (mFrameTimes.empty())
+		return false;
+
+	std::vector<double> sorted(mFrameTimes);
+	std::sort(sorted.begin(), sorted.end());
+
+	double total = 0.0;
+	for (double time : sorted)
+		total += time;
+
+	summary.frames = sorted.size();
+	summary.seconds = mElapsed;
+	summary.fps = sorted.size() / mElapsed;
+	summary.min = sorted.front();
+	summary.mean = total / sorted.size();
+	summary.p50 = Percentile(sorted, 50.0);
+	summary.p95 = Percentile(sorted, 95.0);
+	summary.p99 = Percentile(sorted, 99.0);
+	summary.max = sorted.back();
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	PrintSummary(ostream&, const char*)
+//
+//	Two lines, see GetSummary
+///////////////////////////////////////////////////
+void FrameTimer::PrintSummary(std::ostream& out, const char* label) const
+{
+	FrameSummary summary;
+	if (!GetSummary(summary))
+	{
+		out << "INFO: " << label << ": no frames recorded" << std::endl;
+		return;
+	}
+
+	const std::ios::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+	out << "INFO: " << label << ": " << summary.frames << " frames in " << summary.seconds << " s, "
+		<< summary.fps << " FPS" << std::endl;
+	out << "INFO:   frame ms  min " << summary.min << "  mean " << summary.mean
+		<< "  p50 " << summary.p50 << "  p95 " << summary.p95
+		<< "  p99 " << summary.p99 << "  max " << summary.max << std::endl;
+	out.flags(flags);
+	out.precision(precision);
+}
+
+FrameLimiter::FrameLimiter()
+	: mTargetFps(0.0)
+	, mPeriod(0)
+	, mStarted(false)
+	, mTimer(nullptr)
+{
+#ifdef _WIN32
+	// High resolution timers wake within a fraction of a millisecond (Windows 10 1803+)
+	mTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+}
+
+FrameLimiter::~FrameLimiter()
+{
+#ifdef _WIN32
+	if (mTimer)
+		CloseHandle(mTimer);
+#endif
+}
+
+///////////////////////////////////////////////////
+//	SetTargetFps(double)
+//
+//	The deadlines restart from the next Wait
+///////////////////////////////////////////////////
+void FrameLimiter::SetTargetFps(double fps)
+{
+	mTargetFps = std::max(fps, 0.0);
+	mPeriod = (mTargetFps > 0.0)
+		? std::chrono::duration_cast<FrameTimer::Clock::duration>(std::chrono::duration<double>(1.0 / mTargetFps))
+		: FrameTimer::Clock::duration(0);
+	mStarted = false;
+}
+
+///////////////////////////////////////////////////
+//	Wait()
+//
+//	Deadlines are spaced by the period from the
+//	previous deadline, not from the wake-up, so an
+//	early or late wake does not drift the rate. A
+//	frame more than a period late restarts them.
+///////////////////////////////////////////////////
+void FrameLimiter::Wait()
+{
+	if (mTargetFps <= 0.0)
+		return;
+
+	const FrameTimer::Clock::time_point now = FrameTimer::Clock::now();
+	if (!mStarted || now > mDeadline + mPeriod)
+	{
+		mDeadline = now + mPeriod;
+		mStarted = true;
+		return;
+	}
+
+	SleepUntil(mDeadline);
+	mDeadline += mPeriod;
+}
+
+///////////////////////////////////////////////////
+//	SleepUntil(time_point)
+//
+//	Block the thread until the deadline. Without a
+//	high resolution timer, Windows sleeps in steps
+//	of the scheduler tick, so the standard sleep is
+//	only used where the timer could not be created.
+///////////////////////////////////////////////////
+void FrameLimiter::SleepUntil(FrameTimer::Clock::time_point deadline)
+{
+	const FrameTimer::Clock::duration remaining = deadline - FrameTimer::Clock::now();
+	if (remaining <= FrameTimer::Clock::duration(0))
+		return;
+
+#ifdef _WIN32
+	if (mTimer)
+	{
+		// Relative due time, negative, in 100 nanosecond units
+		LARGE_INTEGER dueTime;
+		dueTime.QuadPart = -(LONGLONG)(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count() / 100);
+		if (SetWaitableTimerEx(mTimer, &dueTime, 0, nullptr, nullptr, nullptr, 0))
+		{
+			WaitForSingleObject(mTimer, INFINITE);
+			return;
+		}
+	}
+#endif
+	std::this_thread::sleep_until(deadline);
+}
+
+FixedTimestep::FixedTimestep()
+	: mStepSeconds(1.0 / 60.0)
+	, mAccumulator(0.0)
+	, mLast(0.0)
+	, mStarted(false)
+	, mStepCount(0)
+	, mDroppedSteps(0)
+{
+}
+
+///////////////////////////////////////////////////
+//	SetRate(double)
+///////////////////////////////////////////////////
+void FixedTimestep::SetRate(double stepsPerSecond)
+{
+	mStepSeconds = 1.0 / std::max(stepsPerSecond, 1.0);
+	mAccumulator = 0.0;
+	mStarted = false;
+	mStepCount = 0;
+	mDroppedSteps = 0;
+}
+
+///////////////////////////////////////////////////
+//	Advance(double)
+//
+//	The first call only starts the clock. Elapsed
+//	time is taken as the difference of two doubles,
+//	which keeps sub-microsecond precision over
+//	decades of uptime where a float clock loses
+//	milliseconds within a day.
+///////////////////////////////////////////////////
+void FixedTimestep::Advance(double now)
+{
+	if (!mStarted)
+	{
+		mLast = now;
+		mStarted = true;
+		return;
+	}
+
+	mAccumulator += std::max(now - mLast, 0.0);
+	mLast = now;
+
+	const double maxAccumulated = MAX_STEPS_PER_ADVANCE * mStepSeconds;
+	if (mAccumulator >= maxAccumulated + mStepSeconds)
+	{
+		const double dropped = std::floor((mAccumulator - maxAccumulated) / mStepSeconds);
+		mDroppedSteps += (uint64_t)dropped;
+		mAccumulator -= dropped * mStepSeconds;
+	}
+}
+
+///////////////////////////////////////////////////
+//	Step()
+///////////////////////////////////////////////////
+bool FixedTimestep::Step()
+{
+	if (mAccumulator < mStepSeconds)
+		return false;
+
+	mAccumulator -= mStepSeconds;
+	++mStepCount;
+	return true;
+}
@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+// frametiming.h
+// ========
+// frame-time statistics, a frame rate limiter and a fixed simulation step
+//
+//	FrameTimer records the duration of every frame of a run and summarizes
+//	them as min, mean, percentiles and max, the numbers compared between
+//	builds and machines. FrameLimiter holds the interactive loop at a fixed
+//	rate by sleeping until each frame's deadline instead of spinning on the
+//	clock, with a high resolution waitable timer on Windows.
+//
+//	FixedTimestep decouples the simulation from the frame rate. Real time
+//	is accumulated in double precision and spent in steps of one fixed
+//	length, so the simulated states only depend on the input seen at each
+//	step, not on how long frames took. The renderer draws between the last
+//	two states, GetAlpha of the way to the newer one.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Statistics of the recorded frames, times in milliseconds
+struct FrameSummary
+{
+	size_t frames;
+	double seconds;
+	double fps;
+	double min;
+	double mean;
+	double p50;
+	double p95;
+	double p99;
+	double max;
+};
+
+class FrameTimer
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	FrameTimer();
+
+	// Forget the recorded frames, the next Tick starts the clock again
+	void Reset();
+
+	// Call once per frame, after the swap. The first call only starts the clock.
+	void Tick();
+
+	size_t GetFrameCount() const { return mFrameTimes.size(); }
+	double GetElapsedSeconds() const { return mElapsed; }
+
+	// Fill the statistics, false when no frame has been recorded
+	bool GetSummary(FrameSummary& summary) const;
+
+	// Print frame count, FPS and min/mean/p50/p95/p99/max frame times in milliseconds
+	void PrintSummary(std::ostream& out, const char* label) const;
+
+private:
+	std::vector<double> mFrameTimes;    // Milliseconds
+	Clock::time_point mLast;
+	bool mStarted;
+	double mElapsed;                    // Seconds covered by the recorded frames
+};
+
+class FrameLimiter
+{
+public:
+	FrameLimiter();
+	~FrameLimiter();
+
+	// Frames per second to hold, 0 turns the limiter off
+	void SetTargetFps(double fps);
+	double GetTargetFps() const { return mTargetFps; }
+
+	// Sleep until the deadline of the current frame, then start the next one
+	void Wait();
+
+private:
+	void SleepUntil(FrameTimer::Clock::time_point deadline);
+
+	double mTargetFps;
+	FrameTimer::Clock::duration mPeriod;
+	FrameTimer::Clock::time_point mDeadline;
+	bool mStarted;
+	void* mTimer;       // Waitable timer handle on Windows, null elsewhere
+};
+
+class FixedTimestep
+{
+public:
+	FixedTimestep();
+
+	// Steps per simulated second, restarts the clock
+	void SetRate(double stepsPerSecond);
+	double GetStepSeconds() const { return mStepSeconds; }
+
+	// Add the time elapsed since the last call. now is in seconds of any monotonic clock.
+	void Advance(double now);
+
+	// True while a step is due, consuming it
+	bool Step();
+
+	// Share of a step accumulated since the last step, in [0, 1)
+	float GetAlpha() const { return (float)(mAccumulator / mStepSeconds); }
+
+	// Steps run since SetRate, and the simulated time they cover
+	uint64_t GetStepCount() const { return mStepCount; }
+	double GetSimulatedSeconds() const { return (double)mStepCount * mStepSeconds; }
+
+	// Steps dropped because frames took longer than MAX_STEPS_PER_ADVANCE steps
+	uint64_t GetDroppedSteps() const { return mDroppedSteps; }
+
+private:
+	// A long stall is skipped past instead of caught up, which would stall again
+	static const int MAX_STEPS_PER_ADVANCE = 8;
+
+	double mStepSeconds;
+	double mAccumulator;        // Real time not yet simulated
+	double mLast;
+	bool mStarted;
+	uint64_t mStepCount;
+	uint64_t mDroppedSteps;
+};
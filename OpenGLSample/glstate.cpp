@@ -0,0 +1,349 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstate.cpp
+// ========
+// shadow copy of the GL binding and pipeline state
+///////////////////////////////////////////////////////////////////////////////
+
+#include "glstate.h"
+
+namespace
+{
+	// Cached value of state the context may hold anything in. GL names and
+	// enums never take this value.
+	const GLuint UNKNOWN = 0xFFFFFFFF;
+
+	const char* const CALL_NAMES[GL_STATE_CALL_KINDS] =
+	{
+		"program", "vao", "active texture", "texture", "buffer", "enable", "fixed function"
+	};
+
+	void Fill(GLuint* values, int count)
+	{
+		for (int i = 0; i < count; ++i)
+			values[i] = UNKNOWN;
+	}
+}
+
+///////////////////////////////////////////////////
+//	GetIssued() / GetElided()
+//
+//	Totals over every kind of call
+///////////////////////////////////////////////////
+unsigned int GLStateCounters::GetIssued() const
+{
+	unsigned int total = 0;
+	for (int kind = 0; kind < GL_STATE_CALL_KINDS; ++kind)
+		total += issued[kind];
+	return total;
+}
+
+unsigned int GLStateCounters::GetElided() const
+{
+	unsigned int total = 0;
+	for (int kind = 0; kind < GL_STATE_CALL_KINDS; ++kind)
+		total += elided[kind];
+	return total;
+}
+
+GLStateCache::GLStateCache()
+{
+	Invalidate();
+	BeginFrame();
+}
+
+///////////////////////////////////////////////////
+//	Invalidate()
+///////////////////////////////////////////////////
+void GLStateCache::Invalidate()
+{
+	mProgram = UNKNOWN;
+	mVertexArray = UNKNOWN;
+	mActiveTexture = UNKNOWN;
+	Fill(&mTextures[0][0], TEXTURE_UNITS * TEXTURE_TARGETS);
+	Fill(mBuffers, BUFFER_TARGETS);
+	Fill(mUniformBindings, BUFFER_BINDINGS);
+	Fill(mStorageBindings, BUFFER_BINDINGS);
+	Fill(mCapabilities, CAPABILITIES);
+	mDepthFunc = UNKNOWN;
+	mDepthMask = UNKNOWN;
+	mColorMask = UNKNOWN;
+	mBlendSource = UNKNOWN;
+	mBlendDestination = UNKNOWN;
+	mCullFace = UNKNOWN;
+	mClearColorKnown = false;
+}
+
+///////////////////////////////////////////////////
+//	BeginFrame()
+///////////////////////////////////////////////////
+void GLStateCache::BeginFrame()
+{
+	for (int kind = 0; kind < GL_STATE_CALL_KINDS; ++kind)
+	{
+		mCounters.issued[kind] = 0;
+		mCounters.elided[kind] = 0;
+	}
+}
+
+///////////////////////////////////////////////////
+//	PrintCounters(ostream&)
+///////////////////////////////////////////////////
+void GLStateCache::PrintCounters(std::ostream& out) const
+{
+	out << mCounters.GetIssued() << " GL state calls issued, " << mCounters.GetElided() << " elided (";
+	for (int kind = 0; kind < GL_STATE_CALL_KINDS; ++kind)
+	{
+		out << (kind > 0 ? ", " : "") << CALL_NAMES[kind] << " "
+			<< mCounters.issued[kind] << "/" << mCounters.elided[kind];
+	}
+	out << ")";
+}
+
+///////////////////////////////////////////////////
+//	Change(GLuint&, GLuint, GLStateCall)
+///////////////////////////////////////////////////
+bool GLStateCache::Change(GLuint& cached, GLuint value, GLStateCall kind)
+{
+	if (cached == value)
+	{
+		++mCounters.elided[kind];
+		return false;
+	}
+	cached = value;
+	++mCounters.issued[kind];
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	UseProgram(GLuint)
+///////////////////////////////////////////////////
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (Change(mProgram, program, GL_STATE_PROGRAM))
+		glUseProgram(program);
+}
+
+///////////////////////////////////////////////////
+//	BindVertexArray(GLuint)
+///////////////////////////////////////////////////
+void GLStateCache::BindVertexArray(GLuint vao)
+{
+	if (Change(mVertexArray, vao, GL_STATE_VERTEX_ARRAY))
+		glBindVertexArray(vao);
+}
+
+///////////////////////////////////////////////////
+//	BindTexture(GLuint, GLenum, GLuint)
+//
+//	Units past TEXTURE_UNITS and other targets are
+//	bound without looking at the cache
+///////////////////////////////////////////////////
+void GLStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (Change(mActiveTexture, unit, GL_STATE_ACTIVE_TEXTURE))
+		glActiveTexture(GL_TEXTURE0 + unit);
+
+	const int index = TextureTargetIndex(target);
+	if (unit >= (GLuint)TEXTURE_UNITS || index < 0)
+	{
+		Issue(GL_STATE_TEXTURE);
+		glBindTexture(target, texture);
+		return;
+	}
+	if (Change(mTextures[unit][index], texture, GL_STATE_TEXTURE))
+		glBindTexture(target, texture);
+}
+
+///////////////////////////////////////////////////
+//	BindBuffer(GLenum, GLuint)
+///////////////////////////////////////////////////
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	const int index = BufferTargetIndex(target);
+	if (index < 0)
+	{
+		Issue(GL_STATE_BUFFER);
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (Change(mBuffers[index], buffer, GL_STATE_BUFFER))
+		glBindBuffer(target, buffer);
+}
+
+///////////////////////////////////////////////////
+//	BindBufferBase(GLenum, GLuint, GLuint)
+//
+//	An elided call leaves the generic binding as it
+//	was, exactly like GL would had it never been made
+///////////////////////////////////////////////////
+void GLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	GLuint* bindings = target == GL_UNIFORM_BUFFER ? mUniformBindings
+		: target == GL_SHADER_STORAGE_BUFFER ? mStorageBindings : nullptr;
+	if (bindings == nullptr || index >= (GLuint)BUFFER_BINDINGS)
+	{
+		Issue(GL_STATE_BUFFER);
+		glBindBufferBase(target, index, buffer);
+		const int generic = BufferTargetIndex(target);
+		if (generic >= 0)
+			mBuffers[generic] = buffer;
+		return;
+	}
+	if (Change(bindings[index], buffer, GL_STATE_BUFFER))
+	{
+		glBindBufferBase(target, index, buffer);
+		mBuffers[BufferTargetIndex(target)] = buffer;
+	}
+}
+
+///////////////////////////////////////////////////
+//	BindBufferRange(GLenum, GLuint, GLuint, GLintptr, GLsizeiptr)
+//
+//	Only the buffer name is cached per binding, so
+//	after a range the next BindBufferBase of the
+//	index is issued whatever buffer it names
+///////////////////////////////////////////////////
+void GLStateCache::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	Issue(GL_STATE_BUFFER);
+	glBindBufferRange(target, index, buffer, offset, size);
+
+	const int generic = BufferTargetIndex(target);
+	if (generic >= 0)
+		mBuffers[generic] = buffer;
+	if (target == GL_UNIFORM_BUFFER && index < (GLuint)BUFFER_BINDINGS)
+		mUniformBindings[index] = UNKNOWN;
+	else if (target == GL_SHADER_STORAGE_BUFFER && index < (GLuint)BUFFER_BINDINGS)
+		mStorageBindings[index] = UNKNOWN;
+}
+
+///////////////////////////////////////////////////
+//	SetCapability(GLenum, bool)
+///////////////////////////////////////////////////
+void GLStateCache::SetCapability(GLenum capability, bool enabled)
+{
+	const int index = CapabilityIndex(capability);
+	if (index >= 0 && !Change(mCapabilities[index], enabled ? 1 : 0, GL_STATE_CAPABILITY))
+		return;
+	if (index < 0)
+		Issue(GL_STATE_CAPABILITY);
+
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+///////////////////////////////////////////////////
+//	DepthFunc(GLenum) / DepthMask(GLboolean)
+//	ColorMask(GLboolean)
+///////////////////////////////////////////////////
+void GLStateCache::DepthFunc(GLenum func)
+{
+	if (Change(mDepthFunc, func, GL_STATE_FIXED_FUNCTION))
+		glDepthFunc(func);
+}
+
+void GLStateCache::DepthMask(GLboolean mask)
+{
+	if (Change(mDepthMask, mask ? 1 : 0, GL_STATE_FIXED_FUNCTION))
+		glDepthMask(mask);
+}
+
+void GLStateCache::ColorMask(GLboolean mask)
+{
+	if (Change(mColorMask, mask ? 1 : 0, GL_STATE_FIXED_FUNCTION))
+		glColorMask(mask, mask, mask, mask);
+}
+
+///////////////////////////////////////////////////
+//	BlendFunc(GLenum, GLenum)
+///////////////////////////////////////////////////
+void GLStateCache::BlendFunc(GLenum source, GLenum destination)
+{
+	if (mBlendSource == source && mBlendDestination == destination)
+	{
+		++mCounters.elided[GL_STATE_FIXED_FUNCTION];
+		return;
+	}
+	mBlendSource = source;
+	mBlendDestination = destination;
+	Issue(GL_STATE_FIXED_FUNCTION);
+	glBlendFunc(source, destination);
+}
+
+///////////////////////////////////////////////////
+//	CullFace(GLenum)
+///////////////////////////////////////////////////
+void GLStateCache::CullFace(GLenum mode)
+{
+	if (Change(mCullFace, mode, GL_STATE_FIXED_FUNCTION))
+		glCullFace(mode);
+}
+
+///////////////////////////////////////////////////
+//	ClearColor(const vec4&)
+///////////////////////////////////////////////////
+void GLStateCache::ClearColor(const glm::vec4& color)
+{
+	if (mClearColorKnown && mClearColor == color)
+	{
+		++mCounters.elided[GL_STATE_FIXED_FUNCTION];
+		return;
+	}
+	mClearColor = color;
+	mClearColorKnown = true;
+	Issue(GL_STATE_FIXED_FUNCTION);
+	glClearColor(color.x, color.y, color.z, color.w);
+}
+
+///////////////////////////////////////////////////
+//	TextureTargetIndex(GLenum)
+//	BufferTargetIndex(GLenum)
+//	CapabilityIndex(GLenum)
+//
+//	Slot of a tracked target, -1 when untracked
+///////////////////////////////////////////////////
+int GLStateCache::TextureTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return TEXTURE_2D;
+	case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY;
+	default: return -1;
+	}
+}
+
+int GLStateCache::BufferTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return ARRAY;
+	case GL_UNIFORM_BUFFER: return UNIFORM;
+	case GL_SHADER_STORAGE_BUFFER: return SHADER_STORAGE;
+	case GL_DRAW_INDIRECT_BUFFER: return DRAW_INDIRECT;
+	case GL_COPY_READ_BUFFER: return COPY_READ;
+	case GL_COPY_WRITE_BUFFER: return COPY_WRITE;
+	default: return -1;
+	}
+}
+
+int GLStateCache::CapabilityIndex(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST: return DEPTH_TEST;
+	case GL_BLEND: return BLEND;
+	case GL_CULL_FACE: return CULL_FACE;
+	default: return -1;
+	}
+}
+
+///////////////////////////////////////////////////
+//	GLState()
+///////////////////////////////////////////////////
+GLStateCache& GLState()
+{
+	static GLStateCache cache;
+	return cache;
+}
@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstate.h
+// ========
+// shadow copy of the GL binding and pipeline state
+//
+//	Every bind and state change of the render loop goes through GLState().
+//	The cache remembers what the context holds and drops calls that would
+//	set the same value again, so the driver only validates real changes.
+//	Each kind of call is counted per frame, issued and elided, to show what
+//	the cache saves.
+//
+//	The copy is only correct while nothing else changes the same state.
+//	Code that calls GL directly, like the setup done before the render loop,
+//	must be followed by Invalidate(). Deleted names can be handed out again
+//	by GL, so objects are only deleted at shutdown or followed by the same.
+//
+//	Bindings of GL_ELEMENT_ARRAY_BUFFER belong to the bound VAO and are
+//	passed through without caching, as are targets and capabilities the
+//	cache does not track.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+// Kinds of calls counted by the cache
+enum GLStateCall
+{
+	GL_STATE_PROGRAM,           // glUseProgram
+	GL_STATE_VERTEX_ARRAY,      // glBindVertexArray
+	GL_STATE_ACTIVE_TEXTURE,    // glActiveTexture
+	GL_STATE_TEXTURE,           // glBindTexture
+	GL_STATE_BUFFER,            // glBindBuffer, glBindBufferBase, glBindBufferRange
+	GL_STATE_CAPABILITY,        // glEnable, glDisable
+	GL_STATE_FIXED_FUNCTION,    // glDepthFunc, glDepthMask, glColorMask, glBlendFunc, glCullFace, glClearColor
+	GL_STATE_CALL_KINDS
+};
+
+// Calls of one frame that reached the driver, and calls dropped as redundant
+struct GLStateCounters
+{
+	unsigned int issued[GL_STATE_CALL_KINDS];
+	unsigned int elided[GL_STATE_CALL_KINDS];
+
+	unsigned int GetIssued() const;
+	unsigned int GetElided() const;
+};
+
+class GLStateCache
+{
+public:
+	static const int TEXTURE_UNITS = 16;
+	static const int BUFFER_BINDINGS = 16;     // Indexed uniform and storage bindings tracked
+
+	GLStateCache();
+
+	// Forget the whole context state, the next call of every kind is issued
+	void Invalidate();
+
+	// Zero the counters at the start of a frame
+	void BeginFrame();
+	const GLStateCounters& GetCounters() const { return mCounters; }
+
+	// Print the counters of the frame by kind, as issued/elided
+	void PrintCounters(std::ostream& out) const;
+
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vao);
+
+	// Bind to a texture unit, which is left active so the texture can be updated right after
+	void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+	void BindBuffer(GLenum target, GLuint buffer);
+
+	// Indexed binding, which also replaces the generic binding of target
+	void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+	// Part of a buffer at an indexed binding. Ranges of the ring buffer move
+	// every frame, so they are always issued.
+	void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	// GL_DEPTH_TEST, GL_BLEND and GL_CULL_FACE are tracked
+	void SetCapability(GLenum capability, bool enabled);
+	void DepthFunc(GLenum func);
+	void DepthMask(GLboolean mask);
+
+	// The same mask for the four channels
+	void ColorMask(GLboolean mask);
+	void BlendFunc(GLenum source, GLenum destination);
+	void CullFace(GLenum mode);
+	void ClearColor(const glm::vec4& color);
+
+private:
+	enum TextureTarget { TEXTURE_2D, TEXTURE_2D_ARRAY, TEXTURE_TARGETS };
+	enum BufferTarget { ARRAY, UNIFORM, SHADER_STORAGE, DRAW_INDIRECT, COPY_READ, COPY_WRITE, BUFFER_TARGETS };
+	enum Capability { DEPTH_TEST, BLEND, CULL_FACE, CAPABILITIES };
+
+	// True when the value changes, counts the call either way
+	bool Change(GLuint& cached, GLuint value, GLStateCall kind);
+	void Issue(GLStateCall kind) { ++mCounters.issued[kind]; }
+
+	static int TextureTargetIndex(GLenum target);
+	static int BufferTargetIndex(GLenum target);
+	static int CapabilityIndex(GLenum capability);
+
+	GLuint mProgram;
+	GLuint mVertexArray;
+	GLuint mActiveTexture;
+	GLuint mTextures[TEXTURE_UNITS][TEXTURE_TARGETS];
+	GLuint mBuffers[BUFFER_TARGETS];
+	GLuint mUniformBindings[BUFFER_BINDINGS];
+	GLuint mStorageBindings[BUFFER_BINDINGS];
+	GLuint mCapabilities[CAPABILITIES];
+	GLuint mDepthFunc;
+	GLuint mDepthMask;
+	GLuint mColorMask;
+	GLuint mBlendSource;
+	GLuint mBlendDestination;
+	GLuint mCullFace;
+	glm::vec4 mClearColor;
+	bool mClearColorKnown;
+
+	GLStateCounters mCounters;
+};
+
+// The cache of the one GL context of the program
+GLStateCache& GLState();
@@ -0,0 +1,293 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuprofiler.cpp
+// ========
+// GPU and CPU timings of the named scopes of a frame
+///////////////////////////////////////////////////////////////////////////////
+
+#include "gpuprofiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+
+GpuProfiler::GpuProfiler()
+	: mEnabled(false), mCreated(false), mInFrame(false), mFrame(0),
+	mResolvedFrames(0), mDroppedFrames(0), mCsvFrames(0)
+{
+	for (int slot = 0; slot < FRAME_LATENCY; ++slot)
+		mFrameNumbers[slot] = 0;
+}
+
+///////////////////////////////////////////////////
+//	Create()
+//
+//	Queries are generated up front, a timestamp
+//	query needs no glBeginQuery and can be reused
+//	once its result has been read
+///////////////////////////////////////////////////
+void GpuProfiler::Create()
+{
+	mQueries.resize(FRAME_LATENCY * MAX_SCOPES * 2);
+	glGenQueries((GLsizei)mQueries.size(), mQueries.data());
+	mCreated = true;
+}
+
+///////////////////////////////////////////////////
+//	Destroy()
+//
+//	Delete the queries and close the CSV file
+///////////////////////////////////////////////////
+void GpuProfiler::Destroy()
+{
+	if (mCreated)
+		glDeleteQueries((GLsizei)mQueries.size(), mQueries.data());
+	mQueries.clear();
+	mCreated = false;
+
+	if (mCsv.is_open())
+		mCsv.close();
+}
+
+///////////////////////////////////////////////////
+//	OpenCsv(const char*)
+//
+//	Rows are: frame, scope, depth, GPU ms, CPU ms
+///////////////////////////////////////////////////
+bool GpuProfiler::OpenCsv(const char* path)
+{
+	mCsvPath = path;
+	mCsv.open(path, std::ios::out | std::ios::trunc);
+	if (!mCsv.is_open())
+	{
+		std::cout << "ERROR::PROFILER::CSV_OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+	WriteCsvHeader();
+	return true;
+}
+
+void GpuProfiler::WriteCsvHeader()
+{
+	mCsv << "frame,scope,depth,gpu_ms,cpu_ms\n";
+	mCsvFrames = 0;
+}
+
+///////////////////////////////////////////////////
+//	BeginFrame()
+//
+//	The slot about to be reused holds the frame
+//	issued FRAME_LATENCY frames ago
+///////////////////////////////////////////////////
+void GpuProfiler::BeginFrame()
+{
+	if (!mCreated || !mEnabled)
+		return;
+
+	const int slot = mFrame % FRAME_LATENCY;
+	if (!mScopes[slot].empty())
+		ResolveFrame(slot);
+
+	mScopes[slot].clear();
+	mFrameNumbers[slot] = mFrame;
+	mOpenScopes.clear();
+	mInFrame = true;
+
+	BeginScope("frame");
+}
+
+///////////////////////////////////////////////////
+//	EndFrame()
+//
+//	Close the scopes left open and move to the
+//	next slot of the ring
+///////////////////////////////////////////////////
+void GpuProfiler::EndFrame()
+{
+	if (!mInFrame)
+		return;
+
+	while (!mOpenScopes.empty())
+		EndScope();
+	mInFrame = false;
+	++mFrame;
+}
+
+///////////////////////////////////////////////////
+//	BeginScope(const char*)
+//
+//	Query 2i of the slot marks the start of scope i,
+//	query 2i + 1 its end
+///////////////////////////////////////////////////
+void GpuProfiler::BeginScope(const char* name)
+{
+	if (!mInFrame)
+		return;
+
+	const int slot = mFrame % FRAME_LATENCY;
+	std::vector<Scope>& scopes = mScopes[slot];
+	if (scopes.size() >= (size_t)MAX_SCOPES)
+	{
+		mOpenScopes.push_back(-1);
+		return;
+	}
+
+	const int index = (int)scopes.size();
+	Scope scope;
+	scope.name = name;
+	scope.depth = (int)mOpenScopes.size();
+	scope.cpuBegin = Clock::now();
+	scope.cpuEnd = scope.cpuBegin;
+	scopes.push_back(scope);
+	mOpenScopes.push_back(index);
+
+	glQueryCounter(mQueries[(slot * MAX_SCOPES + index) * 2], GL_TIMESTAMP);
+}
+
+///////////////////////////////////////////////////
+//	EndScope()
+//
+//	Close the most recently opened scope
+///////////////////////////////////////////////////
+void GpuProfiler::EndScope()
+{
+	if (!mInFrame || mOpenScopes.empty())
+		return;
+
+	const int index = mOpenScopes.back();
+	mOpenScopes.pop_back();
+	if (index < 0)
+		return;
+
+	const int slot = mFrame % FRAME_LATENCY;
+	glQueryCounter(mQueries[(slot * MAX_SCOPES + index) * 2 + 1], GL_TIMESTAMP);
+	mScopes[slot][index].cpuEnd = Clock::now();
+}
+
+///////////////////////////////////////////////////
+//	ResolveFrame(int)
+//
+//	The end query of the frame scope is the last one
+//	issued, once it is available all of them are.
+//	Scopes sharing a name are summed, so the objects
+//	of a batch type add up to one line.
+///////////////////////////////////////////////////
+void GpuProfiler::ResolveFrame(int slot)
+{
+	const std::vector<Scope>& scopes = mScopes[slot];
+	const GLuint* queries = &mQueries[slot * MAX_SCOPES * 2];
+
+	GLuint available = 0;
+	glGetQueryObjectuiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		++mDroppedFrames;
+		return;
+	}
+
+	mFrameGpu.assign(mTotals.size(), 0.0);
+	for (size_t i = 0; i < scopes.size(); ++i)
+	{
+		const Scope& scope = scopes[i];
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(queries[i * 2], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+		const double gpuMilliseconds = (end > begin) ? (end - begin) / 1.0e6 : 0.0;
+		const double cpuMilliseconds = std::chrono::duration<double, std::milli>(scope.cpuEnd - scope.cpuBegin).count();
+
+		ScopeTotals& totals = GetTotals(scope.name, scope.depth);
+		totals.calls++;
+		totals.gpuMilliseconds += gpuMilliseconds;
+		totals.cpuMilliseconds += cpuMilliseconds;
+
+		const size_t entry = &totals - mTotals.data();
+		mFrameGpu.resize(mTotals.size(), 0.0);
+		mFrameGpu[entry] += gpuMilliseconds;
+
+		if (mCsv.is_open())
+		{
+			mCsv << mFrameNumbers[slot] << "," << scope.name << "," << scope.depth << ","
+				<< gpuMilliseconds << "," << cpuMilliseconds << "\n";
+		}
+	}
+
+	for (size_t entry = 0; entry < mFrameGpu.size(); ++entry)
+		mTotals[entry].gpuMaxMilliseconds = std::max(mTotals[entry].gpuMaxMilliseconds, mFrameGpu[entry]);
+	++mResolvedFrames;
+
+	// Keep the file bounded, the previous part is kept next to it
+	if (mCsv.is_open() && ++mCsvFrames >= (unsigned int)CSV_ROLL_FRAMES)
+	{
+		const std::string oldPath = mCsvPath + ".old";
+		mCsv.close();
+		std::remove(oldPath.c_str());
+		std::rename(mCsvPath.c_str(), oldPath.c_str());
+		mCsv.open(mCsvPath.c_str(), std::ios::out | std::ios::trunc);
+		if (mCsv.is_open())
+			WriteCsvHeader();
+	}
+}
+
+///////////////////////////////////////////////////
+//	GetTotals(const char*, int)
+//
+//	Entries stay in the order scopes first appeared,
+//	which is the order of the frame
+///////////////////////////////////////////////////
+GpuProfiler::ScopeTotals& GpuProfiler::GetTotals(const char* name, int depth)
+{
+	for (ScopeTotals& totals : mTotals)
+	{
+		if (totals.depth == depth && totals.name == name)
+			return totals;
+	}
+
+	ScopeTotals totals = { name, depth, 0, 0.0, 0.0, 0.0 };
+	mTotals.push_back(totals);
+	return mTotals.back();
+}
+
+///////////////////////////////////////////////////
+//	PrintSummary(ostream&)
+//
+//	Times are per frame, calls per frame in the last
+//	column, share is of the frame's GPU time
+///////////////////////////////////////////////////
+void GpuProfiler::PrintSummary(std::ostream& out)
+{
+	if (mResolvedFrames == 0)
+	{
+		out << "INFO: Profiler: no frames resolved yet" << std::endl;
+		return;
+	}
+
+	double frameGpu = 0.0;
+	for (const ScopeTotals& totals : mTotals)
+	{
+		if (totals.depth == 0)
+			frameGpu += totals.gpuMilliseconds;
+	}
+
+	const std::ios::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << "INFO: Profiler: " << mResolvedFrames << " frames, " << mDroppedFrames << " dropped while pending" << std::endl;
+	out << "INFO:   " << std::left << std::setw(28) << "scope" << std::right << std::setw(10) << "gpu ms" << std::setw(10) << "gpu max"
+		<< std::setw(10) << "cpu ms" << std::setw(8) << "gpu %" << std::setw(8) << "calls" << std::endl;
+	out << std::fixed;
+	for (const ScopeTotals& totals : mTotals)
+	{
+		const std::string label = std::string(totals.depth * 2, ' ') + totals.name;
+		out << "INFO:   " << std::left << std::setw(28) << label.substr(0, 27) << std::right << std::setprecision(3)
+			<< std::setw(10) << totals.gpuMilliseconds / mResolvedFrames
+			<< std::setw(10) << totals.gpuMaxMilliseconds
+			<< std::setw(10) << totals.cpuMilliseconds / mResolvedFrames
+			<< std::setprecision(1) << std::setw(8) << (frameGpu > 0.0 ? 100.0 * totals.gpuMilliseconds / frameGpu : 0.0)
+			<< std::setw(8) << (double)totals.calls / mResolvedFrames << std::endl;
+	}
+	out.flags(flags);
+	out.precision(precision);
+
+	mTotals.clear();
+	mResolvedFrames = 0;
+	mDroppedFrames = 0;
+}
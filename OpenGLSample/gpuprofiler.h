@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuprofiler.h
+// ========
+// GPU and CPU timings of the named scopes of a frame
+//
+//	Every scope writes a GL_TIMESTAMP query when it opens and when it
+//	closes, so scopes can nest, and notes the CPU clock at the same
+//	points. The queries of a frame are only read when its slot of the ring
+//	comes around again, FRAME_LATENCY frames later, by which time the GPU
+//	has finished them and nothing waits. A frame whose queries are still
+//	pending is dropped rather than waited on.
+//
+//	Resolved frames are appended to an optional CSV file and summed per
+//	scope name until the next console summary.
+//
+//	The profiler starts disabled. Two queries per batch skew the frame
+//	times a benchmark measures, so it only runs when asked for.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+class GpuProfiler
+{
+public:
+	// Frames in flight before a frame's queries are read
+	static const int FRAME_LATENCY = 3;
+	// Scopes recorded per frame, later ones are ignored
+	static const int MAX_SCOPES = 256;
+	// Frames written to the CSV file before it is moved to <path>.old and restarted
+	static const int CSV_ROLL_FRAMES = 10000;
+
+	GpuProfiler();
+
+	// Generate the timestamp queries of the ring
+	void Create();
+	void Destroy();
+
+	void SetEnabled(bool enabled) { mEnabled = enabled; }
+	bool GetEnabled() const { return mEnabled; }
+
+	// Append one row per resolved scope to a CSV file
+	bool OpenCsv(const char* path);
+
+	// Read back the oldest frame of the ring and open the "frame" scope of a new one
+	void BeginFrame();
+	void EndFrame();
+
+	// name must stay valid until the frame is resolved, string literals and scene names do
+	void BeginScope(const char* name);
+	void EndScope();
+
+	// Per-frame averages of every scope since the last summary, then start over
+	void PrintSummary(std::ostream& out);
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Scope
+	{
+		const char* name;
+		int depth;
+		Clock::time_point cpuBegin;
+		Clock::time_point cpuEnd;
+	};
+
+	// Totals of one scope name since the last summary
+	struct ScopeTotals
+	{
+		std::string name;
+		int depth;
+		unsigned int calls;
+		double gpuMilliseconds;
+		double cpuMilliseconds;
+		double gpuMaxMilliseconds;     // Longest frame total
+	};
+
+	void ResolveFrame(int slot);
+	void WriteCsvHeader();
+	ScopeTotals& GetTotals(const char* name, int depth);
+
+	bool mEnabled;
+	bool mCreated;
+	bool mInFrame;
+
+	// Two queries per scope, for every slot of the ring
+	std::vector<GLuint> mQueries;
+	std::vector<Scope> mScopes[FRAME_LATENCY];
+	unsigned int mFrameNumbers[FRAME_LATENCY];
+	unsigned int mFrame;
+	std::vector<int> mOpenScopes;   // Indices into the current slot, -1 past MAX_SCOPES
+
+	std::vector<ScopeTotals> mTotals;
+	std::vector<double> mFrameGpu;  // Scratch, GPU time per totals entry for one frame
+	unsigned int mResolvedFrames;
+	unsigned int mDroppedFrames;
+
+	std::ofstream mCsv;
+	std::string mCsvPath;
+	unsigned int mCsvFrames;
+};
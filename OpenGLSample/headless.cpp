@@ -0,0 +1,340 @@
+///////////////////////////////////////////////////////////////////////////////
+// headless.cpp
+// ========
+// offscreen rendering for machines without a display
+///////////////////////////////////////////////////////////////////////////////
+
+#include "headless.h"
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#else
+#include <GLFW/glfw3.h>
+#endif
+
+namespace
+{
+#ifdef HEADLESS_EGL
+	EGLDisplay gDisplay = EGL_NO_DISPLAY;
+	EGLContext gContext = EGL_NO_CONTEXT;
+#else
+	GLFWwindow* gHiddenWindow = nullptr;
+#endif
+
+	// CRC-32 of the PNG chunks, polynomial 0xEDB88320
+	unsigned long UpdateCrc(unsigned long crc, const unsigned char* data, size_t length)
+	{
+		static unsigned long table[256];
+		static bool tableReady = false;
+		if (!tableReady)
+		{
+			for (unsigned long n = 0; n < 256; ++n)
+			{
+				unsigned long c = n;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+				table[n] = c;
+			}
+			tableReady = true;
+		}
+
+		for (size_t i = 0; i < length; ++i)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return crc;
+	}
+
+	void PutBigEndian(std::vector<unsigned char>& out, unsigned long value)
+	{
+		out.push_back((unsigned char)(value >> 24));
+		out.push_back((unsigned char)(value >> 16));
+		out.push_back((unsigned char)(value >> 8));
+		out.push_back((unsigned char)value);
+	}
+
+	// Length, type, data and CRC of the type and data
+	void WriteChunk(FILE* file, const char* type, const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> chunk;
+		PutBigEndian(chunk, (unsigned long)data.size());
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		const unsigned long crc = UpdateCrc(0xFFFFFFFFUL, chunk.data() + 4, chunk.size() - 4) ^ 0xFFFFFFFFUL;
+		PutBigEndian(chunk, crc);
+		fwrite(chunk.data(), 1, chunk.size(), file);
+	}
+
+	// zlib stream of stored (uncompressed) deflate blocks, the image is
+	// written once so the size matters less than needing no zlib
+	void StoreZlib(const std::vector<unsigned char>& raw, std::vector<unsigned char>& out)
+	{
+		const size_t MAX_BLOCK = 65535;
+
+		out.push_back(0x78);
+		out.push_back(0x01);
+
+		size_t offset = 0;
+		do
+		{
+			const size_t length = (raw.size() - offset < MAX_BLOCK) ? raw.size() - offset : MAX_BLOCK;
+			const bool last = offset + length == raw.size();
+			out.push_back(last ? 1 : 0);
+			out.push_back((unsigned char)(length & 0xFF));
+			out.push_back((unsigned char)(length >> 8));
+			out.push_back((unsigned char)(~length & 0xFF));
+			out.push_back((unsigned char)((~length >> 8) & 0xFF));
+			out.insert(out.end(), raw.begin() + offset, raw.begin() + offset + length);
+			offset += length;
+		} while (offset < raw.size());
+
+		// Adler-32 of the uncompressed data
+		unsigned long a = 1, b = 0;
+		for (size_t i = 0; i < raw.size(); ++i)
+		{
+			a = (a + raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		PutBigEndian(out, (b << 16) | a);
+	}
+}
+
+///////////////////////////////////////////////////
+//	CreateHeadlessContext()
+//
+//	EGL: the surfaceless platform is tried first,
+//	then the default display. The context is made
+//	current without a surface, which GL 4.4 allows
+//	when rendering goes to a framebuffer object.
+//	GLEW is initialized through glewContextInit, as
+//	glewInit would look for a GLX display.
+///////////////////////////////////////////////////
+bool CreateHeadlessContext()
+{
+#ifdef HEADLESS_EGL
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		gDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (gDisplay == EGL_NO_DISPLAY)
+		gDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (gDisplay == EGL_NO_DISPLAY || !eglInitialize(gDisplay, &major, &minor))
+	{
+		std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED" << std::endl;
+		return false;
+	}
+
+	const EGLint configAttributes[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(gDisplay, configAttributes, &config, 1, &configCount) || configCount == 0)
+	{
+		// Surfaceless displays may expose no config, contexts can then be created without one
+		config = (EGLConfig)0;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 4,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	if (!eglBindAPI(EGL_OPENGL_API)
+		|| (gContext = eglCreateContext(gDisplay, config, EGL_NO_CONTEXT, contextAttributes)) == EGL_NO_CONTEXT
+		|| !eglMakeCurrent(gDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, gContext))
+	{
+		std::cout << "ERROR::HEADLESS::EGL_CONTEXT_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+		DestroyHeadlessContext();
+		return false;
+	}
+
+	glewExperimental = GL_TRUE;
+	const GLenum glewResult = glewContextInit();
+#else
+	// A window that is never shown, the frames go to the offscreen target
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	gHiddenWindow = glfwCreateWindow(1, 1, "headless", NULL, NULL);
+	if (gHiddenWindow == NULL)
+	{
+		std::cout << "ERROR::HEADLESS::WINDOW_FAILED" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(gHiddenWindow);
+
+	glewExperimental = GL_TRUE;
+	const GLenum glewResult = glewInit();
+#endif
+
+	if (glewResult != GLEW_OK)
+	{
+		std::cerr << glewGetErrorString(glewResult) << std::endl;
+		DestroyHeadlessContext();
+		return false;
+	}
+
+	std::cout << "INFO: Headless OpenGL Version: " << glGetString(GL_VERSION) << ", " << glGetString(GL_RENDERER) << std::endl;
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	DestroyHeadlessContext()
+//
+//	Release the context and its display or window
+///////////////////////////////////////////////////
+void DestroyHeadlessContext()
+{
+#ifdef HEADLESS_EGL
+	if (gDisplay != EGL_NO_DISPLAY)
+	{
+		eglMakeCurrent(gDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (gContext != EGL_NO_CONTEXT)
+			eglDestroyContext(gDisplay, gContext);
+		eglTerminate(gDisplay);
+	}
+	gContext = EGL_NO_CONTEXT;
+	gDisplay = EGL_NO_DISPLAY;
+#else
+	if (gHiddenWindow)
+	{
+		glfwDestroyWindow(gHiddenWindow);
+		glfwTerminate();
+	}
+	gHiddenWindow = nullptr;
+#endif
+}
+
+OffscreenTarget::OffscreenTarget()
+	: mFramebuffer(0), mColorBuffer(0), mDepthBuffer(0), mWidth(0), mHeight(0)
+{
+}
+
+///////////////////////////////////////////////////
+//	Create(int, int)
+//
+//	Renderbuffers are enough, the color is only
+//	read back with glReadPixels and the depth is
+//	copied by the occlusion pass like the window's
+///////////////////////////////////////////////////
+bool OffscreenTarget::Create(int width, int height)
+{
+	mWidth = width;
+	mHeight = height;
+
+	glGenRenderbuffers(1, &mColorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, mColorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &mDepthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, mDepthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &mFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepthBuffer);
+
+	const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE 0x" << std::hex << status << std::dec << std::endl;
+		Destroy();
+		return false;
+	}
+
+	Bind();
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	Destroy()
+//
+//	Delete the framebuffer and its renderbuffers
+///////////////////////////////////////////////////
+void OffscreenTarget::Destroy()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &mFramebuffer);
+	glDeleteRenderbuffers(1, &mColorBuffer);
+	glDeleteRenderbuffers(1, &mDepthBuffer);
+	mFramebuffer = mColorBuffer = mDepthBuffer = 0;
+}
+
+///////////////////////////////////////////////////
+//	Bind()
+//
+//	Both the draw and the read framebuffer are set
+///////////////////////////////////////////////////
+void OffscreenTarget::Bind() const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+	glViewport(0, 0, mWidth, mHeight);
+}
+
+///////////////////////////////////////////////////
+//	SavePng(const char*)
+//
+//	GL rows start at the bottom, PNG rows at the
+//	top. Every row gets filter type 0 (none).
+///////////////////////////////////////////////////
+bool OffscreenTarget::SavePng(const char* path) const
+{
+	const size_t rowBytes = (size_t)mWidth * 4;
+	std::vector<unsigned char> pixels(rowBytes * mHeight);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	std::vector<unsigned char> raw;
+	raw.reserve((rowBytes + 1) * mHeight);
+	for (int y = mHeight - 1; y >= 0; --y)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), pixels.begin() + rowBytes * y, pixels.begin() + rowBytes * (y + 1));
+	}
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		std::cout << "ERROR::HEADLESS::PNG_OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	fwrite(signature, 1, sizeof(signature), file);
+
+	// Width, height, 8 bits, RGBA, default compression, filter and no interlace
+	std::vector<unsigned char> header;
+	PutBigEndian(header, (unsigned long)mWidth);
+	PutBigEndian(header, (unsigned long)mHeight);
+	header.push_back(8);
+	header.push_back(6);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	WriteChunk(file, "IHDR", header);
+
+	std::vector<unsigned char> data;
+	StoreZlib(raw, data);
+	WriteChunk(file, "IDAT", data);
+	WriteChunk(file, "IEND", std::vector<unsigned char>());
+
+	const bool written = ferror(file) == 0;
+	fclose(file);
+	if (!written)
+		std::cout << "ERROR::HEADLESS::PNG_WRITE_FAILED " << path << std::endl;
+	return written;
+}
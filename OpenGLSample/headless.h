@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////
+// headless.h
+// ========
+// offscreen rendering for machines without a display
+//
+//	Frames are drawn into a framebuffer object of any size instead of a
+//	window, and the last one can be saved as a PNG file. Built with
+//	HEADLESS_EGL defined (and linked with -lEGL), the GL 4.4 core context
+//	comes from EGL on Mesa's surfaceless platform, which needs neither a
+//	display server nor a GPU and runs on llvmpipe. Without it, the context
+//	belongs to a hidden GLFW window.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+// Create the offscreen GL context, make it current and load the GL functions
+bool CreateHeadlessContext();
+void DestroyHeadlessContext();
+
+// Framebuffer object with an RGBA8 color buffer and a 24-bit depth buffer
+class OffscreenTarget
+{
+public:
+	OffscreenTarget();
+
+	bool Create(int width, int height);
+	void Destroy();
+
+	// Draw and read into the target, with a viewport covering it
+	void Bind() const;
+
+	// Read the color buffer back and write it top row first as an 8-bit RGBA PNG
+	bool SavePng(const char* path) const;
+
+	int GetWidth() const { return mWidth; }
+	int GetHeight() const { return mHeight; }
+
+private:
+	GLuint mFramebuffer;
+	GLuint mColorBuffer;
+	GLuint mDepthBuffer;
+	int mWidth;
+	int mHeight;
+};
@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////////////////////////
+// lod.cpp
+// ========
+// level-of-detail selection for the round primitives
+///////////////////////////////////////////////////////////////////////////////
+
+#include "lod.h"
+
+#include "workerpool.h"
+
+namespace
+{
+	// Smallest on-screen height, in pixels, of levels 0 to 2. Smaller objects use level 3.
+	const float LOD_MIN_HEIGHT[Meshes::LOD_LEVELS - 1] = { 240.0f, 110.0f, 45.0f };
+
+	// Share of a threshold the size must move past before the level changes
+	const float LOD_HYSTERESIS = 0.15f;
+
+	// Objects per slice of a parallel selection
+	const size_t LOD_GRAIN = 1024;
+}
+
+///////////////////////////////////////////////////
+//	CountTriangles(const DrawRange*, int)
+//
+//	Strips and fans give one triangle per vertex
+//	after the first two, lists one per three
+///////////////////////////////////////////////////
+unsigned int CountTriangles(const DrawRange* ranges, int nRanges)
+{
+	unsigned int triangles = 0;
+	for (int r = 0; r < nRanges; ++r)
+	{
+		const DrawRange& range = ranges[r];
+		if (range.mode == GL_TRIANGLES)
+			triangles += range.count / 3;
+		else if ((range.mode == GL_TRIANGLE_STRIP || range.mode == GL_TRIANGLE_FAN) && range.count > 2)
+			triangles += range.count - 2;
+	}
+	return triangles;
+}
+
+LodSelector::LodSelector()
+	: mEnabled(true)
+	, mTriangleCount(0)
+	, mFullDetailTriangleCount(0)
+{
+	for (int level = 0; level < Meshes::LOD_LEVELS; ++level)
+		mLevelCounts[level] = 0;
+}
+
+///////////////////////////////////////////////////
+//	Select(vector<SceneObject>&, const vector<unsigned char>&, const SceneGraph&, const mat4&, float, int, WorkerPool*)
+//
+//	The mesh sphere is moved to world space with the
+//	largest scale of the world matrix. Its projected
+//	height is diameter * projectionScale / w pixels
+//	over the viewport's half height, w being 1 for an
+//	orthographic projection. With a pool, slices of
+//	the scene are selected in parallel, each counting
+//	into its own entry of mSliceCounts.
+///////////////////////////////////////////////////
+void LodSelector::Select(std::vector<SceneObject>& scene, const std::vector<unsigned char>& visible, const SceneGraph& graph,
+	const glm::mat4& viewProjection, float projectionScale, int viewportHeight, WorkerPool* pool)
+{
+	auto select = [&](size_t first, size_t last, size_t slice)
+	{
+		Counts& counts = mSliceCounts[slice];
+		counts = Counts();
+		for (size_t i = first; i < last; ++i)
+		{
+			if (!visible[i])
+				continue;
+
+			SceneObject& object = scene[i];
+			if (object.lod)
+			{
+				int level = 0;
+				if (mEnabled)
+				{
+					const glm::mat4& model = graph.GetWorldMatrix(object.node);
+					const glm::vec4 center = model * glm::vec4(object.lod->levels[0]->sphereCenter, 1.0f);
+					const float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+					const float w = (viewProjection * center).w;
+
+					// Camera inside the sphere keeps full detail
+					const float radius = object.lod->levels[0]->sphereRadius * scale;
+					if (w > radius)
+					{
+						const float height = radius * projectionScale / w * (float)viewportHeight;
+
+						// Coarser while below the threshold of the current level, finer while above the one before
+						level = object.lodLevel;
+						while (level < Meshes::LOD_LEVELS - 1 && height < LOD_MIN_HEIGHT[level] * (1.0f - LOD_HYSTERESIS))
+							++level;
+						while (level > 0 && height > LOD_MIN_HEIGHT[level - 1] * (1.0f + LOD_HYSTERESIS))
+							--level;
+					}
+				}
+				SetLodLevel(object, level);
+			}
+
+			counts.levels[object.lodLevel]++;
+			counts.triangles += CountTriangles(object.ranges, object.nRanges);
+			counts.fullDetailTriangles += CountTriangles(object.lod ? object.baseRanges : object.ranges, object.nRanges);
+		}
+	};
+
+	if (pool)
+	{
+		mSliceCounts.resize(WorkerPool::GetChunkCount(scene.size(), LOD_GRAIN));
+		pool->ParallelFor(scene.size(), LOD_GRAIN, select);
+	}
+	else
+	{
+		mSliceCounts.resize(1);
+		select(0, scene.size(), 0);
+	}
+
+	mTriangleCount = 0;
+	mFullDetailTriangleCount = 0;
+	for (int level = 0; level < Meshes::LOD_LEVELS; ++level)
+		mLevelCounts[level] = 0;
+	for (const Counts& counts : mSliceCounts)
+	{
+		mTriangleCount += counts.triangles;
+		mFullDetailTriangleCount += counts.fullDetailTriangles;
+		for (int level = 0; level < Meshes::LOD_LEVELS; ++level)
+			mLevelCounts[level] += counts.levels[level];
+	}
+}
@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+// lod.h
+// ========
+// level-of-detail selection for the round primitives
+//
+//	Objects given a level table (see SetMeshLod) are switched each frame to
+//	the level matching the height of their bounding sphere on screen. A
+//	level is only left once the size is a margin past its threshold, so an
+//	object sitting right at a threshold does not pop back and forth.
+//	Objects only change their own level, so slices of the scene can be
+//	selected on a worker pool.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+#include "scenegraph.h"
+
+class WorkerPool;
+
+// Triangles drawn by a set of draw ranges
+unsigned int CountTriangles(const DrawRange* ranges, int nRanges);
+
+class LodSelector
+{
+public:
+	LodSelector();
+
+	// Turning selection off puts every object back at level 0
+	void SetEnabled(bool enabled) { mEnabled = enabled; }
+	bool GetEnabled() const { return mEnabled; }
+
+	// Pick the level of the visible objects and count their triangles.
+	// viewportHeight is in pixels.
+	void Select(std::vector<SceneObject>& scene, const std::vector<unsigned char>& visible, const SceneGraph& graph,
+		const glm::mat4& viewProjection, float projectionScale, int viewportHeight, WorkerPool* pool = nullptr);
+
+	// Triangles of the visible objects at the chosen levels, and at level 0
+	unsigned int GetTriangleCount() const { return mTriangleCount; }
+	unsigned int GetFullDetailTriangleCount() const { return mFullDetailTriangleCount; }
+
+	// Visible objects at each level during the last Select
+	unsigned int GetLevelCount(int level) const { return mLevelCounts[level]; }
+
+private:
+	// Totals of one slice of the scene
+	struct Counts
+	{
+		unsigned int triangles;
+		unsigned int fullDetailTriangles;
+		unsigned int levels[Meshes::LOD_LEVELS];
+	};
+
+	bool mEnabled;
+	unsigned int mTriangleCount;
+	unsigned int mFullDetailTriangleCount;
+	unsigned int mLevelCounts[Meshes::LOD_LEVELS];
+	std::vector<Counts> mSliceCounts;
+};
@@ -15,6 +15,19 @@ namespace
 {
 	const double M_PI = 3.14159265358979323846f;
 	const double M_PI_2 = 1.571428571428571;
+
+	// Append one interleaved vertex: position, normal, texture coords
+	void PushVertex(std::vector<GLfloat>& data, glm::vec3 position, glm::vec3 normal, glm::vec2 uv)
+	{
+		data.push_back(position.x);
+		data.push_back(position.y);
+		data.push_back(position.z);
+		data.push_back(normal.x);
+		data.push_back(normal.y);
+		data.push_back(normal.z);
+		data.push_back(uv.x);
+		data.push_back(uv.y);
+	}
 }
 
 ///////////////////////////////////////////////////
@@ -34,7 +47,8 @@ void Meshes::CreateMeshes()
 	UCreatePyramid3Mesh(gPyramid3Mesh);
 	UCreatePyramid4Mesh(gPyramid4Mesh);
 	UCreateSphereMesh(gSphereMesh);
-	UCreateTorusMesh(gTorusMesh);
+	UCreateTorusMesh(gTorusMesh, 30, 30);
+	UCreateLods();
 }
 
 ///////////////////////////////////////////////////
@@ -53,6 +67,150 @@ void Meshes::DestroyMeshes()
 	UDestroyMesh(gPrismMesh);
 	UDestroyMesh(gSphereMesh);
 	UDestroyMesh(gTorusMesh);
+
+	for (int i = 0; i < LOD_LEVELS - 1; ++i)
+	{
+		UDestroyMesh(gConeLodMeshes[i]);
+		UDestroyMesh(gCylinderLodMeshes[i]);
+		UDestroyMesh(gSphereLodMeshes[i]);
+		UDestroyMesh(gTorusLodMeshes[i]);
+	}
+}
+
+///////////////////////////////////////////////////
+//	CreateMeshArena()
+//
+//	Copy the vertex and index data of all the meshes
+//	into a single pair of buffers, so any primitive
+//	can be drawn without switching VAO. Meshes drawn
+//	with glDrawArrays get a sequential index range,
+//	which lets every mesh be drawn as elements:
+//
+//	glDrawElementsBaseVertex(mode, count, GL_UNSIGNED_INT,
+//		(void*)(sizeof(GLuint) * (mesh.firstIndex + first)), mesh.baseVertex);
+///////////////////////////////////////////////////
+void Meshes::CreateMeshArena()
+{
+	std::vector<GLMesh*> meshList = {
+		&gPlaneMesh, &gPrismMesh, &gBoxMesh, &gConeMesh, &gCylinderMesh,
+		&gTaperedCylinderMesh, &gPyramid3Mesh, &gPyramid4Mesh, &gSphereMesh, &gTorusMesh
+	};
+	for (int i = 0; i < LOD_LEVELS - 1; ++i)
+	{
+		meshList.push_back(&gConeLodMeshes[i]);
+		meshList.push_back(&gCylinderLodMeshes[i]);
+		meshList.push_back(&gSphereLodMeshes[i]);
+		meshList.push_back(&gTorusLodMeshes[i]);
+	}
+	const int meshCount = (int)meshList.size();
+
+	// Vertex layout shared by every mesh
+	const GLuint floatsPerVertex = 3;
+	const GLuint floatsPerNormal = 3;
+	const GLuint floatsPerUV = 2;
+	const GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
+
+	// Assign each mesh its place in the arena
+	gArena.nVertices = 0;
+	gArena.nIndices = 0;
+	for (int i = 0; i < meshCount; ++i)
+	{
+		GLMesh& mesh = *meshList[i];
+		mesh.baseVertex = gArena.nVertices;
+		mesh.firstIndex = gArena.nIndices;
+		gArena.nVertices += mesh.nVertices;
+		gArena.nIndices += (mesh.nIndices > 0) ? mesh.nIndices : mesh.nVertices;
+	}
+
+	glGenVertexArrays(1, &gArena.vao);
+	glBindVertexArray(gArena.vao);
+
+	glGenBuffers(2, gArena.vbos);
+	glBindBuffer(GL_ARRAY_BUFFER, gArena.vbos[0]);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)stride * gArena.nVertices, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gArena.vbos[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)sizeof(GLuint) * gArena.nIndices, nullptr, GL_STATIC_DRAW);
+
+	// Copy on the GPU, the source data was never kept on the CPU side
+	for (int i = 0; i < meshCount; ++i)
+	{
+		const GLMesh& mesh = *meshList[i];
+
+		glBindBuffer(GL_COPY_READ_BUFFER, mesh.vbos[0]);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, (GLintptr)stride * mesh.baseVertex, (GLsizeiptr)stride * mesh.nVertices);
+
+		if (mesh.nIndices > 0)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, mesh.vbos[1]);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(GLuint) * mesh.firstIndex, sizeof(GLuint) * mesh.nIndices);
+		}
+		else
+		{
+			std::vector<GLuint> sequential(mesh.nVertices);
+			for (GLuint v = 0; v < mesh.nVertices; ++v)
+				sequential[v] = v;
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * mesh.firstIndex, sizeof(GLuint) * mesh.nVertices, sequential.data());
+		}
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	// Create Vertex Attribute Pointers
+	glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
+	glEnableVertexAttribArray(1);
+
+	glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
+	glEnableVertexAttribArray(2);
+
+	glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////
+//	DestroyMeshArena()
+//
+//	Release the shared arena buffers
+///////////////////////////////////////////////////
+void Meshes::DestroyMeshArena()
+{
+	glDeleteVertexArrays(1, &gArena.vao);
+	glDeleteBuffers(2, gArena.vbos);
+}
+
+///////////////////////////////////////////////////
+//	UComputeBounds(GLMesh&, const GLfloat*, GLuint)
+//
+//	mesh: reference to mesh structure for storing data
+//	vertexData: interleaved position, normal and uv
+//	nVertices: number of vertices in vertexData
+//
+//	The sphere is centered on the box and sized by
+//	the farthest vertex, which is tighter than half
+//	the box diagonal for round meshes
+///////////////////////////////////////////////////
+void Meshes::UComputeBounds(GLMesh& mesh, const GLfloat* vertexData, GLuint nVertices)
+{
+	const GLuint floatsPerVertex = 3 + 3 + 2;
+
+	mesh.boundsMin = glm::vec3(0.0f);
+	mesh.boundsMax = glm::vec3(0.0f);
+	for (GLuint i = 0; i < nVertices; ++i)
+	{
+		const glm::vec3 position(vertexData[i * floatsPerVertex], vertexData[i * floatsPerVertex + 1], vertexData[i * floatsPerVertex + 2]);
+		mesh.boundsMin = (i == 0) ? position : glm::min(mesh.boundsMin, position);
+		mesh.boundsMax = (i == 0) ? position : glm::max(mesh.boundsMax, position);
+	}
+
+	mesh.sphereCenter = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+	float radius2 = 0.0f;
+	for (GLuint i = 0; i < nVertices; ++i)
+	{
+		const glm::vec3 position(vertexData[i * floatsPerVertex], vertexData[i * floatsPerVertex + 1], vertexData[i * floatsPerVertex + 2]);
+		const glm::vec3 offset = position - mesh.sphereCenter;
+		radius2 = glm::max(radius2, glm::dot(offset, offset));
+	}
+	mesh.sphereRadius = glm::sqrt(radius2);
 }
 
 ///////////////////////////////////////////////////
@@ -100,6 +258,7 @@ void Meshes::UCreatePlaneMesh(GLMesh& mesh)
 	glGenBuffers(2, mesh.vbos);
 	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
 	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends data to the GPU
+	UComputeBounds(mesh, verts, mesh.nVertices);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]); // Activates the buffer
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
@@ -169,6 +328,7 @@ void Meshes::UCreatePyramid3Mesh(GLMesh& mesh)
 	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);	// Activates the VBO
 	// Sends vertex or coordinate data to the GPU
 	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+	UComputeBounds(mesh, verts, mesh.nVertices);
 
 	// Strides between sets of attribute data
 	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerColor + floatsPerUV);
@@ -242,6 +402,7 @@ void Meshes::UCreatePyramid4Mesh(GLMesh& mesh)
 	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);	// Activates the VBO
 	// Sends vertex or coordinate data to the GPU
 	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+	UComputeBounds(mesh, verts, mesh.nVertices);
 
 	// Strides between sets of attribute data
 	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerColor + floatsPerUV);
@@ -330,6 +491,7 @@ void Meshes::UCreatePrismMesh(GLMesh& mesh)
 	glGenBuffers(1, mesh.vbos);
 	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
 	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	UComputeBounds(mesh, verts, mesh.nVertices);
 
 	// Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
 	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);// The number of floats before each
@@ -430,6 +592,7 @@ void Meshes::UCreateBoxMesh(GLMesh& mesh)
 	glGenBuffers(2, mesh.vbos);
 	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
 	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	UComputeBounds(mesh, verts, mesh.nVertices);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]); // Activates the buffer
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
@@ -629,6 +792,7 @@ void Meshes::UCreateConeMesh(GLMesh& mesh)
 	glGenBuffers(1, mesh.vbos);
 	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
 	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	UComputeBounds(mesh, verts, mesh.nVertices);
 
 	// Strides between vertex coordinates
 	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
@@ -928,6 +1092,7 @@ void Meshes::UCreateCylinderMesh(GLMesh& mesh)
 	glGenBuffers(1, mesh.vbos);
 	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
 	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	UComputeBounds(mesh, verts, mesh.nVertices);
 
 	// Strides between vertex coordinates
 	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
@@ -1201,6 +1366,7 @@ void Meshes::UCreateTaperedCylinderMesh(GLMesh& mesh)
 	glGenBuffers(1, mesh.vbos);
 	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
 	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	UComputeBounds(mesh, verts, mesh.nVertices);
 
 	// Strides between vertex coordinates
 	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
@@ -1217,9 +1383,11 @@ void Meshes::UCreateTaperedCylinderMesh(GLMesh& mesh)
 }
 
 ///////////////////////////////////////////////////
-//	UCreateTorusMesh(GLMesh&)
+//	UCreateTorusMesh(GLMesh&, int, int)
 //
 //	mesh: reference to mesh structure for storing data
+//	mainSegments: segments around the ring
+//	tubeSegments: segments around the tube
 //
 //	Create a torus mesh and store it in a VAO/VBO
 //
@@ -1227,10 +1395,10 @@ void Meshes::UCreateTaperedCylinderMesh(GLMesh& mesh)
 //
 //	glDrawArrays(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices);
 ///////////////////////////////////////////////////
-void Meshes::UCreateTorusMesh(GLMesh& mesh)
+void Meshes::UCreateTorusMesh(GLMesh& mesh, int mainSegments, int tubeSegments)
 {
-	int _mainSegments = 30;
-	int _tubeSegments = 30;
+	int _mainSegments = mainSegments;
+	int _tubeSegments = tubeSegments;
 	float _mainRadius = 1.0f;
 	float _tubeRadius = .1f;
 
@@ -1459,6 +1627,7 @@ void Meshes::UCreateTorusMesh(GLMesh& mesh)
 	glGenBuffers(1, mesh.vbos);
 	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
 	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * combined_values.size(), combined_values.data(), GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	UComputeBounds(mesh, combined_values.data(), mesh.nVertices);
 
 	// Strides between vertex coordinates
 	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
@@ -2305,6 +2474,7 @@ void Meshes::UCreateSphereMesh(GLMesh& mesh)
 	glGenBuffers(2, mesh.vbos);
 	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the vertex buffer
 	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * combined_values.size(), combined_values.data(), GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	UComputeBounds(mesh, combined_values.data(), mesh.nVertices);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]); // Activates the index buffer
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
@@ -2323,6 +2493,269 @@ void Meshes::UCreateSphereMesh(GLMesh& mesh)
 	glEnableVertexAttribArray(2);
 }
 
+///////////////////////////////////////////////////
+//	UCreateConeLodMesh(GLMesh&, int)
+//
+//	mesh: reference to mesh structure for storing data
+//	slices: vertices around the base
+//
+//	Same layout as UCreateConeMesh with fewer slices:
+//
+//	glDrawArrays(GL_TRIANGLE_FAN, 0, slices);					//bottom
+//	glDrawArrays(GL_TRIANGLE_STRIP, slices, 2 * slices + 2);	//sides
+///////////////////////////////////////////////////
+void Meshes::UCreateConeLodMesh(GLMesh& mesh, int slices)
+{
+	std::vector<GLfloat> verts;
+
+	// bottom, ring going from +x toward -z like the table
+	for (int i = 0; i < slices; ++i)
+	{
+		const float angle = 2.0f * M_PI * i / slices;
+		const glm::vec3 point(cos(angle), 0.0f, -sin(angle));
+		PushVertex(verts, point, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(0.5f + 0.5f * point.z, 0.5f + 0.5f * point.x));
+	}
+
+	// sides, one base vertex and one apex vertex per slice edge
+	for (int i = 0; i <= slices; ++i)
+	{
+		const float angle = 2.0f * M_PI * i / slices;
+		const glm::vec3 point(cos(angle), 0.0f, -sin(angle));
+		const glm::vec3 normal = glm::normalize(glm::vec3(point.x, 1.0f, point.z));
+		const float u = (float)i / slices;
+		PushVertex(verts, point, normal, glm::vec2(u, 0.0f));
+		PushVertex(verts, glm::vec3(0.0f, 1.0f, 0.0f), normal, glm::vec2(u, 1.0f));
+	}
+
+	UCreateMeshBuffers(mesh, verts, std::vector<GLuint>());
+}
+
+///////////////////////////////////////////////////
+//	UCreateCylinderLodMesh(GLMesh&, int)
+//
+//	mesh: reference to mesh structure for storing data
+//	slices: vertices around each cap
+//
+//	Same layout as UCreateCylinderMesh with fewer slices:
+//
+//	glDrawArrays(GL_TRIANGLE_FAN, 0, slices);						//bottom
+//	glDrawArrays(GL_TRIANGLE_FAN, slices, slices);					//top
+//	glDrawArrays(GL_TRIANGLE_STRIP, 2 * slices, 2 * slices + 2);	//sides
+///////////////////////////////////////////////////
+void Meshes::UCreateCylinderLodMesh(GLMesh& mesh, int slices)
+{
+	std::vector<GLfloat> verts;
+
+	// bottom then top, rings going from +x toward -z like the table
+	for (int cap = 0; cap < 2; ++cap)
+	{
+		const glm::vec3 normal(0.0f, cap == 0 ? -1.0f : 1.0f, 0.0f);
+		for (int i = 0; i < slices; ++i)
+		{
+			const float angle = 2.0f * M_PI * i / slices;
+			const glm::vec3 point(cos(angle), (float)cap, -sin(angle));
+			PushVertex(verts, point, normal, glm::vec2(0.5f + 0.5f * point.z, 0.5f + 0.5f * point.x));
+		}
+	}
+
+	// sides, top and bottom vertex of every slice edge
+	for (int i = 0; i <= slices; ++i)
+	{
+		const float angle = 2.0f * M_PI * i / slices;
+		const glm::vec3 normal(cos(angle), 0.0f, -sin(angle));
+		const float u = (float)i / slices;
+		PushVertex(verts, normal + glm::vec3(0.0f, 1.0f, 0.0f), normal, glm::vec2(u, 1.0f));
+		PushVertex(verts, normal, normal, glm::vec2(u, 0.0f));
+	}
+
+	UCreateMeshBuffers(mesh, verts, std::vector<GLuint>());
+}
+
+///////////////////////////////////////////////////
+//	UCreateSphereLodMesh(GLMesh&, int, int)
+//
+//	mesh: reference to mesh structure for storing data
+//	slices: vertices around each ring
+//	stacks: bands from pole to pole
+//
+//	Same layout as UCreateSphereMesh with fewer rings:
+//
+//	glDrawElements(GL_TRIANGLES, mesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+///////////////////////////////////////////////////
+void Meshes::UCreateSphereLodMesh(GLMesh& mesh, int slices, int stacks)
+{
+	std::vector<GLfloat> verts;
+	std::vector<GLuint> indices;
+
+	// top point, the rings, then the bottom point
+	std::vector<glm::vec3> points;
+	points.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+	for (int ring = 1; ring < stacks; ++ring)
+	{
+		const float polar = M_PI * ring / stacks;
+		for (int i = 0; i < slices; ++i)
+		{
+			const float angle = 2.0f * M_PI * i / slices;
+			points.push_back(glm::vec3(sin(polar) * cos(angle), cos(polar), sin(polar) * sin(angle)));
+		}
+	}
+	points.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
+
+	// texture coords from the normal, as in the table
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		const glm::vec3 normal = glm::normalize(points[i]);
+		const float u = atan2(normal.x, normal.z) / (2 * M_PI) + 0.5;
+		const float v = normal.y * 0.5 + 0.5;
+		PushVertex(verts, points[i], normal, glm::vec2(u, v));
+	}
+
+	const GLuint bottom = (GLuint)points.size() - 1;
+	for (int i = 0; i < slices; ++i)
+	{
+		const GLuint next = (i + 1) % slices;
+
+		// top cap
+		indices.push_back(0);
+		indices.push_back(1 + i);
+		indices.push_back(1 + next);
+
+		// bands between two rings
+		for (int ring = 1; ring < stacks - 1; ++ring)
+		{
+			const GLuint upper = 1 + (ring - 1) * slices;
+			const GLuint lower = upper + slices;
+			indices.push_back(upper + i);
+			indices.push_back(lower + i);
+			indices.push_back(lower + next);
+			indices.push_back(upper + i);
+			indices.push_back(lower + next);
+			indices.push_back(upper + next);
+		}
+
+		// bottom cap
+		const GLuint last = 1 + (stacks - 2) * slices;
+		indices.push_back(last + i);
+		indices.push_back(last + next);
+		indices.push_back(bottom);
+	}
+
+	UCreateMeshBuffers(mesh, verts, indices);
+}
+
+///////////////////////////////////////////////////
+//	UCreateLods()
+//
+//	Create the coarser levels of the cone, cylinder,
+//	sphere and torus, and describe the parts of every
+//	level. Level 0 is the mesh made by CreateMeshes.
+///////////////////////////////////////////////////
+void Meshes::UCreateLods()
+{
+	// Slices of levels 1 to 3, the tables have 36 around cones and cylinders
+	const int ringSlices[LOD_LEVELS - 1] = { 18, 10, 6 };
+	// The sphere table has 16 slices and 16 stacks, the torus 30 x 30 segments
+	const int sphereSlices[LOD_LEVELS - 1] = { 12, 8, 6 };
+	const int sphereStacks[LOD_LEVELS - 1] = { 10, 6, 4 };
+	const int torusMainSegments[LOD_LEVELS - 1] = { 20, 12, 8 };
+	const int torusTubeSegments[LOD_LEVELS - 1] = { 12, 8, 5 };
+
+	gConeLod.nParts = 2;
+	gConeLod.levels[0] = &gConeMesh;
+	gConeLod.partFirst[0][0] = 0;	gConeLod.partCount[0][0] = 36;		//bottom
+	gConeLod.partFirst[0][1] = 36;	gConeLod.partCount[0][1] = 108;		//sides
+
+	gCylinderLod.nParts = 3;
+	gCylinderLod.levels[0] = &gCylinderMesh;
+	gCylinderLod.partFirst[0][0] = 0;	gCylinderLod.partCount[0][0] = 36;	//bottom
+	gCylinderLod.partFirst[0][1] = 36;	gCylinderLod.partCount[0][1] = 36;	//top
+	gCylinderLod.partFirst[0][2] = 72;	gCylinderLod.partCount[0][2] = 146;	//sides
+
+	gSphereLod.nParts = 1;
+	gSphereLod.levels[0] = &gSphereMesh;
+	gSphereLod.partFirst[0][0] = 0;	gSphereLod.partCount[0][0] = gSphereMesh.nIndices;
+
+	gTorusLod.nParts = 1;
+	gTorusLod.levels[0] = &gTorusMesh;
+	gTorusLod.partFirst[0][0] = 0;	gTorusLod.partCount[0][0] = gTorusMesh.nVertices;
+
+	for (int i = 0; i < LOD_LEVELS - 1; ++i)
+	{
+		const int level = i + 1;
+		const int slices = ringSlices[i];
+
+		UCreateConeLodMesh(gConeLodMeshes[i], slices);
+		gConeLod.levels[level] = &gConeLodMeshes[i];
+		gConeLod.partFirst[level][0] = 0;		gConeLod.partCount[level][0] = slices;
+		gConeLod.partFirst[level][1] = slices;	gConeLod.partCount[level][1] = 2 * slices + 2;
+
+		UCreateCylinderLodMesh(gCylinderLodMeshes[i], slices);
+		gCylinderLod.levels[level] = &gCylinderLodMeshes[i];
+		gCylinderLod.partFirst[level][0] = 0;			gCylinderLod.partCount[level][0] = slices;
+		gCylinderLod.partFirst[level][1] = slices;		gCylinderLod.partCount[level][1] = slices;
+		gCylinderLod.partFirst[level][2] = 2 * slices;	gCylinderLod.partCount[level][2] = 2 * slices + 2;
+
+		UCreateSphereLodMesh(gSphereLodMeshes[i], sphereSlices[i], sphereStacks[i]);
+		gSphereLod.levels[level] = &gSphereLodMeshes[i];
+		gSphereLod.partFirst[level][0] = 0;	gSphereLod.partCount[level][0] = gSphereLodMeshes[i].nIndices;
+
+		UCreateTorusMesh(gTorusLodMeshes[i], torusMainSegments[i], torusTubeSegments[i]);
+		gTorusLod.levels[level] = &gTorusLodMeshes[i];
+		gTorusLod.partFirst[level][0] = 0;	gTorusLod.partCount[level][0] = gTorusLodMeshes[i].nVertices;
+	}
+}
+
+///////////////////////////////////////////////////
+//	UCreateMeshBuffers(GLMesh&, const vector<GLfloat>&, const vector<GLuint>&)
+//
+//	mesh: reference to mesh structure for storing data
+//	vertexData: interleaved position, normal, texture coords
+//	indices: element data, empty for glDrawArrays meshes
+//
+//	Create the VAO/VBOs of a generated mesh
+///////////////////////////////////////////////////
+void Meshes::UCreateMeshBuffers(GLMesh& mesh, const std::vector<GLfloat>& vertexData, const std::vector<GLuint>& indices)
+{
+	// total float values per each type
+	const GLuint floatsPerVertex = 3;
+	const GLuint floatsPerNormal = 3;
+	const GLuint floatsPerUV = 2;
+
+	// store vertex and index count
+	mesh.nVertices = vertexData.size() / (floatsPerVertex + floatsPerNormal + floatsPerUV);
+	mesh.nIndices = indices.size();
+
+	// Create VAO
+	glGenVertexArrays(1, &mesh.vao);
+	glBindVertexArray(mesh.vao);
+
+	// Create VBOs, the index buffer only when there are indices
+	mesh.vbos[1] = 0;
+	glGenBuffers(indices.empty() ? 1 : 2, mesh.vbos);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+	UComputeBounds(mesh, vertexData.data(), mesh.nVertices);
+
+	if (!indices.empty())
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
+	}
+
+	// Strides between vertex coordinates
+	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
+
+	// Create Vertex Attribute Pointers
+	glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
+	glEnableVertexAttribArray(1);
+
+	glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
+	glEnableVertexAttribArray(2);
+}
+
 void Meshes::UDestroyMesh(GLMesh& mesh)
 {
 	glDeleteVertexArrays(1, &mesh.vao);
@@ -11,10 +11,13 @@
 
 #include <GL/glew.h>
 
+#include <vector>
+
 #include <glm/glm.hpp>
 
 class Meshes
 {
+public:
 	// Stores the GL data relative to a given mesh
 	struct GLMesh
 	{
@@ -22,9 +25,38 @@ class Meshes
 		GLuint vbos[2];     // Handles for the vertex buffer objects
 		GLuint nVertices;	// Number of vertices for the mesh
 		GLuint nIndices;    // Number of indices for the mesh
+		GLint baseVertex;   // First vertex of the mesh inside the shared arena
+		GLuint firstIndex;  // First index of the mesh inside the shared arena
+		glm::vec3 boundsMin;    // Local axis-aligned bounding box
+		glm::vec3 boundsMax;
+		glm::vec3 sphereCenter; // Local bounding sphere
+		float sphereRadius;
+	};
+
+	// Every primitive packed into one vertex buffer and one index buffer
+	struct GLMeshArena
+	{
+		GLuint vao;         // Handle for the vertex array object
+		GLuint vbos[2];     // Vertex buffer and index buffer
+		GLuint nVertices;	// Total vertices of all meshes
+		GLuint nIndices;    // Total indices of all meshes
+	};
+
+	// Detail levels of a primitive, level 0 being the full mesh
+	static const int LOD_LEVELS = 4;
+	static const int LOD_PARTS = 3;
+
+	// Every level is split into the same parts (bottom, top, sides...),
+	// listed in the same order, so a draw range of level 0 can be moved
+	// to any other level
+	struct GLMeshLod
+	{
+		const GLMesh* levels[LOD_LEVELS];
+		GLint partFirst[LOD_LEVELS][LOD_PARTS];     // First vertex, or first index
+		GLsizei partCount[LOD_LEVELS][LOD_PARTS];
+		int nParts;
 	};
 
-public:
 	GLMesh gBoxMesh;
 	GLMesh gConeMesh;
 	GLMesh gCylinderMesh;
@@ -36,10 +68,27 @@ public:
 	GLMesh gPyramid4Mesh;
 	GLMesh gTorusMesh;
 
+	// Coarser levels of the round primitives, 1 to LOD_LEVELS - 1
+	GLMesh gConeLodMeshes[LOD_LEVELS - 1];
+	GLMesh gCylinderLodMeshes[LOD_LEVELS - 1];
+	GLMesh gSphereLodMeshes[LOD_LEVELS - 1];
+	GLMesh gTorusLodMeshes[LOD_LEVELS - 1];
+
+	GLMeshLod gConeLod;
+	GLMeshLod gCylinderLod;
+	GLMeshLod gSphereLod;
+	GLMeshLod gTorusLod;
+
+	GLMeshArena gArena;
+
 public:
 	void CreateMeshes();
 	void DestroyMeshes();
 
+	// Pack the created meshes into gArena, filling baseVertex/firstIndex of each
+	void CreateMeshArena();
+	void DestroyMeshArena();
+
 private:
 	void UCreatePlaneMesh(GLMesh &mesh);
 	void UCreatePrismMesh(GLMesh &mesh);
@@ -47,12 +96,26 @@ private:
 	void UCreateConeMesh(GLMesh &mesh);
 	void UCreateCylinderMesh(GLMesh &mesh);
 	void UCreateTaperedCylinderMesh(GLMesh &mesh);
-	void UCreateTorusMesh(GLMesh &mesh);
+	void UCreateTorusMesh(GLMesh &mesh, int mainSegments, int tubeSegments);
 	void UCreatePyramid3Mesh(GLMesh &mesh);
 	void UCreatePyramid4Mesh(GLMesh &mesh);
 	void UCreateSphereMesh(GLMesh &mesh);
 
+	// Generated versions of the round primitives with fewer slices
+	void UCreateConeLodMesh(GLMesh &mesh, int slices);
+	void UCreateCylinderLodMesh(GLMesh &mesh, int slices);
+	void UCreateSphereLodMesh(GLMesh &mesh, int slices, int stacks);
+
+	// Create the coarser meshes and fill the level tables
+	void UCreateLods();
+
+	// Store interleaved vertices, and indices when any, in the VAO/VBOs of a mesh
+	void UCreateMeshBuffers(GLMesh &mesh, const std::vector<GLfloat>& vertexData, const std::vector<GLuint>& indices);
+
 	void UDestroyMesh(GLMesh &mesh);
 
+	// Fill the bounding volumes of a mesh from its interleaved vertex data
+	void UComputeBounds(GLMesh &mesh, const GLfloat* vertexData, GLuint nVertices);
+
 	void CalculateTriangleNormal(glm::vec3 px, glm::vec3 py, glm::vec3 pz);
 };
\ No newline at end of file
@@ -0,0 +1,569 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusion.cpp
+// ========
+// GPU occlusion culling against a hierarchical depth buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#include "occlusion.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "glstate.h"
+#include "shaderblocks.h"
+
+// Shader program Macro //
+#ifndef GLSL
+#define GLSL(Version, Source) "#version " #Version " core \n" #Source
+#endif
+
+namespace
+{
+	// Storage bindings used only by the compute passes. The object buffer
+	// and the visible buffer keep the bindings the scene shaders read.
+	const GLuint ITEM_BATCH_BINDING = 3;
+	const GLuint BATCH_COUNT_BINDING = 4;
+	const GLuint OCCLUSION_STATS_BINDING = 5;
+	const GLuint COMMAND_BATCH_BINDING = 6;
+	const GLuint COMMAND_BINDING = 7;
+
+	// Size of one DrawElementsIndirectCommand, five GLuint
+	const GLsizeiptr COMMAND_BYTES = 5 * sizeof(GLuint);
+
+	// The pyramid is sampled from this unit, unit 0 belongs to the scene textures
+	const GLuint HIZ_TEXTURE_UNIT = 1;
+
+	const GLuint REDUCE_GROUP_SIZE = 8;
+	const GLuint CULL_GROUP_SIZE = 64;
+
+	/* Depth texture to pyramid level 0, keeping the farthest depth */
+	const GLchar* reduceDepthShaderSource = GLSL(440,
+
+	layout(local_size_x = 8, local_size_y = 8) in;
+
+	layout(binding = 1) uniform sampler2D depthTexture;
+	layout(r32f, binding = 1) writeonly uniform image2D destination;
+
+	void main()
+	{
+		ivec2 size = imageSize(destination);
+		ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+		if (texel.x >= size.x || texel.y >= size.y)
+			return;
+
+		// The last texel of a row or column also covers the one left over by an odd size
+		ivec2 sourceSize = textureSize(depthTexture, 0);
+		ivec2 first = texel * 2;
+		ivec2 last = min(first + 1 + ivec2(equal(texel, size - 1)) * (sourceSize - size * 2), sourceSize - 1);
+
+		float depth = 0.0;
+		for (int y = first.y; y <= last.y; ++y)
+		{
+			for (int x = first.x; x <= last.x; ++x)
+				depth = max(depth, texelFetch(depthTexture, ivec2(x, y), 0).r);
+		}
+		imageStore(destination, texel, vec4(depth));
+	}
+	);
+
+	/* Pyramid level to the next one, keeping the farthest depth */
+	const GLchar* reduceShaderSource = GLSL(440,
+
+	layout(local_size_x = 8, local_size_y = 8) in;
+
+	layout(r32f, binding = 0) readonly uniform image2D source;
+	layout(r32f, binding = 1) writeonly uniform image2D destination;
+
+	void main()
+	{
+		ivec2 size = imageSize(destination);
+		ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+		if (texel.x >= size.x || texel.y >= size.y)
+			return;
+
+		// The last texel of a row or column also covers the one left over by an odd size
+		ivec2 sourceSize = imageSize(source);
+		ivec2 first = texel * 2;
+		ivec2 last = min(first + 1 + ivec2(equal(texel, size - 1)) * (sourceSize - size * 2), sourceSize - 1);
+
+		float depth = 0.0;
+		for (int y = first.y; y <= last.y; ++y)
+		{
+			for (int x = first.x; x <= last.x; ++x)
+				depth = max(depth, imageLoad(source, ivec2(x, y)).r);
+		}
+		imageStore(destination, texel, vec4(depth));
+	}
+	);
+
+	/* Bounding box test of every item, visible ones packed per batch */
+	const GLchar* cullShaderSource = GLSL(440,
+
+	layout(local_size_x = 64) in;
+
+	//Per-object block written by the render queue, see ObjectData
+	struct ObjectData
+	{
+		mat4 model;
+		vec4 specular;
+		vec4 color;
+		vec4 uvScale;
+		vec4 boundsMin; // Mesh space box
+		vec4 boundsMax;
+	};
+	layout(std430, binding = 1) readonly buffer ObjectBlock
+	{
+		ObjectData objects[];
+	};
+	layout(std430, binding = 2) writeonly buffer VisibleBlock
+	{
+		uint visibleObjects[];
+	};
+	layout(std430, binding = 3) readonly buffer ItemBatchBlock
+	{
+		uvec2 itemBatches[]; // Batch index, first item of the batch
+	};
+	layout(std430, binding = 4) buffer BatchCountBlock
+	{
+		uint batchCounts[];
+	};
+	layout(std430, binding = 5) buffer OcclusionStatsBlock
+	{
+		uint occludedCount;
+	};
+
+	layout(binding = 1) uniform sampler2D hiZ;
+	layout(location = 0) uniform mat4 previousViewProjection;
+	layout(location = 1) uniform vec2 viewportSize;
+	layout(location = 2) uniform int hiZLevels;
+	layout(location = 3) uniform uint objectCount;
+
+	bool IsVisible(uint object)
+	{
+		mat4 mvp = previousViewProjection * objects[object].model;
+		vec3 boundsMin = objects[object].boundsMin.xyz;
+		vec3 boundsMax = objects[object].boundsMax.xyz;
+
+		vec3 ndcMin = vec3(1.0e30);
+		vec3 ndcMax = vec3(-1.0e30);
+		for (int c = 0; c < 8; ++c)
+		{
+			vec3 corner = mix(boundsMin, boundsMax, vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1));
+			vec4 clip = mvp * vec4(corner, 1.0);
+
+			// Crosses the previous camera plane, nothing to compare against
+			if (clip.w <= 0.0)
+				return true;
+
+			vec3 ndc = clip.xyz / clip.w;
+			ndcMin = min(ndcMin, ndc);
+			ndcMax = max(ndcMax, ndc);
+		}
+
+		// Partly off screen last frame, the pyramid has no depth for that part
+		if (any(lessThan(ndcMin.xy, vec2(-1.0))) || any(greaterThan(ndcMax.xy, vec2(1.0))))
+			return true;
+
+		vec2 pixelMin = (ndcMin.xy * 0.5 + 0.5) * viewportSize;
+		vec2 pixelMax = (ndcMax.xy * 0.5 + 0.5) * viewportSize;
+		float nearestDepth = ndcMin.z * 0.5 + 0.5;
+
+		// A texel of level L covers 2^(L+1) pixels, pick the level where the box spans two texels at most
+		vec2 extent = pixelMax - pixelMin;
+		int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))) - 1, 0, hiZLevels - 1);
+
+		// Level sizes follow from the uniform base size, textureSize with a level that differs
+		// between invocations returns the size of another invocation's level on some drivers
+		ivec2 levelSize = max((ivec2(viewportSize) / 2) >> level, ivec2(1));
+		ivec2 texelMin = min(ivec2(pixelMin) >> (level + 1), levelSize - 1);
+		ivec2 texelMax = min(ivec2(pixelMax) >> (level + 1), levelSize - 1);
+
+		float occluderDepth = 0.0;
+		for (int y = texelMin.y; y <= texelMax.y; ++y)
+		{
+			for (int x = texelMin.x; x <= texelMax.x; ++x)
+				occluderDepth = max(occluderDepth, texelFetch(hiZ, ivec2(x, y), level).r);
+		}
+		return nearestDepth <= occluderDepth;
+	}
+
+	void main()
+	{
+		uint object = gl_GlobalInvocationID.x;
+		if (object >= objectCount)
+			return;
+
+		uvec2 batch = itemBatches[object];
+		if (IsVisible(object))
+		{
+			uint slot = atomicAdd(batchCounts[batch.x], 1u);
+			visibleObjects[batch.y + slot] = object;
+		}
+		else
+			atomicAdd(occludedCount, 1u);
+	}
+	);
+
+	/* Visible count of its batch written into every indirect command */
+	const GLchar* patchShaderSource = GLSL(440,
+
+	layout(local_size_x = 64) in;
+
+	layout(std430, binding = 4) readonly buffer BatchCountBlock
+	{
+		uint batchCounts[];
+	};
+	layout(std430, binding = 6) readonly buffer CommandBatchBlock
+	{
+		uint commandBatches[];
+	};
+	layout(std430, binding = 7) buffer CommandBlock
+	{
+		uint commands[]; // count, instanceCount, firstIndex, baseVertex, baseInstance
+	};
+
+	layout(location = 0) uniform uint commandCount;
+
+	void main()
+	{
+		uint command = gl_GlobalInvocationID.x;
+		if (command >= commandCount)
+			return;
+
+		commands[command * 5u + 1u] = batchCounts[commandBatches[command]];
+	}
+	);
+
+	bool CreateComputeProgram(const char* source, GLuint& programId)
+	{
+		// Compilation and linkage error reporting
+		int success = 0;
+		char infoLog[512];
+
+		programId = glCreateProgram();
+		GLuint shaderId = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(shaderId, 1, &source, NULL);
+
+		glCompileShader(shaderId);
+		glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(shaderId, sizeof(infoLog), NULL, infoLog);
+			std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+			return false;
+		}
+
+		glAttachShader(programId, shaderId);
+		glLinkProgram(programId);
+		glGetProgramiv(programId, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
+			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+			return false;
+		}
+
+		// The program keeps the compiled code
+		glDeleteShader(shaderId);
+		return true;
+	}
+
+	GLuint GroupCount(GLuint items, GLuint groupSize)
+	{
+		return (items + groupSize - 1) / groupSize;
+	}
+}
+
+OcclusionCuller::OcclusionCuller()
+	: mReduceDepthProgram(0), mReduceProgram(0), mCullProgram(0), mPatchProgram(0),
+	mDepthTexture(0), mHiZTexture(0), mWidth(0), mHeight(0), mLevels(0),
+	mViewProjection(1.0f), mEnabled(true), mReady(false),
+	mItemBuffer(0), mItemBufferSize(0), mCommandBatchBuffer(0), mCommandBatchBufferSize(0),
+	mBatchCountBuffer(0), mBatchCountBufferSize(0), mVisibleBuffer(0), mVisibleBufferSize(0),
+	mFrame(0), mOccludedCount(0), mTestedCount(0)
+{
+	for (int i = 0; i < STATS_FRAMES; ++i)
+	{
+		mStatsBuffers[i] = 0;
+		mStatsFences[i] = 0;
+		mStatsTested[i] = 0;
+	}
+}
+
+///////////////////////////////////////////////////
+//	Create(int, int)
+//
+//	width, height: size of the default framebuffer
+//
+//	Level 0 of the pyramid is already half the
+//	framebuffer size, each level halves it again
+//	down to a single texel
+///////////////////////////////////////////////////
+bool OcclusionCuller::Create(int width, int height)
+{
+	if (!CreateComputeProgram(reduceDepthShaderSource, mReduceDepthProgram)
+		|| !CreateComputeProgram(reduceShaderSource, mReduceProgram)
+		|| !CreateComputeProgram(cullShaderSource, mCullProgram)
+		|| !CreateComputeProgram(patchShaderSource, mPatchProgram))
+		return false;
+
+	mWidth = width;
+	mHeight = height;
+
+	glGenTextures(1, &mDepthTexture);
+	glBindTexture(GL_TEXTURE_2D, mDepthTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, mWidth, mHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	const int baseWidth = std::max(mWidth / 2, 1);
+	const int baseHeight = std::max(mHeight / 2, 1);
+	mLevels = 1;
+	while ((std::max(baseWidth, baseHeight) >> mLevels) > 0)
+		++mLevels;
+
+	glGenTextures(1, &mHiZTexture);
+	glBindTexture(GL_TEXTURE_2D, mHiZTexture);
+	glTexStorage2D(GL_TEXTURE_2D, mLevels, GL_R32F, baseWidth, baseHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenBuffers(1, &mItemBuffer);
+	glGenBuffers(1, &mCommandBatchBuffer);
+	glGenBuffers(1, &mBatchCountBuffer);
+	glGenBuffers(1, &mVisibleBuffer);
+
+	const GLuint zero = 0;
+	glGenBuffers(STATS_FRAMES, mStatsBuffers);
+	for (int i = 0; i < STATS_FRAMES; ++i)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mStatsBuffers[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_READ);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	mReady = false;
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	Destroy()
+//
+//	Release the programs, textures and buffers
+///////////////////////////////////////////////////
+void OcclusionCuller::Destroy()
+{
+	glDeleteProgram(mReduceDepthProgram);
+	glDeleteProgram(mReduceProgram);
+	glDeleteProgram(mCullProgram);
+	glDeleteProgram(mPatchProgram);
+	mReduceDepthProgram = mReduceProgram = mCullProgram = mPatchProgram = 0;
+
+	glDeleteTextures(1, &mDepthTexture);
+	glDeleteTextures(1, &mHiZTexture);
+	mDepthTexture = mHiZTexture = 0;
+
+	glDeleteBuffers(1, &mItemBuffer);
+	glDeleteBuffers(1, &mCommandBatchBuffer);
+	glDeleteBuffers(1, &mBatchCountBuffer);
+	glDeleteBuffers(1, &mVisibleBuffer);
+	glDeleteBuffers(STATS_FRAMES, mStatsBuffers);
+	mItemBuffer = mCommandBatchBuffer = mBatchCountBuffer = mVisibleBuffer = 0;
+	mItemBufferSize = mCommandBatchBufferSize = mBatchCountBufferSize = mVisibleBufferSize = 0;
+	for (int i = 0; i < STATS_FRAMES; ++i)
+	{
+		mStatsBuffers[i] = 0;
+		if (mStatsFences[i] != 0)
+			glDeleteSync(mStatsFences[i]);
+		mStatsFences[i] = 0;
+	}
+
+	mReady = false;
+}
+
+///////////////////////////////////////////////////
+//	SetEnabled(bool)
+//
+//	A pyramid kept while disabled would be compared
+//	against a scene that may have changed since
+///////////////////////////////////////////////////
+void OcclusionCuller::SetEnabled(bool enabled)
+{
+	mEnabled = enabled;
+	mReady = false;
+	mOccludedCount = 0;
+	mTestedCount = 0;
+}
+
+///////////////////////////////////////////////////
+//	BuildPyramid(const mat4&)
+//
+//	viewProjection: matrix of the frame just drawn
+//
+//	Must be called before the buffers are swapped,
+//	while the back buffer still holds this frame's
+//	depth
+///////////////////////////////////////////////////
+void OcclusionCuller::BuildPyramid(const glm::mat4& viewProjection)
+{
+	if (!mEnabled || mHiZTexture == 0)
+		return;
+
+	// The default framebuffer depth cannot be sampled, copy it first
+	GLState().BindTexture(HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, mDepthTexture);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, mWidth, mHeight);
+
+	GLState().UseProgram(mReduceDepthProgram);
+	glBindImageTexture(1, mHiZTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	int width = std::max(mWidth / 2, 1);
+	int height = std::max(mHeight / 2, 1);
+	glDispatchCompute(GroupCount(width, REDUCE_GROUP_SIZE), GroupCount(height, REDUCE_GROUP_SIZE), 1);
+
+	GLState().UseProgram(mReduceProgram);
+	for (int level = 1; level < mLevels; ++level)
+	{
+		// The previous level must be complete before it is read
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+		glBindImageTexture(0, mHiZTexture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, mHiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute(GroupCount(width, REDUCE_GROUP_SIZE), GroupCount(height, REDUCE_GROUP_SIZE), 1);
+	}
+
+	// The cull pass reads the pyramid through a sampler
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	mViewProjection = viewProjection;
+	mReady = true;
+}
+
+///////////////////////////////////////////////////
+//	CullCommands(const vector<GLuint>&, const vector<GLuint>&, size_t, GLuint, GLintptr)
+//
+//	itemBatches: batch index and first item of that
+//	batch, two entries per item of the object buffer
+//	commandBatches: batch index of every command
+//	batchCount: number of batches of the frame
+//	indirectBuffer, indirectOffset: commands written
+//	for this frame
+//
+//	Expects the object buffer of the frame to be
+//	bound to OBJECT_BLOCK_BINDING. Afterwards the
+//	visible buffer holds, at baseInstance + i, the
+//	object buffer entry of instance i of each batch.
+///////////////////////////////////////////////////
+void OcclusionCuller::CullCommands(const std::vector<GLuint>& itemBatches, const std::vector<GLuint>& commandBatches, size_t batchCount,
+	GLuint indirectBuffer, GLintptr indirectOffset)
+{
+	const GLuint itemCount = (GLuint)(itemBatches.size() / 2);
+	const GLuint commandCount = (GLuint)commandBatches.size();
+	if (!IsReady() || itemCount == 0 || commandCount == 0)
+		return;
+
+	UploadBuffer(mItemBuffer, mItemBufferSize, itemBatches.data(), sizeof(GLuint) * itemBatches.size());
+	UploadBuffer(mCommandBatchBuffer, mCommandBatchBufferSize, commandBatches.data(), sizeof(GLuint) * commandBatches.size());
+	UploadBuffer(mBatchCountBuffer, mBatchCountBufferSize, nullptr, sizeof(GLuint) * batchCount);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	UploadBuffer(mVisibleBuffer, mVisibleBufferSize, nullptr, sizeof(GLuint) * itemCount);
+
+	// This frame's counter, in the slot of the oldest one, read back once the GPU is past it
+	ReadStats();
+	const int statsSlot = mFrame % STATS_FRAMES;
+	GLState().BindBuffer(GL_SHADER_STORAGE_BUFFER, mStatsBuffers[statsSlot]);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	mStatsTested[statsSlot] = itemCount;
+
+	GLState().BindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BLOCK_BINDING, mVisibleBuffer);
+	GLState().BindBufferBase(GL_SHADER_STORAGE_BUFFER, ITEM_BATCH_BINDING, mItemBuffer);
+	GLState().BindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_COUNT_BINDING, mBatchCountBuffer);
+	GLState().BindBufferBase(GL_SHADER_STORAGE_BUFFER, OCCLUSION_STATS_BINDING, mStatsBuffers[statsSlot]);
+	GLState().BindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BATCH_BINDING, mCommandBatchBuffer);
+	GLState().BindBufferRange(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, indirectBuffer, indirectOffset, COMMAND_BYTES * commandCount);
+
+	GLState().BindTexture(HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, mHiZTexture);
+
+	GLState().UseProgram(mCullProgram);
+	glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(mViewProjection));
+	glUniform2f(1, (GLfloat)mWidth, (GLfloat)mHeight);
+	glUniform1i(2, mLevels);
+	glUniform1ui(3, itemCount);
+	glDispatchCompute(GroupCount(itemCount, CULL_GROUP_SIZE), 1, 1);
+
+	// Every batch count must be final before it is copied
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	GLState().UseProgram(mPatchProgram);
+	glUniform1ui(0, commandCount);
+	glDispatchCompute(GroupCount(commandCount, CULL_GROUP_SIZE), 1, 1);
+
+	// The commands are read by the draws, the visible buffer by the vertex shader
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	if (mStatsFences[statsSlot] != 0)
+		glDeleteSync(mStatsFences[statsSlot]);
+	mStatsFences[statsSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	++mFrame;
+}
+
+///////////////////////////////////////////////////
+//	UploadBuffer(GLuint, GLsizeiptr&, const void*, GLsizeiptr)
+//
+//	Refill a storage buffer, growing it when needed.
+//	Leaves the buffer bound to GL_SHADER_STORAGE_BUFFER.
+///////////////////////////////////////////////////
+void OcclusionCuller::UploadBuffer(GLuint buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr bytes)
+{
+	GLState().BindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	if (bytes > capacity)
+	{
+		glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, data, GL_STREAM_DRAW);
+		capacity = bytes;
+	}
+	else
+	{
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+		if (data != nullptr)
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, data);
+	}
+}
+
+///////////////////////////////////////////////////
+//	ReadStats()
+//
+//	Read the newest counter whose fence has
+//	signalled, oldest slot first. The fences are
+//	only polled, so a frame the GPU has not
+//	finished is skipped rather than waited for,
+//	and the counts keep their last values.
+///////////////////////////////////////////////////
+void OcclusionCuller::ReadStats()
+{
+	for (unsigned int age = STATS_FRAMES; age > 0; --age)
+	{
+		if (mFrame < age)
+			continue;
+
+		const int slot = (mFrame - age) % STATS_FRAMES;
+		GLsync& fence = mStatsFences[slot];
+		if (fence == 0)
+			continue;
+
+		const GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			continue;
+		glDeleteSync(fence);
+		fence = 0;
+
+		GLuint occluded = 0;
+		GLState().BindBuffer(GL_SHADER_STORAGE_BUFFER, mStatsBuffers[slot]);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &occluded);
+
+		mOccludedCount = occluded;
+		mTestedCount = mStatsTested[slot];
+	}
+}
@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusion.h
+// ========
+// GPU occlusion culling against a hierarchical depth buffer
+//
+//	At the end of a frame the depth buffer is reduced into a Hi-Z pyramid,
+//	every level holding the farthest depth of the texels below it. The
+//	next frame, a compute shader projects the bounding box of each queued
+//	object with the view-projection that drew the pyramid and compares its
+//	nearest depth to a 2x2 texel footprint of the matching level. Visible
+//	objects are packed into their batch's instance range and the
+//	instanceCount of every indirect command is rewritten, so hidden
+//	objects cost no vertex work and the CPU never waits for the result.
+//
+//	The test uses last frame's depth, so an object that comes out from
+//	behind an occluder shows up one frame late.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+
+	// Compile the compute programs and allocate the pyramid for a framebuffer size
+	bool Create(int width, int height);
+	void Destroy();
+
+	// Turning the test off drops the pyramid, it is rebuilt on the next frame
+	void SetEnabled(bool enabled);
+	bool GetEnabled() const { return mEnabled; }
+
+	// True when a pyramid from the previous frame is available
+	bool IsReady() const { return mEnabled && mReady; }
+
+	// Reduce the depth buffer of the frame just drawn, with the matrix that drew it
+	void BuildPyramid(const glm::mat4& viewProjection);
+
+	// Test the items of the bound object buffer and rewrite the indirect commands.
+	//	itemBatches: batch index and first item of that batch, two entries per item
+	//	commandBatches: batch index of every command in the indirect buffer
+	void CullCommands(const std::vector<GLuint>& itemBatches, const std::vector<GLuint>& commandBatches, size_t batchCount,
+		GLuint indirectBuffer, GLintptr indirectOffset);
+
+	// Storage buffer mapping instance slots to object buffer entries after CullCommands
+	GLuint GetVisibleBuffer() const { return mVisibleBuffer; }
+
+	// Objects found hidden, read back once the GPU has finished the frame so it is never waited on
+	unsigned int GetOccludedCount() const { return mOccludedCount; }
+	unsigned int GetTestedCount() const { return mTestedCount; }
+
+private:
+	static const int STATS_FRAMES = 3;
+
+	void UploadBuffer(GLuint buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr bytes);
+	void ReadStats();
+
+	GLuint mReduceDepthProgram;     // Depth texture to pyramid level 0
+	GLuint mReduceProgram;          // Pyramid level to the next
+	GLuint mCullProgram;            // Object test and compaction
+	GLuint mPatchProgram;           // instanceCount of the indirect commands
+
+	GLuint mDepthTexture;           // Copy of the default framebuffer depth
+	GLuint mHiZTexture;             // R32F pyramid, level 0 at half resolution
+	int mWidth;
+	int mHeight;
+	int mLevels;
+
+	glm::mat4 mViewProjection;      // Matrix that produced the pyramid
+	bool mEnabled;
+	bool mReady;
+
+	GLuint mItemBuffer;
+	GLsizeiptr mItemBufferSize;
+	GLuint mCommandBatchBuffer;
+	GLsizeiptr mCommandBatchBufferSize;
+	GLuint mBatchCountBuffer;
+	GLsizeiptr mBatchCountBufferSize;
+	GLuint mVisibleBuffer;
+	GLsizeiptr mVisibleBufferSize;
+
+	// Occluded counters written by the GPU, read once the fence of their frame has signalled
+	GLuint mStatsBuffers[STATS_FRAMES];
+	GLsync mStatsFences[STATS_FRAMES];     // 0 when the slot holds no unread counter
+	unsigned int mStatsTested[STATS_FRAMES];
+	unsigned int mFrame;
+	unsigned int mOccludedCount;
+	unsigned int mTestedCount;
+};
@@ -0,0 +1,1035 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.cpp
+// ========
+// sorted list of the draws submitted each frame
+///////////////////////////////////////////////////////////////////////////////
+
+#include "renderqueue.h"
+
+#include <cstring>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "glstate.h"
+
+namespace
+{
+	// Sort key layout, most significant field first:
+	//	[63:56] program  [55:44] VAO  [43:32] texture  [31:20] material  [19:0] submission order
+	// In the mesh arena, where every object shares the VAO, the VAO field holds the draw shape.
+	const int PROGRAM_SHIFT = 56;
+	const int VAO_SHIFT = 44;
+	const int TEXTURE_SHIFT = 32;
+	const int MATERIAL_SHIFT = 20;
+
+	const uint64_t PROGRAM_MASK = 0xFF;
+	const uint64_t SLOT_MASK = 0xFFF;
+	const uint64_t ORDER_MASK = 0xFFFFF;
+
+	// Marks "no state bound yet" while submitting
+	const unsigned int NO_SLOT = 0xFFFFFFFF;
+	const glm::vec4 NO_UV_SCALE(0.0f);
+
+	// Objects per slice handed to a worker, a slice costs tens of microseconds
+	const size_t PARALLEL_GRAIN = 1024;
+
+	uint64_t MakeKey(unsigned int program, unsigned int vao, unsigned int texture, unsigned int material, size_t order)
+	{
+		uint64_t key = 0;
+		key |= ((uint64_t)program & PROGRAM_MASK) << PROGRAM_SHIFT;
+		key |= ((uint64_t)vao & SLOT_MASK) << VAO_SHIFT;
+		key |= ((uint64_t)texture & SLOT_MASK) << TEXTURE_SHIFT;
+		key |= ((uint64_t)material & SLOT_MASK) << MATERIAL_SHIFT;
+		key |= (uint64_t)order & ORDER_MASK;
+		return key;
+	}
+
+	unsigned int MaterialSlotOf(uint64_t key)
+	{
+		return (unsigned int)((key >> MATERIAL_SHIFT) & SLOT_MASK);
+	}
+
+	bool SameRange(const DrawRange& a, const DrawRange& b)
+	{
+		return a.mode == b.mode && a.first == b.first && a.count == b.count && a.indexed == b.indexed;
+	}
+
+	bool SameDrawRanges(const SceneObject& a, const SceneObject& b)
+	{
+		if (a.mesh != b.mesh || a.nRanges != b.nRanges)
+			return false;
+		for (int i = 0; i < a.nRanges; ++i)
+		{
+			if (!SameRange(a.ranges[i], b.ranges[i]))
+				return false;
+		}
+		return true;
+	}
+
+	bool SameMaterial(const Material& a, const Material& b)
+	{
+		return a.objectColor == b.objectColor
+			&& a.hasTexture == b.hasTexture
+			&& a.specularIntensity1 == b.specularIntensity1
+			&& a.highlightSize1 == b.highlightSize1
+			&& a.specularIntensity2 == b.specularIntensity2
+			&& a.highlightSize2 == b.highlightSize2;
+	}
+}
+
+RenderQueue::RenderQueue()
+	: mPool(nullptr), mRing(nullptr), mDrawIdBuffer(0), mDrawIdCount(0), mIndirectOffset(0),
+	mArenaVao(0), mMultiDrawIndirect(false), mTextureTarget(GL_TEXTURE_2D_ARRAY), mInstancedProgram(0), mDepthProgram(0),
+	mDepthUniforms(nullptr), mInstancedDepthProgram(0), mDepthPrePass(false), mOcclusion(nullptr), mProfiler(nullptr)
+{
+	mStats = RenderStats();
+}
+
+///////////////////////////////////////////////////
+//	SetInstancedProgram(GLuint)
+//
+//	program: shader built from the instanced vertex
+//	shader, reading model matrices and materials
+//	from the object buffer
+///////////////////////////////////////////////////
+void RenderQueue::SetInstancedProgram(GLuint program)
+{
+	mInstancedProgram = program;
+}
+
+///////////////////////////////////////////////////
+//	SetDepthPrograms(GLuint, const UniformLayout*, GLuint)
+//
+//	program: depth-only version of the scene program,
+//	reading the model matrix from its uniform
+//	uniforms: locations of program
+//	instancedProgram: depth-only version of the
+//	instanced program, reading the object buffer
+///////////////////////////////////////////////////
+void RenderQueue::SetDepthPrograms(GLuint program, const UniformLayout* uniforms, GLuint instancedProgram)
+{
+	mDepthProgram = program;
+	mDepthUniforms = uniforms;
+	mInstancedDepthProgram = instancedProgram;
+}
+
+///////////////////////////////////////////////////
+//	CreateBuffers()
+//
+//	Create the draw ID buffer, that only grows with
+//	the scene. Object entries and indirect commands
+//	are refilled every frame in the ring buffer.
+///////////////////////////////////////////////////
+void RenderQueue::CreateBuffers()
+{
+	glGenBuffers(1, &mDrawIdBuffer);
+	mDrawIdCount = 0;
+}
+
+///////////////////////////////////////////////////
+//	DestroyBuffers()
+//
+//	Release the draw ID buffer
+///////////////////////////////////////////////////
+void RenderQueue::DestroyBuffers()
+{
+	glDeleteBuffers(1, &mDrawIdBuffer);
+	mDrawIdBuffer = 0;
+	mDrawIdCount = 0;
+}
+
+///////////////////////////////////////////////////
+//	GetFrameBytes(size_t)
+//
+//	One ObjectData per object, and at most one
+//	indirect command per draw range of each
+///////////////////////////////////////////////////
+GLsizeiptr RenderQueue::GetFrameBytes(size_t objects)
+{
+	return (GLsizeiptr)(objects * (sizeof(ObjectData) + MAX_DRAW_RANGES * sizeof(IndirectCommand)));
+}
+
+///////////////////////////////////////////////////
+//	SetMeshArena(GLuint)
+//
+//	vao: arena VAO holding every mesh, with the
+//	draw ID attribute attached. Enables the
+//	multi-draw indirect path.
+///////////////////////////////////////////////////
+void RenderQueue::SetMeshArena(GLuint vao)
+{
+	mArenaVao = vao;
+	mMultiDrawIndirect = (vao != 0);
+}
+
+///////////////////////////////////////////////////
+//	AttachDrawIdAttribute(GLuint)
+//
+//	vao: mesh VAO that will be drawn instanced
+//
+//	GL 4.4 has no gl_DrawID or gl_BaseInstance in the
+//	core profile. An attribute advancing once per
+//	instance over the sequence 0, 1, 2, ... is read at
+//	baseInstance + gl_InstanceID, which is exactly the
+//	object buffer entry of the instance.
+///////////////////////////////////////////////////
+void RenderQueue::AttachDrawIdAttribute(GLuint vao)
+{
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, mDrawIdBuffer);
+
+	glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), 0);
+	glEnableVertexAttribArray(3);
+	glVertexAttribDivisor(3, 1);
+
+	glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////
+//	Clear()
+//
+//	Empty the queue and reset the frame counters
+///////////////////////////////////////////////////
+void RenderQueue::Clear()
+{
+	mItems.clear();
+	mStats = RenderStats();
+}
+
+///////////////////////////////////////////////////
+//	Push(const SceneObject&, const mat4&, GLuint, const UniformLayout&)
+//
+//	object: scene entry to draw this frame
+//	model: world matrix of the object
+//	program: shader program used to draw it
+//	uniforms: cached locations of that program
+///////////////////////////////////////////////////
+void RenderQueue::Push(const SceneObject& object, const glm::mat4& model, GLuint program, const UniformLayout& uniforms)
+{
+	const uint64_t key = MakeKey(GetSlot(mProgramSlots, program), GetVaoSlot(object),
+		GetSlot(mTextureSlots, object.texture), GetMaterialSlot(object.material), mItems.size());
+
+	RenderItem item = { key, &object, &model, program, &uniforms };
+	mItems.push_back(item);
+}
+
+///////////////////////////////////////////////////
+//	PushScene(const vector<SceneObject>&, const vector<unsigned char>&, const SceneGraph&, GLuint, const UniformLayout&)
+//
+//	scene: scene table
+//	visible: one flag per scene entry, 1 when drawn
+//	graph: hierarchy holding the world matrices
+//	program: shader program used to draw them
+//	uniforms: cached locations of that program
+//
+//	The items keep their scene index as submission
+//	order, so the sorted queue does not depend on
+//	which worker built which slice
+///////////////////////////////////////////////////
+void RenderQueue::PushScene(const std::vector<SceneObject>& scene, const std::vector<unsigned char>& visible, const SceneGraph& graph,
+	GLuint program, const UniformLayout& uniforms)
+{
+	if (mPool == nullptr)
+	{
+		for (size_t i = 0; i < scene.size(); ++i)
+		{
+			if (visible[i])
+				Push(scene[i], graph.GetWorldMatrix(scene[i].node), program, uniforms);
+		}
+		return;
+	}
+
+	const unsigned int programSlot = GetSlot(mProgramSlots, program);
+	mPackets.resize(WorkerPool::GetChunkCount(scene.size(), PARALLEL_GRAIN));
+
+	mPool->ParallelFor(scene.size(), PARALLEL_GRAIN, [&](size_t begin, size_t end, size_t chunk)
+	{
+		Packet& packet = mPackets[chunk];
+		packet.items.clear();
+		packet.missingSlot = false;
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (!visible[i])
+				continue;
+
+			const SceneObject& object = scene[i];
+			const unsigned int vao = FindVaoSlot(object);
+			const unsigned int texture = FindSlot(mTextureSlots, object.texture);
+			const unsigned int material = FindMaterialSlot(object.material);
+			if (vao == NO_SLOT || texture == NO_SLOT || material == NO_SLOT)
+				packet.missingSlot = true;
+
+			RenderItem item = { MakeKey(programSlot, vao, texture, material, i), &object, &graph.GetWorldMatrix(object.node), program, &uniforms };
+			packet.items.push_back(item);
+		}
+	});
+
+	// Merge in slice order, adding the slots the workers could not
+	for (size_t c = 0; c < mPackets.size(); ++c)
+	{
+		Packet& packet = mPackets[c];
+		if (packet.missingSlot)
+		{
+			for (RenderItem& item : packet.items)
+			{
+				const SceneObject& object = *item.object;
+				item.key = MakeKey(programSlot, GetVaoSlot(object), GetSlot(mTextureSlots, object.texture),
+					GetMaterialSlot(object.material), (size_t)(item.key & ORDER_MASK));
+			}
+		}
+		mItems.insert(mItems.end(), packet.items.begin(), packet.items.end());
+	}
+}
+
+///////////////////////////////////////////////////
+//	Sort()
+//
+//	Least significant digit radix sort, one byte per
+//	pass. Passes where every key has the same byte
+//	are skipped, which is most of them for small
+//	scenes. The state changes of the unsorted order
+//	are counted first so both can be reported.
+///////////////////////////////////////////////////
+void RenderQueue::Sort()
+{
+	const size_t count = mItems.size();
+
+	// Count the binds submission order would have needed
+	GLuint vao = 0;
+	GLuint texture = 0;
+	unsigned int material = NO_SLOT;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const RenderItem& item = mItems[i];
+		if (item.object->mesh->vao != vao)
+		{
+			vao = item.object->mesh->vao;
+			++mStats.unsortedVaoBinds;
+		}
+		if (item.object->texture != texture)
+		{
+			texture = item.object->texture;
+			++mStats.unsortedTextureBinds;
+		}
+		if (MaterialSlotOf(item.key) != material)
+		{
+			material = MaterialSlotOf(item.key);
+			++mStats.unsortedMaterialUpdates;
+		}
+	}
+
+	if (count < 2)
+		return;
+
+	mScratch.resize(count);
+	RenderItem* src = mItems.data();
+	RenderItem* dst = mScratch.data();
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t histogram[256] = { 0 };
+		for (size_t i = 0; i < count; ++i)
+			++histogram[(src[i].key >> shift) & 0xFF];
+
+		// Every key shares this byte, the pass would not move anything
+		if (histogram[(src[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		size_t offset = 0;
+		for (int b = 0; b < 256; ++b)
+		{
+			size_t n = histogram[b];
+			histogram[b] = offset;
+			offset += n;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+			dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+		RenderItem* swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	// An odd number of passes leaves the result in the scratch buffer
+	if (src != mItems.data())
+		mItems.swap(mScratch);
+}
+
+///////////////////////////////////////////////////
+//	RemoveHidden(const vector<unsigned char>&, const SceneObject*)
+//
+//	hidden: one flag per scene entry, 1 when hidden
+//	first: scene entry the flags start at
+//
+//	Returns the number of items removed
+///////////////////////////////////////////////////
+size_t RenderQueue::RemoveHidden(const std::vector<unsigned char>& hidden, const SceneObject* first)
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < mItems.size(); ++i)
+	{
+		const size_t index = (size_t)(mItems[i].object - first);
+		if (index < hidden.size() && hidden[index])
+			continue;
+		mItems[kept++] = mItems[i];
+	}
+
+	const size_t removed = mItems.size() - kept;
+	mItems.resize(kept);
+	return removed;
+}
+
+///////////////////////////////////////////////////
+//	Submit()
+//
+//	Walk the sorted items and change program, VAO,
+//	texture and material only when the next batch
+//	needs a different one. With the pre-pass, the
+//	walk runs twice over the same batches and
+//	commands, the occlusion test only once.
+///////////////////////////////////////////////////
+void RenderQueue::Submit()
+{
+	BuildBatches();
+	BuildMultiDraws();
+
+	// One write covers every instanced batch of the frame
+	if (mInstancedProgram != 0)
+		WriteObjectData();
+
+	// Bindings the queue needs between its batches. The state cache drops the
+	// first binds of the frame too when last frame ended with the same ones.
+	BoundState state = { 0, 0, 0, NO_SLOT, -1, NO_UV_SCALE };
+
+	// Commands of both passes, shrunk to the objects the Hi-Z test left
+	const bool multiDraws = UploadMultiDraws();
+
+	const bool depthPrePass = UseDepthPrePass();
+	if (depthPrePass)
+	{
+		if (mProfiler)
+			mProfiler->BeginScope("depth pre-pass");
+		GLState().ColorMask(GL_FALSE);
+		GLState().DepthMask(GL_TRUE);
+		GLState().DepthFunc(GL_LESS);
+		if (multiDraws)
+			SubmitMultiDraws(state, true);
+		SubmitBatches(state, true);
+		if (mProfiler)
+			mProfiler->EndScope();
+
+		// Only the fragments that won the pre-pass are shaded, depth is already final
+		GLState().ColorMask(GL_TRUE);
+		GLState().DepthMask(GL_FALSE);
+		GLState().DepthFunc(GL_EQUAL);
+	}
+
+	// Arena batches go first, in as few calls as the textures allow
+	if (multiDraws)
+		SubmitMultiDraws(state, false);
+	SubmitBatches(state, false);
+
+	// Back to the state the clear and next frame expect
+	if (depthPrePass)
+	{
+		GLState().DepthMask(GL_TRUE);
+		GLState().DepthFunc(GL_LESS);
+	}
+}
+
+///////////////////////////////////////////////////
+//	SubmitBatches(BoundState&, bool)
+//
+//	Draw the batches that are not arena batches.
+//	depthOnly draws them with the depth programs,
+//	without textures, materials or profiler scopes.
+///////////////////////////////////////////////////
+void RenderQueue::SubmitBatches(BoundState& state, bool depthOnly)
+{
+	for (size_t b = 0; b < mBatches.size(); ++b)
+	{
+		const Batch& batch = mBatches[b];
+		const RenderItem& item = mItems[batch.begin];
+		const SceneObject& object = *item.object;
+		const GLsizei instances = (GLsizei)(batch.end - batch.begin);
+
+		if (batch.indirect)
+			continue;
+
+		if (depthOnly)
+		{
+			unsigned int drawCalls;
+			if (mInstancedProgram != 0)
+			{
+				BindProgram(state, mInstancedDepthProgram);
+				BindVertexArray(state, object.mesh->vao);
+				drawCalls = DrawRangesInstanced(object, instances, batch.baseInstance);
+			}
+			else
+			{
+				BindProgram(state, mDepthProgram);
+				BindVertexArray(state, object.mesh->vao);
+				glUniformMatrix4fv(mDepthUniforms->model, 1, GL_FALSE, glm::value_ptr(*item.model));
+				drawCalls = DrawRanges(object);
+			}
+			mStats.drawCalls += drawCalls;
+			mStats.depthDrawCalls += drawCalls;
+			continue;
+		}
+
+		if (mProfiler)
+			mProfiler->BeginScope(object.name);
+
+		if (mInstancedProgram != 0)
+		{
+			BindProgram(state, mInstancedProgram);
+			BindMeshAndTexture(state, object);
+
+			// Model and material come from the object buffer, indexed per instance
+			const unsigned int drawCalls = DrawRangesInstanced(object, instances, batch.baseInstance);
+			mStats.drawCalls += drawCalls;
+			mStats.instancedDraws += drawCalls;
+			mStats.instances += instances;
+			mStats.objects += instances;
+			if (mProfiler)
+				mProfiler->EndScope();
+			continue;
+		}
+
+		BindProgram(state, item.program);
+		BindMeshAndTexture(state, object);
+
+		if (MaterialSlotOf(item.key) != state.material)
+		{
+			state.material = MaterialSlotOf(item.key);
+			SetMaterialUniforms(object.material, *item.uniforms);
+			++mStats.materialUpdates;
+		}
+
+		if (object.textureLayer != state.textureLayer)
+		{
+			state.textureLayer = object.textureLayer;
+			glUniform1i(item.uniforms->uTextureLayer, object.textureLayer);
+		}
+		if (object.uvScale != state.uvScale)
+		{
+			state.uvScale = object.uvScale;
+			glUniform4fv(item.uniforms->uvScale, 1, glm::value_ptr(object.uvScale));
+		}
+
+		glUniformMatrix4fv(item.uniforms->model, 1, GL_FALSE, glm::value_ptr(*item.model));
+
+		mStats.drawCalls += DrawRanges(object);
+		++mStats.objects;
+
+		if (mProfiler)
+			mProfiler->EndScope();
+	}
+}
+
+///////////////////////////////////////////////////
+//	BuildBatches()
+//
+//	Split the sorted items into instanced runs. An
+//	instanced draw of a single object costs no more
+//	than a plain one, so without the instanced
+//	program every item is its own batch.
+///////////////////////////////////////////////////
+void RenderQueue::BuildBatches()
+{
+	mBatches.clear();
+
+	const bool instanced = mInstancedProgram != 0;
+	const bool arena = UseMeshArena();
+
+	size_t i = 0;
+	while (i < mItems.size())
+	{
+		size_t end = i + 1;
+		if (instanced)
+		{
+			while (end < mItems.size() && CanInstance(mItems[i], mItems[end]))
+				++end;
+		}
+
+		Batch batch = { i, end, (GLuint)i, arena };
+		mBatches.push_back(batch);
+		i = end;
+	}
+}
+
+///////////////////////////////////////////////////
+//	WriteObjectData()
+//
+//	Write one ObjectData per sorted item into the
+//	ring buffer and bind them to the ObjectBlock.
+//	The region was released by its fence, so no
+//	draw of an earlier frame still reads it.
+///////////////////////////////////////////////////
+void RenderQueue::WriteObjectData()
+{
+	const size_t count = mItems.size();
+	if (count == 0)
+		return;
+
+	ReserveDrawIds(count);
+
+	const GLsizeiptr bytes = sizeof(ObjectData) * count;
+	GLintptr offset;
+	ObjectData* objects = (ObjectData*)mRing->Allocate(bytes, offset);
+	if (objects == nullptr)
+		return;
+
+	auto write = [this, objects](size_t begin, size_t end, size_t)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			const SceneObject& object = *mItems[i].object;
+			const Material& material = object.material;
+			objects[i].model = *mItems[i].model;
+			objects[i].specular = glm::vec4(material.specularIntensity1, material.highlightSize1, material.specularIntensity2, material.highlightSize2);
+			objects[i].color = glm::vec4(material.objectColor.x, material.objectColor.y, material.objectColor.z, material.hasTexture ? (float)object.textureLayer : -1.0f);
+			objects[i].uvScale = object.uvScale;
+			objects[i].boundsMin = glm::vec4(object.mesh->boundsMin, 1.0f);
+			objects[i].boundsMax = glm::vec4(object.mesh->boundsMax, 1.0f);
+		}
+	};
+
+	// The mapping is plain memory, workers can fill their slices of it
+	if (mPool)
+		mPool->ParallelFor(count, PARALLEL_GRAIN, write);
+	else
+		write(0, count, 0);
+
+	GLState().BindBufferRange(GL_SHADER_STORAGE_BUFFER, OBJECT_BLOCK_BINDING, mRing->GetBuffer(), offset, bytes);
+
+	// Every instance draws its own entry unless the occlusion pass replaces this
+	GLState().BindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BLOCK_BINDING, mDrawIdBuffer);
+}
+
+///////////////////////////////////////////////////
+//	ReserveDrawIds(size_t)
+//
+//	Grow the draw ID sequence to at least count
+//	entries. The VAOs reference the buffer by name,
+//	so reallocating it keeps them valid.
+///////////////////////////////////////////////////
+void RenderQueue::ReserveDrawIds(size_t count)
+{
+	if (count <= mDrawIdCount)
+		return;
+
+	size_t capacity = mDrawIdCount > 0 ? mDrawIdCount : 256;
+	while (capacity < count)
+		capacity *= 2;
+
+	std::vector<GLuint> ids(capacity);
+	for (size_t i = 0; i < capacity; ++i)
+		ids[i] = (GLuint)i;
+
+	GLState().BindBuffer(GL_ARRAY_BUFFER, mDrawIdBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint) * capacity, ids.data(), GL_STATIC_DRAW);
+	mDrawIdCount = capacity;
+}
+
+///////////////////////////////////////////////////
+//	BuildMultiDraws()
+//
+//	Turn every arena batch into one indirect command
+//	per draw range. The batches are sorted by texture,
+//	so each run of one texture is split by primitive
+//	mode and becomes one multi-draw per mode.
+///////////////////////////////////////////////////
+void RenderQueue::BuildMultiDraws()
+{
+	mCommands.clear();
+	mMultiDraws.clear();
+	mCommandBatches.clear();
+
+	size_t b = 0;
+	while (b < mBatches.size())
+	{
+		if (!mBatches[b].indirect)
+		{
+			++b;
+			continue;
+		}
+
+		// Run of arena batches bound to the same texture
+		const GLuint texture = mItems[mBatches[b].begin].object->texture;
+		size_t end = b + 1;
+		while (end < mBatches.size() && mBatches[end].indirect && mItems[mBatches[end].begin].object->texture == texture)
+			++end;
+
+		// Objects use at most a few primitive modes, take them one at a time
+		GLenum modes[MAX_DRAW_RANGES * 4];
+		int nModes = 0;
+		for (size_t k = b; k < end; ++k)
+		{
+			const SceneObject& object = *mItems[mBatches[k].begin].object;
+			for (int r = 0; r < object.nRanges; ++r)
+			{
+				int m = 0;
+				while (m < nModes && modes[m] != object.ranges[r].mode)
+					++m;
+				if (m == nModes && nModes < (int)(sizeof(modes) / sizeof(modes[0])))
+					modes[nModes++] = object.ranges[r].mode;
+			}
+		}
+
+		for (int m = 0; m < nModes; ++m)
+		{
+			MultiDraw draw = { modes[m], texture, mCommands.size(), 0 };
+			for (size_t k = b; k < end; ++k)
+			{
+				const Batch& batch = mBatches[k];
+				const SceneObject& object = *mItems[batch.begin].object;
+				for (int r = 0; r < object.nRanges; ++r)
+				{
+					const DrawRange& range = object.ranges[r];
+					if (range.mode != modes[m])
+						continue;
+
+					// Non-indexed meshes were given sequential indices in the arena
+					IndirectCommand command;
+					command.count = (GLuint)range.count;
+					command.instanceCount = (GLuint)(batch.end - batch.begin);
+					command.firstIndex = object.mesh->firstIndex + (GLuint)range.first;
+					command.baseVertex = object.mesh->baseVertex;
+					command.baseInstance = batch.baseInstance;
+					mCommands.push_back(command);
+					mCommandBatches.push_back((GLuint)k);
+					++draw.commandCount;
+				}
+			}
+			mMultiDraws.push_back(draw);
+		}
+
+		b = end;
+	}
+}
+
+///////////////////////////////////////////////////
+//	UploadMultiDraws()
+//
+//	Copy the commands built for this frame into the
+//	ring buffer and run the occlusion test on them.
+//	False when there is nothing to draw from the
+//	arena.
+///////////////////////////////////////////////////
+bool RenderQueue::UploadMultiDraws()
+{
+	if (mMultiDraws.empty())
+		return false;
+
+	const GLsizeiptr bytes = sizeof(IndirectCommand) * mCommands.size();
+	void* commands = mRing->Allocate(bytes, mIndirectOffset);
+	if (commands == nullptr)
+		return false;
+	memcpy(commands, mCommands.data(), bytes);
+	GLState().BindBuffer(GL_DRAW_INDIRECT_BUFFER, mRing->GetBuffer());
+
+	if (mProfiler)
+		mProfiler->BeginScope("occlusion test");
+	CullMultiDraws();
+	if (mProfiler)
+		mProfiler->EndScope();
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	SubmitMultiDraws(BoundState&, bool)
+//
+//	Issue the uploaded commands from the arena VAO.
+//	depthOnly draws them with the instanced depth
+//	program and skips the texture binds.
+///////////////////////////////////////////////////
+void RenderQueue::SubmitMultiDraws(BoundState& state, bool depthOnly)
+{
+	if (mProfiler && !depthOnly)
+		mProfiler->BeginScope("multi-draws");
+
+	BindProgram(state, depthOnly ? mInstancedDepthProgram : mInstancedProgram);
+	BindVertexArray(state, mArenaVao);
+
+	for (size_t d = 0; d < mMultiDraws.size(); ++d)
+	{
+		const MultiDraw& draw = mMultiDraws[d];
+		if (!depthOnly && draw.texture != state.texture)
+		{
+			state.texture = draw.texture;
+			GLState().BindTexture(0, mTextureTarget, state.texture);
+			++mStats.textureBinds;
+		}
+
+		glMultiDrawElementsIndirect(draw.mode, GL_UNSIGNED_INT, (void*)(mIndirectOffset + sizeof(IndirectCommand) * draw.firstCommand), draw.commandCount, 0);
+		++mStats.drawCalls;
+		if (depthOnly)
+		{
+			++mStats.depthDrawCalls;
+			continue;
+		}
+		++mStats.multiDrawCalls;
+		mStats.indirectCommands += draw.commandCount;
+	}
+
+	if (depthOnly)
+		return;
+	if (mProfiler)
+		mProfiler->EndScope();
+
+	for (size_t b = 0; b < mBatches.size(); ++b)
+	{
+		if (mBatches[b].indirect)
+		{
+			const unsigned int instances = (unsigned int)(mBatches[b].end - mBatches[b].begin);
+			mStats.instances += instances;
+			mStats.objects += instances;
+		}
+	}
+}
+
+///////////////////////////////////////////////////
+//	CullMultiDraws()
+//
+//	Run the occlusion pass over the uploaded
+//	commands. Only multi-draws can skip objects
+//	without the CPU knowing the result, so every
+//	batch must be an arena batch here.
+///////////////////////////////////////////////////
+void RenderQueue::CullMultiDraws()
+{
+	if (mOcclusion == nullptr || !mOcclusion->IsReady())
+		return;
+
+	mItemBatches.resize(mItems.size() * 2);
+	for (size_t b = 0; b < mBatches.size(); ++b)
+	{
+		const Batch& batch = mBatches[b];
+		if (!batch.indirect)
+			return;
+
+		for (size_t i = batch.begin; i < batch.end; ++i)
+		{
+			mItemBatches[i * 2] = (GLuint)b;
+			mItemBatches[i * 2 + 1] = batch.baseInstance;
+		}
+	}
+
+	mOcclusion->CullCommands(mItemBatches, mCommandBatches, mBatches.size(), mRing->GetBuffer(), mIndirectOffset);
+}
+
+///////////////////////////////////////////////////
+//	GetVaoSlot(const SceneObject&)
+//	FindVaoSlot(const SceneObject&)
+//
+//	Every mesh shares one VAO when drawn from the
+//	arena. Keying on it would leave objects of
+//	different meshes or LOD levels in scene order
+//	inside a material and split the instanced runs.
+///////////////////////////////////////////////////
+unsigned int RenderQueue::GetVaoSlot(const SceneObject& object)
+{
+	return UseMeshArena() ? GetShapeSlot(object) : GetSlot(mVaoSlots, object.mesh->vao);
+}
+
+unsigned int RenderQueue::FindVaoSlot(const SceneObject& object) const
+{
+	return UseMeshArena() ? FindShapeSlot(object) : FindSlot(mVaoSlots, object.mesh->vao);
+}
+
+///////////////////////////////////////////////////
+//	UseMeshArena()
+//
+//	True when batches are drawn from the mesh arena
+///////////////////////////////////////////////////
+bool RenderQueue::UseMeshArena() const
+{
+	return mMultiDrawIndirect && mArenaVao != 0 && mInstancedProgram != 0;
+}
+
+///////////////////////////////////////////////////
+//	UseDepthPrePass()
+//
+//	True when the pre-pass is on and every program
+//	the batches may need has its depth version
+///////////////////////////////////////////////////
+bool RenderQueue::UseDepthPrePass() const
+{
+	if (!mDepthPrePass)
+		return false;
+	if (mInstancedProgram != 0)
+		return mInstancedDepthProgram != 0;
+	return mDepthProgram != 0 && mDepthUniforms != nullptr;
+}
+
+///////////////////////////////////////////////////
+//	CanInstance(const RenderItem&, const RenderItem&)
+//
+//	Items can share an instanced draw when they use
+//	the same program, mesh ranges and texture
+///////////////////////////////////////////////////
+bool RenderQueue::CanInstance(const RenderItem& first, const RenderItem& next) const
+{
+	return first.program == next.program
+		&& first.object->texture == next.object->texture
+		&& SameDrawRanges(*first.object, *next.object);
+}
+
+///////////////////////////////////////////////////
+//	BindProgram(BoundState&, GLuint)
+//
+//	Switch program if needed
+///////////////////////////////////////////////////
+void RenderQueue::BindProgram(BoundState& state, GLuint program)
+{
+	if (program != state.program)
+	{
+		state.program = program;
+		GLState().UseProgram(program);
+		++mStats.programBinds;
+
+		// Material uniforms belong to the program that was just bound
+		state.material = NO_SLOT;
+		state.textureLayer = -1;
+		state.uvScale = NO_UV_SCALE;
+	}
+}
+
+///////////////////////////////////////////////////
+//	BindVertexArray(BoundState&, GLuint)
+//
+//	Switch VAO if needed
+///////////////////////////////////////////////////
+void RenderQueue::BindVertexArray(BoundState& state, GLuint vao)
+{
+	if (vao != state.vao)
+	{
+		state.vao = vao;
+		GLState().BindVertexArray(state.vao);
+		++mStats.vaoBinds;
+	}
+}
+
+///////////////////////////////////////////////////
+//	BindMeshAndTexture(BoundState&, const SceneObject&)
+//
+//	Bind the VAO and texture of an object if needed
+///////////////////////////////////////////////////
+void RenderQueue::BindMeshAndTexture(BoundState& state, const SceneObject& object)
+{
+	BindVertexArray(state, object.mesh->vao);
+
+	if (object.texture != state.texture)
+	{
+		state.texture = object.texture;
+		GLState().BindTexture(0, mTextureTarget, state.texture);
+		++mStats.textureBinds;
+	}
+}
+
+///////////////////////////////////////////////////
+//	GetSlot(std::vector<GLuint>&, GLuint)
+//
+//	Dense index of a GL name. Scenes only use a
+//	handful of programs, VAOs and textures, so a
+//	linear search is cheaper than a map.
+///////////////////////////////////////////////////
+unsigned int RenderQueue::GetSlot(std::vector<GLuint>& slots, GLuint name)
+{
+	for (size_t i = 0; i < slots.size(); ++i)
+	{
+		if (slots[i] == name)
+			return (unsigned int)i;
+	}
+	slots.push_back(name);
+	return (unsigned int)(slots.size() - 1);
+}
+
+///////////////////////////////////////////////////
+//	GetMaterialSlot(const Material&)
+//
+//	Dense index of a distinct material value
+///////////////////////////////////////////////////
+unsigned int RenderQueue::GetMaterialSlot(const Material& material)
+{
+	for (size_t i = 0; i < mMaterialSlots.size(); ++i)
+	{
+		if (SameMaterial(mMaterialSlots[i], material))
+			return (unsigned int)i;
+	}
+	mMaterialSlots.push_back(material);
+	return (unsigned int)(mMaterialSlots.size() - 1);
+}
+
+///////////////////////////////////////////////////
+//	GetShapeSlot(const SceneObject&)
+//
+//	Dense index of a distinct mesh and draw ranges.
+//	Each LOD level is a mesh of its own.
+///////////////////////////////////////////////////
+unsigned int RenderQueue::GetShapeSlot(const SceneObject& object)
+{
+	const unsigned int slot = FindShapeSlot(object);
+	if (slot != NO_SLOT)
+		return slot;
+
+	DrawShape shape;
+	shape.mesh = object.mesh;
+	shape.nRanges = object.nRanges;
+	for (int r = 0; r < object.nRanges; ++r)
+		shape.ranges[r] = object.ranges[r];
+	mShapeSlots.push_back(shape);
+	return (unsigned int)(mShapeSlots.size() - 1);
+}
+
+///////////////////////////////////////////////////
+//	FindSlot(const std::vector<GLuint>&, GLuint)
+//
+//	Dense index of a GL name already given a slot
+///////////////////////////////////////////////////
+unsigned int RenderQueue::FindSlot(const std::vector<GLuint>& slots, GLuint name)
+{
+	for (size_t i = 0; i < slots.size(); ++i)
+	{
+		if (slots[i] == name)
+			return (unsigned int)i;
+	}
+	return NO_SLOT;
+}
+
+///////////////////////////////////////////////////
+//	FindMaterialSlot(const Material&)
+//
+//	Dense index of a material already given a slot
+///////////////////////////////////////////////////
+unsigned int RenderQueue::FindMaterialSlot(const Material& material) const
+{
+	for (size_t i = 0; i < mMaterialSlots.size(); ++i)
+	{
+		if (SameMaterial(mMaterialSlots[i], material))
+			return (unsigned int)i;
+	}
+	return NO_SLOT;
+}
+
+///////////////////////////////////////////////////
+//	FindShapeSlot(const SceneObject&)
+///////////////////////////////////////////////////
+unsigned int RenderQueue::FindShapeSlot(const SceneObject& object) const
+{
+	for (size_t i = 0; i < mShapeSlots.size(); ++i)
+	{
+		const DrawShape& shape = mShapeSlots[i];
+		if (shape.mesh != object.mesh || shape.nRanges != object.nRanges)
+			continue;
+
+		int r = 0;
+		while (r < shape.nRanges && SameRange(shape.ranges[r], object.ranges[r]))
+			++r;
+		if (r == shape.nRanges)
+			return (unsigned int)i;
+	}
+	return NO_SLOT;
+}
@@ -0,0 +1,281 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.h
+// ========
+// sorted list of the draws submitted each frame
+//
+//	Every object pushed on the queue gets a 64-bit sort key built from its
+//	program, VAO, texture and material. The queue is radix sorted so that
+//	objects sharing state end up next to each other, then submitted with
+//	only the state changes that are actually needed. Runs of objects that
+//	share mesh, draw ranges and texture are drawn with a single instanced
+//	call when an instanced program has been registered. That program reads
+//	the model matrix and material of each instance from the ObjectBlock
+//	storage buffer, so a draw costs one ObjectData write and no uniforms.
+//	The object entries and the indirect commands of a frame are written
+//	into the frame's region of the ring buffer (see ringbuffer.h).
+//
+//	When a mesh arena is registered, the instanced runs are instead written
+//	as indirect commands and drawn with one glMultiDrawElementsIndirect per
+//	texture and primitive mode. With an occlusion culler attached, the
+//	commands are first tested against last frame's Hi-Z pyramid on the GPU
+//	and their instance counts shrunk to the objects left visible. As every
+//	mesh then shares the arena VAO, the VAO field of the key holds the draw
+//	shape instead (mesh and index ranges, so one per LOD level), keeping
+//	identical draws adjacent so they still merge into one command.
+//
+//	With a worker pool set, PushScene builds the items of the visible
+//	objects in parallel: each worker fills the packet of the slice of the
+//	scene it took, looking up the state slots read-only, and the render
+//	thread merges the packets in scene order. Slices that met a program,
+//	VAO, texture or material not seen before are re-keyed during the merge,
+//	which only happens the first frames. The object entries are written
+//	into the ring buffer by the workers too. Everything that touches GL
+//	still runs on the render thread.
+//
+//	With the depth pre-pass on, every batch is first drawn by depth-only
+//	programs with color writes off, then drawn again with the Phong
+//	programs and the depth test set to GL_EQUAL. Each pixel then runs the
+//	lighting once, for the surface left in front, instead of once per
+//	surface drawn over it. The vertex work is paid twice, so the pass only
+//	pays off where the scene overlaps itself on screen. Both programs
+//	declare gl_Position invariant, so the depths they compute match.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "gpuprofiler.h"
+#include "occlusion.h"
+#include "ringbuffer.h"
+#include "scene.h"
+#include "scenegraph.h"
+#include "shaderblocks.h"
+#include "uniforms.h"
+#include "workerpool.h"
+
+// Per-frame counters of the state changes issued by the queue
+struct RenderStats
+{
+	unsigned int objects;           // Objects submitted
+	unsigned int drawCalls;         // glDraw* calls issued
+	unsigned int programBinds;      // glUseProgram calls
+	unsigned int vaoBinds;          // glBindVertexArray calls
+	unsigned int textureBinds;      // glBindTexture calls
+	unsigned int materialUpdates;   // Material uniform uploads of the non-instanced program
+	unsigned int instancedDraws;    // glDraw*Instanced calls issued
+	unsigned int instances;         // Objects drawn through instanced calls
+	unsigned int multiDrawCalls;    // glMultiDrawElementsIndirect calls issued
+	unsigned int indirectCommands;  // Draw commands read by those calls
+	unsigned int depthDrawCalls;    // Draw calls of the depth pre-pass, counted in drawCalls only
+
+	// The same counters had the queue been submitted in scene order
+	unsigned int unsortedVaoBinds;
+	unsigned int unsortedTextureBinds;
+	unsigned int unsortedMaterialUpdates;
+};
+
+// One entry of the render queue
+struct RenderItem
+{
+	uint64_t key;
+	const SceneObject* object;
+	const glm::mat4* model;         // World matrix, valid until the frame is submitted
+	GLuint program;
+	const UniformLayout* uniforms;
+};
+
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	// Program used for runs of identical objects
+	void SetInstancedProgram(GLuint program);
+
+	// Target of the object textures, GL_TEXTURE_2D_ARRAY unless the scene uses plain 2D textures
+	void SetTextureTarget(GLenum target) { mTextureTarget = target; }
+
+	// Draw ID attribute buffer, the per-frame data goes to the ring buffer
+	void CreateBuffers();
+	void DestroyBuffers();
+
+	// Ring buffer receiving the object entries and indirect commands, must be set before Submit
+	void SetRingBuffer(RingBuffer* ring) { mRing = ring; }
+
+	// Ring buffer bytes one frame may take for a scene of objects entries
+	static GLsizeiptr GetFrameBytes(size_t objects);
+
+	// VAO of the shared mesh arena, drawn with multi-draw indirect while enabled
+	void SetMeshArena(GLuint vao);
+	void SetMultiDrawIndirect(bool enabled) { mMultiDrawIndirect = enabled; }
+	bool GetMultiDrawIndirect() const { return mMultiDrawIndirect; }
+
+	// Depth-only programs matching the scene program and the instanced one, which
+	// run the pre-pass while enabled. uniforms are the locations of program.
+	void SetDepthPrograms(GLuint program, const UniformLayout* uniforms, GLuint instancedProgram);
+	void SetDepthPrePass(bool enabled) { mDepthPrePass = enabled; }
+	bool GetDepthPrePass() const { return mDepthPrePass; }
+
+	// Hi-Z test applied to the multi-draw commands, null to draw them all
+	void SetOcclusionCuller(OcclusionCuller* culler) { mOcclusion = culler; }
+
+	// Time every batch, under the name of its first object, and the multi-draws
+	void SetProfiler(GpuProfiler* profiler) { mProfiler = profiler; }
+
+	// Threads building the items and object entries, null to build them on the render thread
+	void SetWorkerPool(WorkerPool* pool) { mPool = pool; }
+	WorkerPool* GetWorkerPool() const { return mPool; }
+
+	// Add the per-instance draw ID attribute (location 3) to a mesh VAO
+	void AttachDrawIdAttribute(GLuint vao);
+
+	// Remove every item, keeping the allocated storage
+	void Clear();
+
+	// Add an object drawn at the given world matrix with the given program
+	void Push(const SceneObject& object, const glm::mat4& model, GLuint program, const UniformLayout& uniforms);
+
+	// Push every scene entry flagged visible, at its world matrix in graph
+	void PushScene(const std::vector<SceneObject>& scene, const std::vector<unsigned char>& visible, const SceneGraph& graph,
+		GLuint program, const UniformLayout& uniforms);
+
+	// Radix sort the items by key
+	void Sort();
+
+	// Drop the items whose scene entry is flagged, counting from first.
+	// The order of the rest is kept, so a sorted queue stays sorted.
+	size_t RemoveHidden(const std::vector<unsigned char>& hidden, const SceneObject* first);
+
+	// Issue the draws, skipping redundant program/VAO/texture/material changes
+	void Submit();
+
+	const RenderStats& GetStats() const { return mStats; }
+
+private:
+	// Contiguous items drawn with one instanced call, or a single item.
+	// Item i of the sorted queue is entry i of the object buffer.
+	struct Batch
+	{
+		size_t begin;
+		size_t end;
+		GLuint baseInstance;
+		bool indirect;      // Drawn from the mesh arena by a multi-draw
+	};
+
+	// Command layout read by glMultiDrawElementsIndirect
+	struct IndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// Consecutive commands sharing texture and primitive mode
+	struct MultiDraw
+	{
+		GLenum mode;
+		GLuint texture;
+		size_t firstCommand;
+		GLsizei commandCount;
+	};
+
+	// Items built by one slice of the scene during PushScene
+	struct Packet
+	{
+		std::vector<RenderItem> items;
+		bool missingSlot;           // Some key holds NO_SLOT, re-keyed during the merge
+	};
+
+	// Mesh and draw ranges of an object, shared by the items of an instanced run
+	struct DrawShape
+	{
+		const Meshes::GLMesh* mesh;
+		DrawRange ranges[MAX_DRAW_RANGES];
+		int nRanges;
+	};
+
+	// State bound by the last submitted batch
+	struct BoundState
+	{
+		GLuint program;
+		GLuint vao;
+		GLuint texture;
+		unsigned int material;
+		int textureLayer;           // uTextureLayer of the non-instanced program
+		glm::vec4 uvScale;          // uvScale of the non-instanced program
+	};
+
+	void BuildBatches();
+	void WriteObjectData();
+	void ReserveDrawIds(size_t count);
+	void BuildMultiDraws();
+	bool UploadMultiDraws();
+	void SubmitMultiDraws(BoundState& state, bool depthOnly);
+	void SubmitBatches(BoundState& state, bool depthOnly);
+	void CullMultiDraws();
+	bool UseDepthPrePass() const;
+	bool UseMeshArena() const;
+	bool CanInstance(const RenderItem& first, const RenderItem& next) const;
+	void BindProgram(BoundState& state, GLuint program);
+	void BindVertexArray(BoundState& state, GLuint vao);
+	void BindMeshAndTexture(BoundState& state, const SceneObject& object);
+
+	// Small dense id for a GL name, material or draw shape, used inside the sort key
+	unsigned int GetSlot(std::vector<GLuint>& slots, GLuint name);
+	unsigned int GetMaterialSlot(const Material& material);
+	unsigned int GetShapeSlot(const SceneObject& object);
+
+	// Same lookups without adding anything, safe from the workers. NO_SLOT when not found.
+	static unsigned int FindSlot(const std::vector<GLuint>& slots, GLuint name);
+	unsigned int FindMaterialSlot(const Material& material) const;
+	unsigned int FindShapeSlot(const SceneObject& object) const;
+
+	// VAO field of the key: the object's VAO, or its draw shape when every
+	// mesh shares the arena VAO, so identical draws still end up adjacent
+	unsigned int GetVaoSlot(const SceneObject& object);
+	unsigned int FindVaoSlot(const SceneObject& object) const;
+
+	std::vector<RenderItem> mItems;
+	std::vector<RenderItem> mScratch;   // Radix sort ping-pong buffer
+	std::vector<Packet> mPackets;       // One per slice of the scene, kept between frames
+	WorkerPool* mPool;
+
+	std::vector<GLuint> mProgramSlots;
+	std::vector<GLuint> mVaoSlots;
+	std::vector<GLuint> mTextureSlots;
+	std::vector<Material> mMaterialSlots;
+	std::vector<DrawShape> mShapeSlots;
+
+	std::vector<Batch> mBatches;
+	RingBuffer* mRing;              // ObjectData, one per item, and indirect commands of the frame
+	GLuint mDrawIdBuffer;           // Vertex buffer holding 0, 1, 2, ... read once per instance
+	size_t mDrawIdCount;
+
+	std::vector<IndirectCommand> mCommands;
+	std::vector<MultiDraw> mMultiDraws;
+	std::vector<GLuint> mCommandBatches;    // Batch of every command, for the occlusion pass
+	std::vector<GLuint> mItemBatches;       // Batch and its first item, for every item
+	GLintptr mIndirectOffset;               // Commands of the frame in the ring buffer
+
+	GLuint mArenaVao;
+	bool mMultiDrawIndirect;
+	GLenum mTextureTarget;
+
+	GLuint mInstancedProgram;
+	GLuint mDepthProgram;
+	const UniformLayout* mDepthUniforms;
+	GLuint mInstancedDepthProgram;
+	bool mDepthPrePass;
+	OcclusionCuller* mOcclusion;
+	GpuProfiler* mProfiler;
+
+	RenderStats mStats;
+};
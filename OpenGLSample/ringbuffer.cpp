@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////////
+// ringbuffer.cpp
+// ========
+// persistently mapped buffer holding the data written every frame
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ringbuffer.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	// Longest single wait on a fence before trying again, in nanoseconds
+	const GLuint64 FENCE_TIMEOUT = 1000000000;
+}
+
+RingBuffer::RingBuffer()
+	: mBuffer(0), mData(nullptr), mRegionBytes(0), mAlignment(1), mRegion(0), mHead(0),
+	mWaitCount(0), mFullReported(false)
+{
+	for (int i = 0; i < FRAMES; ++i)
+		mFences[i] = 0;
+}
+
+///////////////////////////////////////////////////
+//	Create(GLsizeiptr, int)
+//
+//	frameBytes: data written by one frame
+//	allocationsPerFrame: Allocate calls of a frame,
+//	each may skip up to one alignment
+///////////////////////////////////////////////////
+bool RingBuffer::Create(GLsizeiptr frameBytes, int allocationsPerFrame)
+{
+	GLint uniformAlignment = 1, storageAlignment = 1;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+	mAlignment = std::max(std::max(uniformAlignment, storageAlignment), 4);
+
+	// Regions start aligned too
+	mRegionBytes = frameBytes + mAlignment * allocationsPerFrame;
+	mRegionBytes = (mRegionBytes + mAlignment - 1) / mAlignment * mAlignment;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &mBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, mRegionBytes * FRAMES, nullptr, flags);
+	mData = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, mRegionBytes * FRAMES, flags);
+	if (mData == nullptr)
+	{
+		std::cout << "ERROR::RING_BUFFER::MAP_FAILED" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	mRegion = FRAMES - 1;
+	mHead = 0;
+	mWaitCount = 0;
+	mFullReported = false;
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	Destroy()
+//
+//	Deleting a mapped buffer unmaps it
+///////////////////////////////////////////////////
+void RingBuffer::Destroy()
+{
+	for (int i = 0; i < FRAMES; ++i)
+	{
+		if (mFences[i] != 0)
+			glDeleteSync(mFences[i]);
+		mFences[i] = 0;
+	}
+	glDeleteBuffers(1, &mBuffer);
+	mBuffer = 0;
+	mData = nullptr;
+}
+
+///////////////////////////////////////////////////
+//	BeginFrame()
+//
+//	A fence not yet signaled means the CPU got
+//	FRAMES frames ahead, the wait is counted
+///////////////////////////////////////////////////
+void RingBuffer::BeginFrame()
+{
+	mRegion = (mRegion + 1) % FRAMES;
+	mHead = 0;
+
+	GLsync& fence = mFences[mRegion];
+	if (fence == 0)
+		return;
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		++mWaitCount;
+		do
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+		while (status == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(fence);
+	fence = 0;
+}
+
+///////////////////////////////////////////////////
+//	EndFrame()
+///////////////////////////////////////////////////
+void RingBuffer::EndFrame()
+{
+	if (mBuffer == 0)
+		return;
+	if (mFences[mRegion] != 0)
+		glDeleteSync(mFences[mRegion]);
+	mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+///////////////////////////////////////////////////
+//	Allocate(GLsizeiptr, GLintptr&)
+//
+//	bytes: size of the data to write
+//	offset: receives the offset of the data in the
+//	buffer, for binds and indirect draws
+//
+//	A full region is reported once, the region was
+//	sized too small for the scene in Create
+///////////////////////////////////////////////////
+void* RingBuffer::Allocate(GLsizeiptr bytes, GLintptr& offset)
+{
+	const GLsizeiptr start = (mHead + mAlignment - 1) / mAlignment * mAlignment;
+	if (mData == nullptr || start + bytes > mRegionBytes)
+	{
+		if (!mFullReported)
+			std::cout << "ERROR::RING_BUFFER::FRAME_FULL " << bytes << " bytes asked, " << mRegionBytes - mHead << " left" << std::endl;
+		mFullReported = true;
+		return nullptr;
+	}
+
+	mHead = start + bytes;
+	offset = mRegion * mRegionBytes + start;
+	return mData + offset;
+}
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// ringbuffer.h
+// ========
+// persistently mapped buffer holding the data written every frame
+//
+//	The buffer is allocated once with glBufferStorage and stays mapped, so
+//	per-frame data (the frame block, the object entries and the indirect
+//	commands) is written with plain stores and no upload call the driver
+//	could serialize on. The mapping is coherent, the GPU sees the writes
+//	without a flush.
+//
+//	The buffer is split into FRAMES regions used in turn. EndFrame places a
+//	fence after the last command of the frame, and BeginFrame only hands out
+//	a region once the fence of the frame that last used it has signaled.
+//	The CPU can so be up to FRAMES - 1 frames ahead of the GPU without ever
+//	writing over data still being read.
+//
+//	Inside its region a frame bump-allocates. Every allocation starts on
+//	the uniform and storage buffer offset alignment, so it can be bound
+//	with glBindBufferRange or used as an indirect command offset.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+class RingBuffer
+{
+public:
+	static const int FRAMES = 3;
+
+	RingBuffer();
+
+	// Map FRAMES regions of frameBytes, plus the alignment padding of allocationsPerFrame allocations
+	bool Create(GLsizeiptr frameBytes, int allocationsPerFrame);
+	void Destroy();
+
+	// Wait for the GPU to be done with the next region and start allocating in it
+	void BeginFrame();
+
+	// Fence the commands issued since BeginFrame
+	void EndFrame();
+
+	// Room for bytes in the region of the frame: the address to write, and
+	// its offset in GetBuffer(). Null when the region is full.
+	void* Allocate(GLsizeiptr bytes, GLintptr& offset);
+
+	GLuint GetBuffer() const { return mBuffer; }
+
+	// Bytes allocated by the current frame, and region size
+	GLsizeiptr GetUsedBytes() const { return mHead; }
+	GLsizeiptr GetRegionBytes() const { return mRegionBytes; }
+
+	// Frames that found their region still in use by the GPU, since Create
+	unsigned int GetWaitCount() const { return mWaitCount; }
+
+private:
+	GLuint mBuffer;
+	unsigned char* mData;           // Persistent mapping of the whole buffer
+	GLsizeiptr mRegionBytes;
+	GLsizeiptr mAlignment;
+	int mRegion;                    // Region of the current frame
+	GLsizeiptr mHead;               // Next free byte of the region
+	GLsync mFences[FRAMES];         // Last frame that used each region, 0 when none
+	unsigned int mWaitCount;
+	bool mFullReported;
+};
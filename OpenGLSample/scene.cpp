@@ -0,0 +1,266 @@
+///////////////////////////////////////////////////////////////////////////////
+// scene.cpp
+// ========
+// data-driven description of the objects drawn each frame
+///////////////////////////////////////////////////////////////////////////////
+
+#include "scene.h"
+
+#include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+///////////////////////////////////////////////////
+//	MakeSceneObject(const char*, const GLMesh&, GLuint, int, const Material&, int)
+//
+//	Create a scene entry without any draw ranges
+///////////////////////////////////////////////////
+SceneObject MakeSceneObject(const char* name, const Meshes::GLMesh& mesh, GLuint texture, int textureLayer, const Material& material, int node)
+{
+	SceneObject object;
+	object.name = name;
+	object.mesh = &mesh;
+	object.nRanges = 0;
+	object.texture = texture;
+	object.textureLayer = textureLayer;
+	object.uvScale = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+	object.material = material;
+	object.node = node;
+	object.occluderScale = glm::vec3(0.0f);
+	object.lod = nullptr;
+	object.lodLevel = 0;
+	return object;
+}
+
+///////////////////////////////////////////////////
+//	AddDrawRange(SceneObject&, const DrawRange&)
+//
+//	Append one draw call to an object
+///////////////////////////////////////////////////
+void AddDrawRange(SceneObject& object, const DrawRange& range)
+{
+	if (object.nRanges < MAX_DRAW_RANGES)
+		object.ranges[object.nRanges++] = range;
+}
+
+///////////////////////////////////////////////////
+//	SetOccluder(SceneObject&, vec3)
+//
+//	solidScale: share of the mesh box, per axis,
+//	that is entirely inside the object. 1 for box
+//	meshes, less for round ones.
+///////////////////////////////////////////////////
+void SetOccluder(SceneObject& object, glm::vec3 solidScale)
+{
+	object.occluderScale = solidScale;
+}
+
+///////////////////////////////////////////////////
+//	SetTextureRegion(SceneObject&, vec4)
+//
+//	uvRect: scale in xy and offset in zw of the
+//	region, becomes the uvScale the shaders apply
+//	to the mesh UVs
+///////////////////////////////////////////////////
+void SetTextureRegion(SceneObject& object, glm::vec4 uvRect)
+{
+	object.uvScale = uvRect;
+}
+
+///////////////////////////////////////////////////
+//	SetMeshLod(SceneObject&, const GLMeshLod&)
+//
+//	Match every draw range to the part of level 0
+//	it starts at. The ranges are kept as they are
+//	for level 0, so full detail draws exactly what
+//	the object was described with.
+///////////////////////////////////////////////////
+void SetMeshLod(SceneObject& object, const Meshes::GLMeshLod& lod)
+{
+	if (object.mesh != lod.levels[0])
+		return;
+
+	for (int r = 0; r < object.nRanges; ++r)
+	{
+		int part = 0;
+		while (part < lod.nParts && lod.partFirst[0][part] != object.ranges[r].first)
+			++part;
+		if (part == lod.nParts)
+			return;
+
+		object.lodParts[r] = part;
+		object.baseRanges[r] = object.ranges[r];
+	}
+
+	object.lod = &lod;
+	object.lodLevel = 0;
+}
+
+///////////////////////////////////////////////////
+//	SetLodLevel(SceneObject&, int)
+//
+//	Swap the mesh and the draw ranges of an object
+//	for the same parts of another level
+///////////////////////////////////////////////////
+void SetLodLevel(SceneObject& object, int level)
+{
+	if (!object.lod || level == object.lodLevel)
+		return;
+
+	const Meshes::GLMeshLod& lod = *object.lod;
+	object.mesh = lod.levels[level];
+	for (int r = 0; r < object.nRanges; ++r)
+	{
+		object.ranges[r] = object.baseRanges[r];
+		if (level > 0)
+		{
+			object.ranges[r].first = lod.partFirst[level][object.lodParts[r]];
+			object.ranges[r].count = lod.partCount[level][object.lodParts[r]];
+		}
+	}
+	object.lodLevel = level;
+}
+
+///////////////////////////////////////////////////
+//	ArraysRange(GLenum, GLint, GLsizei)
+//
+//	Draw range submitted with glDrawArrays
+///////////////////////////////////////////////////
+DrawRange ArraysRange(GLenum mode, GLint first, GLsizei count)
+{
+	DrawRange range = { mode, first, count, false };
+	return range;
+}
+
+///////////////////////////////////////////////////
+//	ElementsRange(GLenum, GLint, GLsizei)
+//
+//	Draw range submitted with glDrawElements
+///////////////////////////////////////////////////
+DrawRange ElementsRange(GLenum mode, GLint first, GLsizei count)
+{
+	DrawRange range = { mode, first, count, true };
+	return range;
+}
+
+///////////////////////////////////////////////////
+//	MakeMaterial(float, float, float, float)
+//
+//	Textured material with per-light specular values
+///////////////////////////////////////////////////
+Material MakeMaterial(float specularIntensity1, float highlightSize1, float specularIntensity2, float highlightSize2)
+{
+	Material material;
+	material.objectColor = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+	material.hasTexture = true;
+	material.specularIntensity1 = specularIntensity1;
+	material.highlightSize1 = highlightSize1;
+	material.specularIntensity2 = specularIntensity2;
+	material.highlightSize2 = highlightSize2;
+	return material;
+}
+
+///////////////////////////////////////////////////
+//	MakeTransform(vec3, float, vec3, vec3)
+//
+//	Build a transform from its components
+///////////////////////////////////////////////////
+Transform MakeTransform(glm::vec3 scale, float rotationAngle, glm::vec3 rotationAxis, glm::vec3 position)
+{
+	Transform transform;
+	transform.scale = scale;
+	transform.rotationAngle = rotationAngle;
+	transform.rotationAxis = rotationAxis;
+	transform.position = position;
+	transform.model = glm::mat4(1.0f);
+	transform.dirty = true;
+	return transform;
+}
+
+///////////////////////////////////////////////////
+//	ComputeModelMatrix(const Transform&)
+//
+//	Same result as translation * rotation * scale,
+//	written out: the rotation columns are scaled and
+//	the translation fills the last column. Most
+//	objects are not rotated, which skips the rotation.
+///////////////////////////////////////////////////
+glm::mat4 ComputeModelMatrix(const Transform& transform)
+{
+	glm::mat4 model(1.0f);
+	if (transform.rotationAngle != 0.0f)
+		model = glm::rotate(transform.rotationAngle, transform.rotationAxis);
+
+	model[0] *= transform.scale.x;
+	model[1] *= transform.scale.y;
+	model[2] *= transform.scale.z;
+	model[3] = glm::vec4(transform.position, 1.0f);
+	return model;
+}
+
+///////////////////////////////////////////////////
+//	SetTransform(Transform&, vec3, float, vec3, vec3)
+//
+//	Only way objects should move after creation,
+//	so the cached matrix is never stale
+///////////////////////////////////////////////////
+void SetTransform(Transform& transform, glm::vec3 scale, float rotationAngle, glm::vec3 rotationAxis, glm::vec3 position)
+{
+	transform.scale = scale;
+	transform.rotationAngle = rotationAngle;
+	transform.rotationAxis = rotationAxis;
+	transform.position = position;
+	transform.dirty = true;
+}
+
+///////////////////////////////////////////////////
+//	SetMaterialUniforms(const Material&, const UniformLayout&)
+//
+//	material: surface parameters of the object
+//	uniforms: cached locations of the active program
+///////////////////////////////////////////////////
+void SetMaterialUniforms(const Material& material, const UniformLayout& uniforms)
+{
+	glUniform1i(uniforms.ubHasTexture, material.hasTexture);
+	glUniform4fv(uniforms.objectColor, 1, glm::value_ptr(material.objectColor));
+	glUniform1f(uniforms.specularIntensity1, material.specularIntensity1);
+	glUniform1f(uniforms.specularIntensity2, material.specularIntensity2);
+	glUniform1f(uniforms.highlightSize1, material.highlightSize1);
+	glUniform1f(uniforms.highlightSize2, material.highlightSize2);
+}
+
+///////////////////////////////////////////////////
+//	DrawRanges(const SceneObject&)
+//
+//	Expects the VAO of the object's mesh to be bound
+///////////////////////////////////////////////////
+unsigned int DrawRanges(const SceneObject& object)
+{
+	for (int i = 0; i < object.nRanges; ++i)
+	{
+		const DrawRange& range = object.ranges[i];
+		if (range.indexed)
+			glDrawElements(range.mode, range.count, GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * range.first));
+		else
+			glDrawArrays(range.mode, range.first, range.count);
+	}
+	return (unsigned int)object.nRanges;
+}
+
+///////////////////////////////////////////////////
+//	DrawRangesInstanced(const SceneObject&, GLsizei, GLuint)
+//
+//	Expects the VAO of the object's mesh to be bound
+//	with the instance attributes attached
+///////////////////////////////////////////////////
+unsigned int DrawRangesInstanced(const SceneObject& object, GLsizei instances, GLuint baseInstance)
+{
+	for (int i = 0; i < object.nRanges; ++i)
+	{
+		const DrawRange& range = object.ranges[i];
+		if (range.indexed)
+			glDrawElementsInstancedBaseInstance(range.mode, range.count, GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * range.first), instances, baseInstance);
+		else
+			glDrawArraysInstancedBaseInstance(range.mode, range.first, range.count, instances, baseInstance);
+	}
+	return (unsigned int)object.nRanges;
+}
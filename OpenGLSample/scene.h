@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+// scene.h
+// ========
+// data-driven description of the objects drawn each frame
+//
+//	Every object in the scene is one SceneObject entry. Render() walks the
+//	table in order, so adding an object means adding a row, not a new block
+//	of bind/transform/uniform/draw code. Each object is placed by a node of
+//	the SceneGraph (see scenegraph.h), which owns its transform.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "meshes.h"
+#include "uniforms.h"
+
+// Maximum number of draw calls used to render a single object
+const int MAX_DRAW_RANGES = 3;
+
+// A contiguous range of a mesh submitted with one glDraw* call
+struct DrawRange
+{
+	GLenum mode;        // Primitive type (GL_TRIANGLES, GL_TRIANGLE_FAN, ...)
+	GLint first;        // First vertex, or first index for indexed meshes
+	GLsizei count;      // Number of vertices or indices
+	bool indexed;       // glDrawElements instead of glDrawArrays
+};
+
+// Surface parameters consumed by the Phong fragment shader
+struct Material
+{
+	glm::vec4 objectColor;
+	bool hasTexture;
+	float specularIntensity1;
+	float highlightSize1;
+	float specularIntensity2;
+	float highlightSize2;
+};
+
+// Scale, rotation (angle in radians about an axis) and translation, with
+// the model matrix they produce. The matrix is only rebuilt after a change.
+struct Transform
+{
+	glm::vec3 scale;
+	float rotationAngle;
+	glm::vec3 rotationAxis;
+	glm::vec3 position;
+
+	glm::mat4 model;    // Valid while dirty is false
+	bool dirty;         // Set by MakeTransform and SetTransform
+};
+
+// One drawable entry of the scene table
+struct SceneObject
+{
+	const char* name;
+	const Meshes::GLMesh* mesh;
+	DrawRange ranges[MAX_DRAW_RANGES];
+	int nRanges;
+	GLuint texture;     // GL_TEXTURE_2D_ARRAY sampled by the shaders
+	int textureLayer;   // Layer of texture holding the image of the object
+	glm::vec4 uvScale;  // UV scale in xy and offset in zw, the whole layer unless set by SetTextureRegion
+	Material material;
+	int node;           // SceneGraph node holding the world matrix
+
+	// Part of the mesh box, around its center, that is solid and hides
+	// what is behind it. Zero for objects that are not occluders.
+	glm::vec3 occluderScale;
+
+	// Detail levels of the mesh, null when the object always draws mesh.
+	// mesh and ranges hold level lodLevel, baseRanges keep level 0.
+	const Meshes::GLMeshLod* lod;
+	int lodLevel;
+	int lodParts[MAX_DRAW_RANGES];      // Part of the level table drawn by each range
+	DrawRange baseRanges[MAX_DRAW_RANGES];
+};
+
+// Helpers used to fill the scene table
+SceneObject MakeSceneObject(const char* name, const Meshes::GLMesh& mesh, GLuint texture, int textureLayer, const Material& material, int node);
+void AddDrawRange(SceneObject& object, const DrawRange& range);
+void SetOccluder(SceneObject& object, glm::vec3 solidScale);
+
+// Sample only part of the texture layer, such as an image of the label atlas (see textureatlas.h)
+void SetTextureRegion(SceneObject& object, glm::vec4 uvRect);
+
+// Let an object switch between the levels of its mesh, call after the draw ranges are added.
+// Ranges that do not start at a part of level 0 leave the object at full detail.
+void SetMeshLod(SceneObject& object, const Meshes::GLMeshLod& lod);
+
+// Point mesh and ranges of an object at one of its levels
+void SetLodLevel(SceneObject& object, int level);
+DrawRange ArraysRange(GLenum mode, GLint first, GLsizei count);
+DrawRange ElementsRange(GLenum mode, GLint first, GLsizei count);
+Material MakeMaterial(float specularIntensity1, float highlightSize1, float specularIntensity2, float highlightSize2);
+Transform MakeTransform(glm::vec3 scale, float rotationAngle, glm::vec3 rotationAxis, glm::vec3 position);
+
+// Model matrix built as translation * rotation * scale
+glm::mat4 ComputeModelMatrix(const Transform& transform);
+
+// Replace the components of a transform and mark its matrix dirty
+void SetTransform(Transform& transform, glm::vec3 scale, float rotationAngle, glm::vec3 rotationAxis, glm::vec3 position);
+
+// Upload the material uniforms of the active program
+void SetMaterialUniforms(const Material& material, const UniformLayout& uniforms);
+
+// Issue every draw range of an object with its VAO bound, returns the number of draw calls
+unsigned int DrawRanges(const SceneObject& object);
+
+// Same as DrawRanges, drawing instances [baseInstance, baseInstance + instances) of the instance buffer
+unsigned int DrawRangesInstanced(const SceneObject& object, GLsizei instances, GLuint baseInstance);
@@ -0,0 +1,163 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenegraph.cpp
+// ========
+// parent/child hierarchy of the scene transforms
+///////////////////////////////////////////////////////////////////////////////
+
+#include "scenegraph.h"
+
+#include <atomic>
+#include <iostream>
+
+#include "workerpool.h"
+
+namespace
+{
+	// Nodes per slice of a parallel update
+	const size_t UPDATE_GRAIN = 1024;
+}
+
+SceneGraph::SceneGraph()
+	: mDirtyBegin(0), mDirtyEnd(0)
+{
+}
+
+///////////////////////////////////////////////////
+//	AddNode(int, const Transform&)
+//
+//	parent: index of the parent node, or NO_PARENT
+//	local: transform relative to the parent
+//
+//	A valid parent is one whose subtree still ends
+//	at the end of the arrays. Anything else would
+//	break the depth-first order and returns -1.
+///////////////////////////////////////////////////
+int SceneGraph::AddNode(int parent, const Transform& local)
+{
+	const int node = (int)mParents.size();
+	if (parent != NO_PARENT && (parent < 0 || parent >= node || mSubtreeEnds[parent] != node))
+	{
+		std::cout << "ERROR::SCENE_GRAPH::NODE_NOT_DEPTH_FIRST: parent " << parent << std::endl;
+		return -1;
+	}
+
+	mParents.push_back(parent);
+	mSubtreeEnds.push_back(node + 1);
+	mLocals.push_back(local);
+	mLocals.back().dirty = true;
+	mWorlds.push_back(glm::mat4(1.0f));
+	mChanged.push_back(0);
+
+	// The new node extends the subtree of every ancestor
+	for (int ancestor = parent; ancestor != NO_PARENT; ancestor = mParents[ancestor])
+		mSubtreeEnds[ancestor] = node + 1;
+
+	if (mDirtyBegin == mDirtyEnd)
+		mDirtyBegin = node;
+	mDirtyEnd = node + 1;
+	return node;
+}
+
+///////////////////////////////////////////////////
+//	SetLocalTransform(int, vec3, float, vec3, vec3)
+//
+//	Mark the node dirty and widen the update range
+//	to cover its subtree
+///////////////////////////////////////////////////
+void SceneGraph::SetLocalTransform(int node, glm::vec3 scale, float rotationAngle, glm::vec3 rotationAxis, glm::vec3 position)
+{
+	SetTransform(mLocals[node], scale, rotationAngle, rotationAxis, position);
+
+	const size_t begin = (size_t)node;
+	const size_t end = (size_t)mSubtreeEnds[node];
+	if (mDirtyBegin == mDirtyEnd)
+	{
+		mDirtyBegin = begin;
+		mDirtyEnd = end;
+	}
+	else
+	{
+		if (begin < mDirtyBegin)
+			mDirtyBegin = begin;
+		if (end > mDirtyEnd)
+			mDirtyEnd = end;
+	}
+}
+
+///////////////////////////////////////////////////
+//	Update(WorkerPool*)
+//
+//	pool: threads sharing the propagation, null to
+//	run it here
+//
+//	Walking the range from its first node, root to
+//	root of the subtrees it holds, gives subtrees
+//	whose parents all lie before the range. They
+//	never read each other, so they are grouped into
+//	slices of about UPDATE_GRAIN nodes for the pool.
+///////////////////////////////////////////////////
+unsigned int SceneGraph::Update(WorkerPool* pool)
+{
+	const size_t begin = mDirtyBegin;
+	const size_t end = mDirtyEnd;
+	mDirtyBegin = 0;
+	mDirtyEnd = 0;
+
+	if (pool == nullptr || pool->GetThreadCount() == 1 || end - begin < 2 * UPDATE_GRAIN)
+		return UpdateRange(begin, end, begin);
+
+	mSliceStarts.clear();
+	mSliceStarts.push_back(begin);
+	for (size_t i = begin; i < end; i = (size_t)mSubtreeEnds[i])
+	{
+		if (i - mSliceStarts.back() >= UPDATE_GRAIN)
+			mSliceStarts.push_back(i);
+	}
+	mSliceStarts.push_back(end);
+
+	std::atomic<unsigned int> recomputed(0);
+	pool->ParallelFor(mSliceStarts.size() - 1, 1, [&](size_t first, size_t last, size_t)
+	{
+		for (size_t s = first; s < last; ++s)
+			recomputed += UpdateRange(mSliceStarts[s], mSliceStarts[s + 1], begin);
+	});
+	return recomputed;
+}
+
+///////////////////////////////////////////////////
+//	UpdateRange(size_t, size_t, size_t)
+//
+//	Parents come before their children, so a single
+//	forward pass sees every parent's new world matrix
+//	before its children need it. A node is rebuilt
+//	when its own transform is dirty or its parent was
+//	rebuilt in this pass. Nodes outside the dirty
+//	range are skipped without being read.
+///////////////////////////////////////////////////
+unsigned int SceneGraph::UpdateRange(size_t first, size_t last, size_t begin)
+{
+	unsigned int recomputed = 0;
+	for (size_t i = first; i < last; ++i)
+	{
+		const int parent = mParents[i];
+		const bool parentChanged = parent != NO_PARENT && (size_t)parent >= begin && mChanged[parent];
+
+		Transform& local = mLocals[i];
+		if (!local.dirty && !parentChanged)
+		{
+			mChanged[i] = 0;
+			continue;
+		}
+
+		if (local.dirty)
+		{
+			local.model = ComputeModelMatrix(local);
+			local.dirty = false;
+		}
+
+		mWorlds[i] = (parent == NO_PARENT) ? local.model : mWorlds[parent] * local.model;
+		mChanged[i] = 1;
+		++recomputed;
+	}
+	return recomputed;
+}
@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenegraph.h
+// ========
+// parent/child hierarchy of the scene transforms
+//
+//	Nodes are stored in flat arrays in depth-first order, so every parent
+//	comes before its children and a subtree is a contiguous index range.
+//	World matrices are propagated with one linear pass over the range of
+//	nodes that changed since the last update; the rest are not touched.
+//	Given a worker pool, the range is cut at the roots of its subtrees,
+//	which never read each other, and the slices are propagated in parallel.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+
+class WorkerPool;
+
+// Parent of the root nodes
+const int NO_PARENT = -1;
+
+class SceneGraph
+{
+public:
+	SceneGraph();
+
+	// Append a node and return its index. Nodes must be added depth first:
+	// the parent is NO_PARENT, the last added node or one of its ancestors.
+	int AddNode(int parent, const Transform& local);
+
+	// Move a node, which also moves its whole subtree on the next Update
+	void SetLocalTransform(int node, glm::vec3 scale, float rotationAngle, glm::vec3 rotationAxis, glm::vec3 position);
+	const Transform& GetLocalTransform(int node) const { return mLocals[node]; }
+
+	// World matrix as of the last Update
+	const glm::mat4& GetWorldMatrix(int node) const { return mWorlds[node]; }
+
+	// Recompute the world matrices of the dirty subtrees, returns the number recomputed
+	unsigned int Update(WorkerPool* pool = nullptr);
+
+	size_t GetNodeCount() const { return mParents.size(); }
+
+private:
+	// Propagate [first, last) of the update range starting at begin
+	unsigned int UpdateRange(size_t first, size_t last, size_t begin);
+
+	std::vector<int> mParents;
+	std::vector<int> mSubtreeEnds;          // One past the last descendant of each node
+	std::vector<Transform> mLocals;
+	std::vector<glm::mat4> mWorlds;
+	std::vector<unsigned char> mChanged;    // World matrix rewritten by the current Update
+
+	// Index range Update has to visit
+	size_t mDirtyBegin;
+	size_t mDirtyEnd;
+
+	std::vector<size_t> mSliceStarts;       // Parallel update slices, the last entry ends the range
+};
@@ -0,0 +1,26 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderblocks.cpp
+// ========
+// CPU mirrors of the buffer-backed blocks read by the scene shaders
+///////////////////////////////////////////////////////////////////////////////
+
+#include "shaderblocks.h"
+
+#include "glstate.h"
+
+///////////////////////////////////////////////////
+//	WriteFrameData(RingBuffer&, const FrameData&)
+//
+//	The binding point is global, so both programs
+//	read the same block without any per-program call
+///////////////////////////////////////////////////
+void WriteFrameData(RingBuffer& ring, const FrameData& frame)
+{
+	GLintptr offset;
+	FrameData* data = (FrameData*)ring.Allocate(sizeof(FrameData), offset);
+	if (data == nullptr)
+		return;
+
+	*data = frame;
+	GLState().BindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, ring.GetBuffer(), offset, sizeof(FrameData));
+}
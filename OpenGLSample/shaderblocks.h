@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderblocks.h
+// ========
+// CPU mirrors of the buffer-backed blocks read by the scene shaders
+//
+//	FrameData is the std140 uniform block shared by every program, written
+//	once per frame into the ring buffer (see ringbuffer.h). ObjectData is one std430 entry of the per-object storage
+//	buffer, indexed in the shaders through the VisibleBlock entry at the
+//	draw ID of the instance.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "ringbuffer.h"
+
+// Binding points declared with layout(binding = N) in the shaders
+const GLuint FRAME_BLOCK_BINDING = 0;
+const GLuint OBJECT_BLOCK_BINDING = 1;
+const GLuint VISIBLE_BLOCK_BINDING = 2;
+
+// uniform FrameBlock, std140: vec3 values are padded to vec4
+struct FrameData
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 light1Color;
+	glm::vec4 light1Position;
+	glm::vec4 light2Color;
+	glm::vec4 light2Position;
+	glm::vec4 viewPosition;
+	glm::vec4 ambient;          // rgb color, a strength
+};
+
+// buffer ObjectBlock entry, std430
+struct ObjectData
+{
+	glm::mat4 model;
+	glm::vec4 specular;         // specularIntensity1, highlightSize1, specularIntensity2, highlightSize2
+	glm::vec4 color;            // objectColor.rgb, texture layer or -1 without texture
+	glm::vec4 uvScale;          // UV scale in xy and offset in zw, see SceneObject::uvScale
+	glm::vec4 boundsMin;        // Mesh space box, read by the occlusion test
+	glm::vec4 boundsMax;
+};
+
+// Write the frame block into the frame's ring region and bind it to FRAME_BLOCK_BINDING
+void WriteFrameData(RingBuffer& ring, const FrameData& frame);
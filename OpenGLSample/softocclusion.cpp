@@ -0,0 +1,457 @@
+///////////////////////////////////////////////////////////////////////////////
+// softocclusion.cpp
+// ========
+// CPU occlusion culling against a small software depth buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#include "softocclusion.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Every x64 compiler provides SSE, x86 builds need /arch:SSE or -msse
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	// Corners of a box are numbered by bits: x = 1, y = 2, z = 4
+	const int BOX_TRIANGLES[12][3] = {
+		{ 0, 2, 6 }, { 0, 6, 4 },   // -x
+		{ 1, 5, 7 }, { 1, 7, 3 },   // +x
+		{ 0, 4, 5 }, { 0, 5, 1 },   // -y
+		{ 2, 3, 7 }, { 2, 7, 6 },   // +y
+		{ 0, 1, 3 }, { 0, 3, 2 },   // -z
+		{ 4, 6, 7 }, { 4, 7, 5 }    // +z
+	};
+
+	bool IsOccluder(const SceneObject& object)
+	{
+		return object.occluderScale.x > 0.0f || object.occluderScale.y > 0.0f || object.occluderScale.z > 0.0f;
+	}
+
+	// Clip space to buffer pixels, depth mapped to [0, 1] like the depth buffer
+	glm::vec3 ToScreen(const glm::vec4& clip)
+	{
+		const float inverseW = 1.0f / clip.w;
+		return glm::vec3((clip.x * inverseW * 0.5f + 0.5f) * SoftwareOcclusion::WIDTH,
+			(clip.y * inverseW * 0.5f + 0.5f) * SoftwareOcclusion::HEIGHT,
+			clip.z * inverseW * 0.5f + 0.5f);
+	}
+}
+
+SoftwareOcclusion::SoftwareOcclusion()
+	: mEnabled(true), mViewProjection(1.0f), mScene(nullptr), mGraph(nullptr), mBoundsMin(nullptr), mBoundsMax(nullptr),
+	mOccludedCount(0), mOccluderCount(0), mTriangleCount(0), mPending(false), mQuit(false)
+{
+	mDepth.resize(WIDTH * HEIGHT, 1.0f);
+	mTileDepth.resize((WIDTH / TILE_WIDTH) * (HEIGHT / TILE_HEIGHT), 1.0f);
+}
+
+SoftwareOcclusion::~SoftwareOcclusion()
+{
+	Stop();
+}
+
+///////////////////////////////////////////////////
+//	Start(const mat4&, const vector<SceneObject>&, const SceneGraph&, const vector<vec3>&, const vector<vec3>&)
+//
+//	viewProjection: matrix of the frame being built
+//	scene, graph: objects and their world matrices
+//	boundsMin, boundsMax: world box of every object
+//
+//	The worker is started on first use and then
+//	sleeps between frames
+///////////////////////////////////////////////////
+void SoftwareOcclusion::Start(const glm::mat4& viewProjection, const std::vector<SceneObject>& scene, const SceneGraph& graph,
+	const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax)
+{
+	if (!mThread.joinable())
+	{
+		mQuit = false;
+		mThread = std::thread(&SoftwareOcclusion::WorkerLoop, this);
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mViewProjection = viewProjection;
+	mScene = &scene;
+	mGraph = &graph;
+	mBoundsMin = &boundsMin;
+	mBoundsMax = &boundsMax;
+	mPending = true;
+	mWake.notify_one();
+}
+
+///////////////////////////////////////////////////
+//	Finish()
+//
+//	Block until the frame handed to Start is done
+///////////////////////////////////////////////////
+const std::vector<unsigned char>& SoftwareOcclusion::Finish()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [this] { return !mPending; });
+	return mOccluded;
+}
+
+///////////////////////////////////////////////////
+//	Stop()
+//
+//	Let the worker finish its frame, then join it
+///////////////////////////////////////////////////
+void SoftwareOcclusion::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWake.notify_all();
+
+	if (mThread.joinable())
+		mThread.join();
+}
+
+///////////////////////////////////////////////////
+//	WorkerLoop()
+//
+//	Body of the worker thread: one Run per Start
+///////////////////////////////////////////////////
+void SoftwareOcclusion::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	for (;;)
+	{
+		mWake.wait(lock, [this] { return mPending || mQuit; });
+		if (mQuit)
+			return;
+
+		lock.unlock();
+		Run();
+		lock.lock();
+
+		mPending = false;
+		mDone.notify_all();
+	}
+}
+
+///////////////////////////////////////////////////
+//	Run()
+//
+//	Clear the buffer, draw the occluders, then test
+//	the world box of every object. Occluders are
+//	tested too: a box is never hidden by its own
+//	solid part, which lies inside it.
+///////////////////////////////////////////////////
+void SoftwareOcclusion::Run()
+{
+	const std::vector<SceneObject>& scene = *mScene;
+
+	std::fill(mDepth.begin(), mDepth.end(), 1.0f);
+	mOccluderCount = 0;
+	mTriangleCount = 0;
+
+	for (size_t i = 0; i < scene.size(); ++i)
+	{
+		if (IsOccluder(scene[i]))
+		{
+			RasterizeOccluder(scene[i], mGraph->GetWorldMatrix(scene[i].node));
+			++mOccluderCount;
+		}
+	}
+
+	BuildTileDepths();
+
+	const size_t count = std::min(scene.size(), std::min(mBoundsMin->size(), mBoundsMax->size()));
+	mOccluded.assign(scene.size(), 0);
+	mOccludedCount = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (IsOccluded((*mBoundsMin)[i], (*mBoundsMax)[i]))
+		{
+			mOccluded[i] = 1;
+			++mOccludedCount;
+		}
+	}
+}
+
+///////////////////////////////////////////////////
+//	RasterizeOccluder(const SceneObject&, const mat4&)
+//
+//	Draw the solid box of an object: its mesh box
+//	scaled by occluderScale around the box center
+///////////////////////////////////////////////////
+void SoftwareOcclusion::RasterizeOccluder(const SceneObject& object, const glm::mat4& model)
+{
+	const glm::vec3 center = (object.mesh->boundsMin + object.mesh->boundsMax) * 0.5f;
+	const glm::vec3 halfSize = (object.mesh->boundsMax - object.mesh->boundsMin) * 0.5f * object.occluderScale;
+	const glm::mat4 mvp = mViewProjection * model;
+
+	glm::vec4 corners[8];
+	for (int c = 0; c < 8; ++c)
+	{
+		const glm::vec3 corner(center.x + ((c & 1) ? halfSize.x : -halfSize.x),
+			center.y + ((c & 2) ? halfSize.y : -halfSize.y),
+			center.z + ((c & 4) ? halfSize.z : -halfSize.z));
+		corners[c] = mvp * glm::vec4(corner, 1.0f);
+	}
+
+	for (int t = 0; t < 12; ++t)
+		RasterizeTriangle(corners[BOX_TRIANGLES[t][0]], corners[BOX_TRIANGLES[t][1]], corners[BOX_TRIANGLES[t][2]]);
+}
+
+///////////////////////////////////////////////////
+//	RasterizeTriangle(const vec4&, const vec4&, const vec4&)
+//
+//	Clip a clip-space triangle against the near
+//	plane (z >= -w) before it is projected. What is
+//	left is a triangle or a quad, drawn as a fan.
+///////////////////////////////////////////////////
+void SoftwareOcclusion::RasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+{
+	const glm::vec4 input[3] = { a, b, c };
+	float distance[3];
+	int inside = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		distance[i] = input[i].z + input[i].w;
+		if (distance[i] >= 0.0f)
+			++inside;
+	}
+
+	if (inside == 0)
+		return;
+
+	if (inside == 3)
+	{
+		RasterizeClipped(ToScreen(a), ToScreen(b), ToScreen(c));
+		return;
+	}
+
+	glm::vec3 polygon[4];
+	int nVertices = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		const int next = (i + 1) % 3;
+		if (distance[i] >= 0.0f)
+			polygon[nVertices++] = ToScreen(input[i]);
+		if ((distance[i] >= 0.0f) != (distance[next] >= 0.0f))
+		{
+			const float t = distance[i] / (distance[i] - distance[next]);
+			polygon[nVertices++] = ToScreen(input[i] + (input[next] - input[i]) * t);
+		}
+	}
+
+	for (int i = 1; i + 1 < nVertices; ++i)
+		RasterizeClipped(polygon[0], polygon[i], polygon[i + 1]);
+}
+
+///////////////////////////////////////////////////
+//	RasterizeClipped(const vec3&, const vec3&, const vec3&)
+//
+//	Pixel centers are tested against the three edge
+//	functions, four pixels of a row per step. The
+//	depth written is the largest the triangle plane
+//	reaches inside the pixel, capped by its farthest
+//	vertex, so it never claims to be nearer than it
+//	is. Both windings are drawn.
+///////////////////////////////////////////////////
+void SoftwareOcclusion::RasterizeClipped(const glm::vec3& v0, const glm::vec3& v1In, const glm::vec3& v2In)
+{
+	float area = (v1In.x - v0.x) * (v2In.y - v0.y) - (v1In.y - v0.y) * (v2In.x - v0.x);
+	if (std::fabs(area) < 1.0e-6f)
+		return;
+
+	// Counter-clockwise order keeps the inside of every edge positive
+	const glm::vec3& v1 = (area > 0.0f) ? v1In : v2In;
+	const glm::vec3& v2 = (area > 0.0f) ? v2In : v1In;
+	area = std::fabs(area);
+
+	const int minX = std::max(0, (int)std::ceil(std::min(v0.x, std::min(v1.x, v2.x)) - 0.5f));
+	const int maxX = std::min(WIDTH - 1, (int)std::floor(std::max(v0.x, std::max(v1.x, v2.x)) - 0.5f));
+	const int minY = std::max(0, (int)std::ceil(std::min(v0.y, std::min(v1.y, v2.y)) - 0.5f));
+	const int maxY = std::min(HEIGHT - 1, (int)std::floor(std::max(v0.y, std::max(v1.y, v2.y)) - 0.5f));
+	if (minX > maxX || minY > maxY)
+		return;
+
+	++mTriangleCount;
+
+	// Edge i runs from vertex i to vertex i + 1: e(x, y) = a * x + b * y + c
+	const glm::vec3 vertices[3] = { v0, v1, v2 };
+	float edgeA[3], edgeB[3], edgeC[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		const glm::vec3& from = vertices[i];
+		const glm::vec3& to = vertices[(i + 1) % 3];
+		edgeA[i] = from.y - to.y;
+		edgeB[i] = to.x - from.x;
+		edgeC[i] = -(edgeA[i] * from.x + edgeB[i] * from.y);
+	}
+
+	// Depth plane z(x, y) = zOrigin + dzdx * x + dzdy * y, moved to the far corner of each pixel
+	const float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+	const float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+	const float zOrigin = v0.z - dzdx * v0.x - dzdy * v0.y + 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+	const float zMax = std::max(v0.z, std::max(v1.z, v2.z));
+
+	// Rows are walked from a multiple of four, WIDTH is one too
+	const int startX = minX & ~3;
+
+#ifdef OCCLUSION_SSE
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 a0 = _mm_set1_ps(edgeA[0]);
+	const __m128 a1 = _mm_set1_ps(edgeA[1]);
+	const __m128 a2 = _mm_set1_ps(edgeA[2]);
+	const __m128 depthSlope = _mm_set1_ps(dzdx);
+	const __m128 depthMax = _mm_set1_ps(zMax);
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		const float centerY = y + 0.5f;
+		const __m128 rowE0 = _mm_set1_ps(edgeB[0] * centerY + edgeC[0]);
+		const __m128 rowE1 = _mm_set1_ps(edgeB[1] * centerY + edgeC[1]);
+		const __m128 rowE2 = _mm_set1_ps(edgeB[2] * centerY + edgeC[2]);
+		const __m128 rowZ = _mm_set1_ps(zOrigin + dzdy * centerY);
+		float* row = &mDepth[y * WIDTH];
+
+		for (int x = startX; x <= maxX; x += 4)
+		{
+			const __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+			__m128 covered = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, centerX), rowE0), zero);
+			covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, centerX), rowE1), zero));
+			covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, centerX), rowE2), zero));
+			if (_mm_movemask_ps(covered) == 0)
+				continue;
+
+			const __m128 depth = _mm_min_ps(_mm_add_ps(_mm_mul_ps(depthSlope, centerX), rowZ), depthMax);
+			const __m128 previous = _mm_loadu_ps(row + x);
+			const __m128 nearest = _mm_min_ps(previous, depth);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(covered, nearest), _mm_andnot_ps(covered, previous)));
+		}
+	}
+#else
+	for (int y = minY; y <= maxY; ++y)
+	{
+		const float centerY = y + 0.5f;
+		float* row = &mDepth[y * WIDTH];
+		for (int x = startX; x <= maxX; ++x)
+		{
+			const float centerX = x + 0.5f;
+			if (edgeA[0] * centerX + edgeB[0] * centerY + edgeC[0] < 0.0f
+				|| edgeA[1] * centerX + edgeB[1] * centerY + edgeC[1] < 0.0f
+				|| edgeA[2] * centerX + edgeB[2] * centerY + edgeC[2] < 0.0f)
+				continue;
+
+			const float depth = std::min(zOrigin + dzdx * centerX + dzdy * centerY, zMax);
+			row[x] = std::min(row[x], depth);
+		}
+	}
+#endif
+}
+
+///////////////////////////////////////////////////
+//	BuildTileDepths()
+//
+//	Farthest depth of every TILE_WIDTH x TILE_HEIGHT
+//	tile, two SSE registers per tile row
+///////////////////////////////////////////////////
+void SoftwareOcclusion::BuildTileDepths()
+{
+	const int tilesX = WIDTH / TILE_WIDTH;
+	const int tilesY = HEIGHT / TILE_HEIGHT;
+
+	for (int ty = 0; ty < tilesY; ++ty)
+	{
+		for (int tx = 0; tx < tilesX; ++tx)
+		{
+			const float* tile = &mDepth[ty * TILE_HEIGHT * WIDTH + tx * TILE_WIDTH];
+#ifdef OCCLUSION_SSE
+			__m128 farthest = _mm_loadu_ps(tile);
+			for (int y = 0; y < TILE_HEIGHT; ++y)
+			{
+				farthest = _mm_max_ps(farthest, _mm_loadu_ps(tile + y * WIDTH));
+				farthest = _mm_max_ps(farthest, _mm_loadu_ps(tile + y * WIDTH + 4));
+			}
+			farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+			farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+			mTileDepth[ty * tilesX + tx] = _mm_cvtss_f32(farthest);
+#else
+			float farthest = 0.0f;
+			for (int y = 0; y < TILE_HEIGHT; ++y)
+			{
+				for (int x = 0; x < TILE_WIDTH; ++x)
+					farthest = std::max(farthest, tile[y * WIDTH + x]);
+			}
+			mTileDepth[ty * tilesX + tx] = farthest;
+#endif
+		}
+	}
+}
+
+///////////////////////////////////////////////////
+//	IsOccluded(const vec3&, const vec3&)
+//
+//	A box is hidden when every pixel it may cover
+//	holds an occluder nearer than the nearest corner
+//	of the box. Tiles entirely nearer are accepted
+//	without reading their pixels. The rectangle is
+//	grown by a pixel because occluder coverage is
+//	sampled at pixel centers.
+///////////////////////////////////////////////////
+bool SoftwareOcclusion::IsOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	glm::vec3 screenMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	glm::vec3 screenMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int c = 0; c < 8; ++c)
+	{
+		const glm::vec4 corner((c & 1) ? boundsMax.x : boundsMin.x, (c & 2) ? boundsMax.y : boundsMin.y, (c & 4) ? boundsMax.z : boundsMin.z, 1.0f);
+		const glm::vec4 clip = mViewProjection * corner;
+
+		// Reaches the camera, nothing can be in front of it
+		if (clip.z < -clip.w)
+			return false;
+
+		const glm::vec3 screen = ToScreen(clip);
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+	}
+
+	// Outside the buffer, the frustum test decides
+	if (screenMax.x < 0.0f || screenMax.y < 0.0f || screenMin.x > WIDTH || screenMin.y > HEIGHT)
+		return false;
+
+	const float nearest = screenMin.z;
+	const int x0 = std::max(0, (int)std::floor(screenMin.x) - 1);
+	const int x1 = std::min(WIDTH - 1, (int)std::floor(screenMax.x) + 1);
+	const int y0 = std::max(0, (int)std::floor(screenMin.y) - 1);
+	const int y1 = std::min(HEIGHT - 1, (int)std::floor(screenMax.y) + 1);
+	const int tilesX = WIDTH / TILE_WIDTH;
+
+	for (int ty = y0 / TILE_HEIGHT; ty <= y1 / TILE_HEIGHT; ++ty)
+	{
+		for (int tx = x0 / TILE_WIDTH; tx <= x1 / TILE_WIDTH; ++tx)
+		{
+			if (mTileDepth[ty * tilesX + tx] < nearest)
+				continue;
+
+			// Some pixel of the tile is farther, look at the ones under the box
+			const int px0 = std::max(x0, tx * TILE_WIDTH);
+			const int px1 = std::min(x1, tx * TILE_WIDTH + TILE_WIDTH - 1);
+			const int py0 = std::max(y0, ty * TILE_HEIGHT);
+			const int py1 = std::min(y1, ty * TILE_HEIGHT + TILE_HEIGHT - 1);
+			for (int y = py0; y <= py1; ++y)
+			{
+				for (int x = px0; x <= px1; ++x)
+				{
+					if (mDepth[y * WIDTH + x] >= nearest)
+						return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+// softocclusion.h
+// ========
+// CPU occlusion culling against a small software depth buffer
+//
+//	The solid part of every occluder (see SceneObject::occluderScale) is
+//	rasterized as a box into a low resolution depth buffer, four pixels at
+//	a time with SSE. Coverage is sampled at pixel centers, so shared edges
+//	leave no cracks, and the depth written is the farthest the triangle
+//	reaches inside the pixel. Boxes are tested over their rectangle grown by
+//	one pixel to make up for the center sampling. Each tile of the buffer
+//	also keeps its farthest depth, so most pixels are never read.
+//
+//	The whole pass runs on a worker thread. Start hands it the frame, the
+//	render thread builds the queue meanwhile, and Finish waits for the
+//	flags. Nothing is read back from the GPU.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+#include "scenegraph.h"
+
+class SoftwareOcclusion
+{
+public:
+	// Depth buffer size in pixels, and tile size in pixels
+	static const int WIDTH = 320;
+	static const int HEIGHT = 180;
+	static const int TILE_WIDTH = 8;
+	static const int TILE_HEIGHT = 4;
+
+	SoftwareOcclusion();
+	~SoftwareOcclusion();
+
+	void SetEnabled(bool enabled) { mEnabled = enabled; }
+	bool GetEnabled() const { return mEnabled; }
+
+	// Rasterize the occluders and test every world box on the worker thread.
+	// The arguments must stay unchanged until Finish returns.
+	void Start(const glm::mat4& viewProjection, const std::vector<SceneObject>& scene, const SceneGraph& graph,
+		const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax);
+
+	// Wait for the worker, returns one flag per scene entry, 1 when hidden
+	const std::vector<unsigned char>& Finish();
+
+	// Join the worker thread
+	void Stop();
+
+	// Counters of the last finished frame
+	size_t GetOccludedCount() const { return mOccludedCount; }
+	size_t GetOccluderCount() const { return mOccluderCount; }
+	size_t GetTriangleCount() const { return mTriangleCount; }
+
+private:
+	void WorkerLoop();
+	void Run();
+	void RasterizeOccluder(const SceneObject& object, const glm::mat4& model);
+	void RasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+	void RasterizeClipped(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+	void BuildTileDepths();
+	bool IsOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+	bool mEnabled;
+
+	// Frame handed to the worker by Start
+	glm::mat4 mViewProjection;
+	const std::vector<SceneObject>* mScene;
+	const SceneGraph* mGraph;
+	const std::vector<glm::vec3>* mBoundsMin;
+	const std::vector<glm::vec3>* mBoundsMax;
+
+	std::vector<float> mDepth;          // WIDTH * HEIGHT, 1 is the far plane
+	std::vector<float> mTileDepth;      // Farthest depth of each tile
+	std::vector<unsigned char> mOccluded;
+
+	size_t mOccludedCount;
+	size_t mOccluderCount;
+	size_t mTriangleCount;
+
+	std::thread mThread;
+	std::mutex mMutex;
+	std::condition_variable mWake;      // Work pending or quit requested
+	std::condition_variable mDone;      // Work finished
+	bool mPending;
+	bool mQuit;
+};
@@ -0,0 +1,215 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearray.cpp
+// ========
+// scene textures loaded as the layers of one GL_TEXTURE_2D_ARRAY
+///////////////////////////////////////////////////////////////////////////////
+
+#include "texturearray.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "stb_image.h"
+#include "glstate.h"
+
+namespace
+{
+	const int CHANNELS = 4;
+
+	// Resample the lines of an image along one axis. Lines are count pixels
+	// of CHANNELS values, pixel i of line l at l * lineStride + i * pixelStride.
+	// Shrinking averages the source pixels under each target pixel, growing
+	// interpolates linearly between pixel centers.
+	void ResampleAxis(const std::vector<float>& source, int sourceCount, std::vector<float>& target, int targetCount,
+		int lines, int sourceLineStride, int targetLineStride, int sourcePixelStride, int targetPixelStride)
+	{
+		const float scale = (float)sourceCount / targetCount;
+		for (int l = 0; l < lines; ++l)
+		{
+			const float* in = &source[l * sourceLineStride];
+			float* out = &target[l * targetLineStride];
+			for (int i = 0; i < targetCount; ++i)
+			{
+				float sum[CHANNELS] = {};
+				if (scale > 1.0f)
+				{
+					// Pixels covered by [begin, end), the partial ones weighted by their cover
+					const float begin = i * scale;
+					const float end = begin + scale;
+					for (int s = (int)begin; s < sourceCount && s < end; ++s)
+					{
+						const float weight = std::min(end, s + 1.0f) - std::max(begin, (float)s);
+						for (int c = 0; c < CHANNELS; ++c)
+							sum[c] += weight * in[s * sourcePixelStride + c];
+					}
+					for (int c = 0; c < CHANNELS; ++c)
+						sum[c] /= scale;
+				}
+				else
+				{
+					const float position = std::max((i + 0.5f) * scale - 0.5f, 0.0f);
+					const int s0 = std::min((int)position, sourceCount - 1);
+					const int s1 = std::min(s0 + 1, sourceCount - 1);
+					const float t = position - s0;
+					for (int c = 0; c < CHANNELS; ++c)
+						sum[c] = in[s0 * sourcePixelStride + c] * (1.0f - t) + in[s1 * sourcePixelStride + c] * t;
+				}
+				for (int c = 0; c < CHANNELS; ++c)
+					out[i * targetPixelStride + c] = sum[c];
+			}
+		}
+	}
+
+	// Scale an RGBA image to size x size, flipped so the first row is the bottom one as GL expects
+	void ResizeLayer(const unsigned char* image, int width, int height, int size, std::vector<unsigned char>& layer)
+	{
+		std::vector<unsigned char> scaled;
+		ResizeImage(image, width, height, size, size, scaled);
+
+		layer.resize(scaled.size());
+		const size_t rowBytes = size * CHANNELS;
+		for (int y = 0; y < size; ++y)
+			std::copy_n(&scaled[(size - 1 - y) * rowBytes], rowBytes, &layer[y * rowBytes]);
+	}
+}
+
+///////////////////////////////////////////////////
+//	CreateTextureArray(const char* const*, int, const TextureImage*, int, int, GLuint&)
+//
+//	filenames: images of the layers, layer i is filenames[i]
+//	images: layers count + i, after the files
+//	textureId: receives the texture name
+//
+//	Every file is read twice, once for its size
+//	and once to fill its layer, so only one decoded
+//	image is held at a time
+///////////////////////////////////////////////////
+bool CreateTextureArray(const char* const* filenames, int count, const TextureImage* images, int imageCount, int maxSize, GLuint& textureId)
+{
+	int largest = 1;
+	for (int i = 0; i < count; ++i)
+	{
+		int width, height, channels;
+		if (!stbi_info(filenames[i], &width, &height, &channels))
+		{
+			std::cout << "ERROR::TEXTURE_ARRAY::IMAGE_NOT_LOADED " << filenames[i] << std::endl;
+			return false;
+		}
+		largest = std::max(largest, std::max(width, height));
+	}
+	for (int i = 0; i < imageCount; ++i)
+		largest = std::max(largest, std::max(images[i].width, images[i].height));
+
+	int size = 1;
+	while (size < largest && size < maxSize)
+		size *= 2;
+	int levels = 1;
+	while ((size >> levels) > 0)
+		++levels;
+
+	glGenTextures(1, &textureId);
+	GLState().BindTexture(0, GL_TEXTURE_2D_ARRAY, textureId);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, size, size, count + imageCount);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	std::vector<unsigned char> layer;
+	for (int i = 0; i < count; ++i)
+	{
+		int width, height, channels;
+		unsigned char* image = stbi_load(filenames[i], &width, &height, &channels, CHANNELS);
+		if (image == nullptr)
+		{
+			std::cout << "ERROR::TEXTURE_ARRAY::IMAGE_NOT_LOADED " << filenames[i] << std::endl;
+			DestroyTextureArray(textureId);
+			return false;
+		}
+		ResizeLayer(image, width, height, size, layer);
+		stbi_image_free(image);
+
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, layer.data());
+	}
+	for (int i = 0; i < imageCount; ++i)
+	{
+		ResizeLayer(images[i].pixels, images[i].width, images[i].height, size, layer);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, count + i, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, layer.data());
+	}
+
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+	std::cout << "INFO: Texture array of " << count + imageCount << " layers, " << size << "x" << size << std::endl;
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	DestroyTextureArray(GLuint)
+///////////////////////////////////////////////////
+void DestroyTextureArray(GLuint textureId)
+{
+	glDeleteTextures(1, &textureId);
+}
+
+///////////////////////////////////////////////////
+//	CreateImageTexture(const TextureImage&, GLuint&)
+//
+//	The rows are flipped so that v = 0 is the last
+//	row of the image, as in the array layers
+///////////////////////////////////////////////////
+bool CreateImageTexture(const TextureImage& image, GLuint& textureId)
+{
+	if (image.pixels == nullptr || image.width <= 0 || image.height <= 0)
+	{
+		std::cout << "ERROR::TEXTURE_ARRAY::EMPTY_IMAGE" << std::endl;
+		return false;
+	}
+
+	std::vector<unsigned char> flipped((size_t)image.width * image.height * CHANNELS);
+	const size_t rowBytes = image.width * CHANNELS;
+	for (int y = 0; y < image.height; ++y)
+		std::copy_n(&image.pixels[(image.height - 1 - y) * rowBytes], rowBytes, &flipped[y * rowBytes]);
+
+	int levels = 1;
+	while ((std::max(image.width, image.height) >> levels) > 0)
+		++levels;
+
+	glGenTextures(1, &textureId);
+	GLState().BindTexture(0, GL_TEXTURE_2D, textureId);
+	glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, image.width, image.height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, flipped.data());
+	glGenerateMipmap(GL_TEXTURE_2D);
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	ResizeImage(const unsigned char*, int, int, int, int, vector<unsigned char>&)
+//
+//	Rows are resampled first, then columns. The
+//	image is returned unchanged when the size is
+//	already right.
+///////////////////////////////////////////////////
+void ResizeImage(const unsigned char* image, int width, int height, int targetWidth, int targetHeight, std::vector<unsigned char>& target)
+{
+	if (width == targetWidth && height == targetHeight)
+	{
+		target.assign(image, image + width * height * CHANNELS);
+		return;
+	}
+
+	std::vector<float> source(image, image + width * height * CHANNELS);
+	std::vector<float> rows(targetWidth * height * CHANNELS);
+	ResampleAxis(source, width, rows, targetWidth, height, width * CHANNELS, targetWidth * CHANNELS, CHANNELS, CHANNELS);
+	std::vector<float> columns(targetWidth * targetHeight * CHANNELS);
+	ResampleAxis(rows, height, columns, targetHeight, targetWidth, CHANNELS, CHANNELS, targetWidth * CHANNELS, targetWidth * CHANNELS);
+
+	target.resize(columns.size());
+	for (size_t i = 0; i < columns.size(); ++i)
+		target[i] = (unsigned char)std::min(std::max(columns[i] + 0.5f, 0.0f), 255.0f);
+}
@@ -0,0 +1,45 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearray.h
+// ========
+// scene textures loaded as the layers of one GL_TEXTURE_2D_ARRAY
+//
+//	Every image is converted to RGBA and resampled to the same square size,
+//	so images of any size and channel count become layers of one texture.
+//	The UVs of the meshes cover the whole image, so stretching an image to
+//	the square keeps its mapping. Objects pick their layer through
+//	SceneObject::textureLayer, and every textured draw of the frame shares
+//	the one texture binding. Images built in memory, such as the label
+//	atlas (see textureatlas.h), are added after the files.
+//
+//	Where array textures are missing or slow, an image in memory can be
+//	uploaded as a plain GL_TEXTURE_2D instead, sampled by sampler2D
+//	programs.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+// Largest layer size, bigger images are scaled down to it
+const int TEXTURE_ARRAY_MAX_SIZE = 1024;
+
+// RGBA image held in memory, rows from the top as stb_image returns them
+struct TextureImage
+{
+	const unsigned char* pixels;
+	int width;
+	int height;
+};
+
+// Load the files, then the images, in order, as the layers of a new array texture with mipmaps.
+// Layers take the largest image dimension rounded up to a power of two, at most maxSize.
+bool CreateTextureArray(const char* const* filenames, int count, const TextureImage* images, int imageCount, int maxSize, GLuint& textureId);
+void DestroyTextureArray(GLuint textureId);
+
+// Upload an image as a new GL_TEXTURE_2D with mipmaps, for the programs without texture arrays
+bool CreateImageTexture(const TextureImage& image, GLuint& textureId);
+
+// Scale an RGBA image to targetWidth x targetHeight, the rows keep their order
+void ResizeImage(const unsigned char* image, int width, int height, int targetWidth, int targetHeight, std::vector<unsigned char>& target);
@@ -0,0 +1,249 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureatlas.cpp
+// ========
+// small images packed side by side into one texture image
+///////////////////////////////////////////////////////////////////////////////
+
+#include "textureatlas.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "stb_image.h"
+
+namespace
+{
+	const int CHANNELS = 4;
+
+	int RoundUp(int value, int multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+}
+
+SkylinePacker::SkylinePacker()
+	: mWidth(0), mHeight(0), mUsedArea(0)
+{
+}
+
+///////////////////////////////////////////////////
+//	Reset(int, int)
+//
+//	The skyline starts as one segment at height 0
+///////////////////////////////////////////////////
+void SkylinePacker::Reset(int width, int height)
+{
+	mWidth = width;
+	mHeight = height;
+	mUsedArea = 0;
+	mSkyline.clear();
+	mSkyline.push_back({ 0, 0, width });
+}
+
+///////////////////////////////////////////////////
+//	FitAt(size_t, int, int)
+//
+//	A rectangle starting at a segment rests on the
+//	highest of the segments under its width
+///////////////////////////////////////////////////
+int SkylinePacker::FitAt(size_t index, int width, int height) const
+{
+	if (mSkyline[index].x + width > mWidth)
+		return -1;
+
+	int y = 0;
+	int remaining = width;
+	for (size_t i = index; remaining > 0; ++i)
+	{
+		y = std::max(y, mSkyline[i].y);
+		if (y + height > mHeight)
+			return -1;
+		remaining -= mSkyline[i].width;
+	}
+	return y;
+}
+
+///////////////////////////////////////////////////
+//	Insert(int, int, int&, int&)
+//
+//	Picks the segment where the top of the
+//	rectangle ends lowest, the narrowest segment on
+//	a tie, then raises the skyline under it
+///////////////////////////////////////////////////
+bool SkylinePacker::Insert(int width, int height, int& x, int& y)
+{
+	size_t best = mSkyline.size();
+	int bestY = 0;
+	int bestTop = mHeight + 1;
+	int bestWidth = mWidth + 1;
+	for (size_t i = 0; i < mSkyline.size(); ++i)
+	{
+		const int fitY = FitAt(i, width, height);
+		if (fitY < 0)
+			continue;
+		if (fitY + height < bestTop || (fitY + height == bestTop && mSkyline[i].width < bestWidth))
+		{
+			best = i;
+			bestY = fitY;
+			bestTop = fitY + height;
+			bestWidth = mSkyline[i].width;
+		}
+	}
+	if (best == mSkyline.size())
+		return false;
+
+	x = mSkyline[best].x;
+	y = bestY;
+
+	// The new segment covers the start of the ones it rests on
+	const Segment placed = { x, bestTop, width };
+	mSkyline.insert(mSkyline.begin() + best, placed);
+	const int placedEnd = placed.x + placed.width;
+	for (size_t i = best + 1; i < mSkyline.size() && mSkyline[i].x < placedEnd; )
+	{
+		Segment& segment = mSkyline[i];
+		const int covered = placedEnd - segment.x;
+		if (segment.width <= covered)
+		{
+			mSkyline.erase(mSkyline.begin() + i);
+			continue;
+		}
+		segment.x += covered;
+		segment.width -= covered;
+		break;
+	}
+
+	// Neighbours at the same height become one segment
+	for (size_t i = 0; i + 1 < mSkyline.size(); )
+	{
+		if (mSkyline[i].y == mSkyline[i + 1].y)
+		{
+			mSkyline[i].width += mSkyline[i + 1].width;
+			mSkyline.erase(mSkyline.begin() + i + 1);
+		}
+		else
+			++i;
+	}
+
+	mUsedArea += (long long)width * height;
+	return true;
+}
+
+TextureAtlas::TextureAtlas()
+	: mSize(0)
+{
+}
+
+///////////////////////////////////////////////////
+//	Build(const char* const*, int, int)
+//
+//	filenames: images of the atlas, GetUvRect(i)
+//	maps into filenames[i]
+//
+//	Cells are sized first from the image headers
+//	and packed tallest first. Each image is then
+//	decoded, resampled to the inside of its cell
+//	and copied with its edges repeated over the
+//	gutter.
+///////////////////////////////////////////////////
+bool TextureAtlas::Build(const char* const* filenames, int count, int size)
+{
+	struct Cell
+	{
+		int image;
+		int width;      // Including the gutter on both sides
+		int height;
+		int x;
+		int y;
+	};
+
+	const int gutter = TEXTURE_ATLAS_GUTTER;
+	const int largestInside = size / 2 - 2 * gutter;
+
+	std::vector<Cell> cells(count);
+	for (int i = 0; i < count; ++i)
+	{
+		int width, height, channels;
+		if (!stbi_info(filenames[i], &width, &height, &channels))
+		{
+			std::cout << "ERROR::TEXTURE_ATLAS::IMAGE_NOT_LOADED " << filenames[i] << std::endl;
+			return false;
+		}
+
+		const float scale = std::min(1.0f, (float)largestInside / std::max(width, height));
+		cells[i].image = i;
+		cells[i].width = RoundUp(std::max((int)(width * scale), 1) + 2 * gutter, gutter);
+		cells[i].height = RoundUp(std::max((int)(height * scale), 1) + 2 * gutter, gutter);
+	}
+
+	std::vector<Cell> order = cells;
+	std::stable_sort(order.begin(), order.end(), [](const Cell& a, const Cell& b) { return a.height > b.height; });
+
+	SkylinePacker packer;
+	packer.Reset(size, size);
+	for (const Cell& cell : order)
+	{
+		if (!packer.Insert(cell.width, cell.height, cells[cell.image].x, cells[cell.image].y))
+		{
+			std::cout << "ERROR::TEXTURE_ATLAS::DOES_NOT_FIT " << filenames[cell.image] << std::endl;
+			return false;
+		}
+	}
+
+	mSize = size;
+	mPixels.assign((size_t)size * size * CHANNELS, 0);
+	mUvRects.resize(count);
+
+	std::vector<unsigned char> inside;
+	for (const Cell& cell : cells)
+	{
+		int width, height, channels;
+		unsigned char* image = stbi_load(filenames[cell.image], &width, &height, &channels, CHANNELS);
+		if (image == nullptr)
+		{
+			std::cout << "ERROR::TEXTURE_ATLAS::IMAGE_NOT_LOADED " << filenames[cell.image] << std::endl;
+			return false;
+		}
+		const int insideWidth = cell.width - 2 * gutter;
+		const int insideHeight = cell.height - 2 * gutter;
+		ResizeImage(image, width, height, insideWidth, insideHeight, inside);
+		stbi_image_free(image);
+
+		// The gutter repeats the nearest edge pixel
+		for (int y = 0; y < cell.height; ++y)
+		{
+			const int sourceY = std::min(std::max(y - gutter, 0), insideHeight - 1);
+			unsigned char* out = &mPixels[((size_t)(cell.y + y) * size + cell.x) * CHANNELS];
+			for (int x = 0; x < cell.width; ++x)
+			{
+				const int sourceX = std::min(std::max(x - gutter, 0), insideWidth - 1);
+				std::copy_n(&inside[((size_t)sourceY * insideWidth + sourceX) * CHANNELS], CHANNELS, &out[x * CHANNELS]);
+			}
+		}
+
+		// Rows are stored from the top and flipped on upload, v = 0 is the bottom row of the cell
+		mUvRects[cell.image] = glm::vec4((float)insideWidth / size, (float)insideHeight / size,
+			(float)(cell.x + gutter) / size, (float)(size - cell.y - gutter - insideHeight) / size);
+	}
+
+	std::cout << "INFO: Texture atlas of " << count << " images, " << size << "x" << size << ", "
+		<< packer.GetUsedArea() * 100 / ((long long)size * size) << "% used" << std::endl;
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	GetImage()
+///////////////////////////////////////////////////
+TextureImage TextureAtlas::GetImage() const
+{
+	TextureImage image = { mPixels.data(), mSize, mSize };
+	return image;
+}
+
+///////////////////////////////////////////////////
+//	ReleasePixels()
+///////////////////////////////////////////////////
+void TextureAtlas::ReleasePixels()
+{
+	std::vector<unsigned char>().swap(mPixels);
+}
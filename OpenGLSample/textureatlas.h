@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureatlas.h
+// ========
+// small images packed side by side into one texture image
+//
+//	The label textures are a few hundred pixels each and only ever cover
+//	their mesh once, so they do not need a layer each. They are packed by
+//	a skyline bin packer into one square image that becomes a single layer
+//	of the scene texture array (see texturearray.h), or a GL_TEXTURE_2D of
+//	its own when the texture array is off. Objects sample their image
+//	through its UV rect, a scale and an offset that become the uvScale of
+//	the object (see SceneObject::uvScale), so labelled objects share layer
+//	and texture state and can be drawn in the same batches.
+//
+//	Each image is surrounded by a gutter of copies of its edge pixels, and
+//	cells start on multiples of the gutter. Down to the mip level where the
+//	gutter shrinks to one texel, filtering never mixes two images.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "texturearray.h"
+
+// Edge pixels kept around every image, protects log2(8) = 3 mip levels
+const int TEXTURE_ATLAS_GUTTER = 8;
+
+// Bottom-left skyline packer. The packed area is tracked as the height it
+// reaches along x, one segment per run of equal height, so a rectangle is
+// placed where it rests lowest.
+class SkylinePacker
+{
+public:
+	SkylinePacker();
+
+	// Start over with an empty width x height area
+	void Reset(int width, int height);
+
+	// Place a rectangle, false when no room is left for it
+	bool Insert(int width, int height, int& x, int& y);
+
+	// Pixels covered by the inserted rectangles
+	long long GetUsedArea() const { return mUsedArea; }
+
+private:
+	struct Segment
+	{
+		int x;
+		int y;          // Height of the packed area over [x, x + width)
+		int width;
+	};
+
+	// Lowest y at which a rectangle starting at segment index fits, -1 if it does not
+	int FitAt(size_t index, int width, int height) const;
+
+	std::vector<Segment> mSkyline;
+	int mWidth;
+	int mHeight;
+	long long mUsedArea;
+};
+
+class TextureAtlas
+{
+public:
+	TextureAtlas();
+
+	// Pack the images into a size x size atlas. An image larger than half
+	// the atlas is scaled down to fit in half, keeping its aspect ratio.
+	bool Build(const char* const* filenames, int count, int size);
+
+	// Atlas pixels, RGBA rows from the top, for CreateTextureArray or CreateImageTexture
+	TextureImage GetImage() const;
+
+	// xy scale and zw offset taking the 0..1 UVs of an image to its cell,
+	// with v pointing up as in the GL texture
+	glm::vec4 GetUvRect(int image) const { return mUvRects[image]; }
+
+	int GetSize() const { return mSize; }
+
+	// Drop the pixels once they are uploaded, the UV rects stay
+	void ReleasePixels();
+
+private:
+	int mSize;
+	std::vector<unsigned char> mPixels;
+	std::vector<glm::vec4> mUvRects;
+};
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniforms.cpp
+// ========
+// cache of the uniform locations used by the scene shader programs
+///////////////////////////////////////////////////////////////////////////////
+
+#include "uniforms.h"
+
+namespace
+{
+	// Number of glGetUniformLocation calls made through QueryUniformLocation
+	unsigned int gUniformQueryCount = 0;
+}
+
+///////////////////////////////////////////////////
+//	CreateUniformLayout(GLuint, UniformLayout&)
+//
+//	programId: linked shader program
+//	layout: reference to the location table to fill
+//
+//	Look up every uniform once. Uniforms that the
+//	linker optimized away are stored as -1, which
+//	glUniform* silently ignores.
+///////////////////////////////////////////////////
+void CreateUniformLayout(GLuint programId, UniformLayout& layout)
+{
+	layout.model = QueryUniformLocation(programId, "model");
+	layout.uvScale = QueryUniformLocation(programId, "uvScale");
+	layout.objectColor = QueryUniformLocation(programId, "objectColor");
+	layout.uTexture = QueryUniformLocation(programId, "uTexture");
+	layout.uTextureLayer = QueryUniformLocation(programId, "uTextureLayer");
+	layout.ubHasTexture = QueryUniformLocation(programId, "ubHasTexture");
+	layout.specularIntensity1 = QueryUniformLocation(programId, "specularIntensity1");
+	layout.highlightSize1 = QueryUniformLocation(programId, "highlightSize1");
+	layout.specularIntensity2 = QueryUniformLocation(programId, "specularIntensity2");
+	layout.highlightSize2 = QueryUniformLocation(programId, "highlightSize2");
+}
+
+///////////////////////////////////////////////////
+//	QueryUniformLocation(GLuint, const char*)
+//
+//	Counted wrapper around glGetUniformLocation
+///////////////////////////////////////////////////
+GLint QueryUniformLocation(GLuint programId, const char* name)
+{
+	++gUniformQueryCount;
+	return glGetUniformLocation(programId, name);
+}
+
+///////////////////////////////////////////////////
+//	GetUniformQueryCount()
+//
+//	Total location queries issued so far
+///////////////////////////////////////////////////
+unsigned int GetUniformQueryCount()
+{
+	return gUniformQueryCount;
+}
@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniforms.h
+// ========
+// cache of the uniform locations used by the scene shader programs
+//
+//	The locations are resolved once when a program is linked, so the render
+//	loop never has to perform a string lookup in the driver. Per-frame values
+//	live in the FrameBlock uniform buffer (see shaderblocks.h) instead.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+// Uniform locations for a program built from the Phong scene shaders
+struct UniformLayout
+{
+	// Vertex shader
+	GLint model;
+	GLint uvScale;
+
+	// Fragment shader
+	GLint objectColor;
+	GLint uTexture;
+	GLint uTextureLayer;
+	GLint ubHasTexture;
+	GLint specularIntensity1;
+	GLint highlightSize1;
+	GLint specularIntensity2;
+	GLint highlightSize2;
+};
+
+// Resolve every location in the layout for a linked program
+void CreateUniformLayout(GLuint programId, UniformLayout& layout);
+
+// glGetUniformLocation wrapper that counts every query issued to the driver
+GLint QueryUniformLocation(GLuint programId, const char* name);
+
+// Total number of location queries issued since startup
+unsigned int GetUniformQueryCount();
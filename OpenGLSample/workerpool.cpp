@@ -0,0 +1,585 @@
+///////////////////////////////////////////////////////////////////////////////
+// workerpool.cpp
+// ========
+// work-stealing job system running the frame stages on a fixed set of threads
+///////////////////////////////////////////////////////////////////////////////
+
+#include "workerpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+	// Slot of the calling thread in the pool, 0 for the thread that started it
+	thread_local int tThreadIndex = 0;
+
+	// Chase-Lev deque of fixed capacity ("Dynamic Circular Work-Stealing
+	// Deque", with the C11 orderings of Le et al.). Only the owner calls Push
+	// and Pop, any thread may call Steal.
+	class JobDeque
+	{
+	public:
+		JobDeque()
+			: mTop(0), mBottom(0)
+		{
+			for (size_t i = 0; i < WorkerPool::MAX_JOBS; ++i)
+				mJobs[i].store(nullptr, std::memory_order_relaxed);
+		}
+
+		// False when full
+		bool Push(Job* job)
+		{
+			const int64_t bottom = mBottom.load(std::memory_order_relaxed);
+			const int64_t top = mTop.load(std::memory_order_acquire);
+			if (bottom - top >= (int64_t)WorkerPool::MAX_JOBS)
+				return false;
+
+			// Release on the slot too, so a thief reading the job also sees its fields
+			mJobs[bottom & MASK].store(job, std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_release);
+			mBottom.store(bottom + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		// Newest job, null when empty or the last one was stolen meanwhile
+		Job* Pop()
+		{
+			const int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+			mBottom.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t top = mTop.load(std::memory_order_relaxed);
+
+			if (top > bottom)
+			{
+				mBottom.store(bottom + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			Job* job = mJobs[bottom & MASK].load(std::memory_order_relaxed);
+			if (top == bottom)
+			{
+				// Last job, race the thieves for it
+				if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					job = nullptr;
+				mBottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		// Oldest job, null when empty or another thread took it first
+		Job* Steal()
+		{
+			int64_t top = mTop.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t bottom = mBottom.load(std::memory_order_acquire);
+			if (top >= bottom)
+				return nullptr;
+
+			Job* job = mJobs[top & MASK].load(std::memory_order_acquire);
+			if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return nullptr;
+			return job;
+		}
+
+	private:
+		static const int64_t MASK = (int64_t)WorkerPool::MAX_JOBS - 1;
+
+		// Thieves and owner each write their own cache line
+		std::atomic<int64_t> mTop;
+		char mPadding[64];
+		std::atomic<int64_t> mBottom;
+		std::atomic<Job*> mJobs[WorkerPool::MAX_JOBS];
+	};
+
+	// Loop shared by the jobs of one ParallelFor
+	struct ParallelLoop
+	{
+		const WorkerPool::Body* body;
+		size_t count;
+		size_t grain;
+	};
+}
+
+struct WorkerPool::ThreadState
+{
+	JobDeque deque;
+	Job jobs[MAX_JOBS];     // Ring the thread creates its jobs in, zeroed so every slot starts free
+	size_t nextJob;
+};
+
+JobCounter::JobCounter()
+	: mPending(0), mFinishing(0), mWaiting(nullptr)
+{
+}
+
+WorkerPool::WorkerPool()
+	: mQueued(0), mSleeping(0), mQuit(false)
+{
+	mThreads.push_back(std::unique_ptr<ThreadState>(new ThreadState()));
+	mThreads[0]->nextJob = 0;
+}
+
+WorkerPool::~WorkerPool()
+{
+	Stop();
+}
+
+///////////////////////////////////////////////////
+//	Start(int)
+//
+//	threads: threads running jobs, counting the
+//	caller. 1 or less starts no worker.
+///////////////////////////////////////////////////
+void WorkerPool::Start(int threads)
+{
+	Stop();
+	mQuit = false;
+	for (int i = 1; i < threads; ++i)
+	{
+		mThreads.push_back(std::unique_ptr<ThreadState>(new ThreadState()));
+		mThreads.back()->nextJob = 0;
+	}
+	for (int i = 1; i < threads; ++i)
+		mWorkers.push_back(std::thread(&WorkerPool::WorkerLoop, this, i));
+}
+
+///////////////////////////////////////////////////
+//	Stop()
+///////////////////////////////////////////////////
+void WorkerPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWake.notify_all();
+
+	for (std::thread& worker : mWorkers)
+		worker.join();
+	mWorkers.clear();
+	mThreads.resize(1);
+}
+
+///////////////////////////////////////////////////
+//	CreateJob(JobFunction, void*, size_t, size_t)
+//
+//	Take the next free slot of the ring. Slots still
+//	in use are skipped rather than waited for, since
+//	their job may be one suspended below the caller
+//	in a nested wait. With every slot in use, the
+//	caller helps like Wait until one is freed.
+///////////////////////////////////////////////////
+Job* WorkerPool::CreateJob(JobFunction function, void* data, size_t begin, size_t end)
+{
+	ThreadState& state = *mThreads[tThreadIndex];
+	Job* job = nullptr;
+	for (;;)
+	{
+		for (size_t i = 0; i < MAX_JOBS && job == nullptr; ++i)
+		{
+			Job* slot = &state.jobs[state.nextJob];
+			state.nextJob = (state.nextJob + 1) % MAX_JOBS;
+			if (!slot->inUse.load(std::memory_order_acquire))
+				job = slot;
+		}
+		if (job)
+			break;
+
+		Job* other = FindJob();
+		if (other)
+			Execute(other);
+		else
+			std::this_thread::yield();
+	}
+	job->inUse.store(true, std::memory_order_relaxed);
+
+	job->function = function;
+	job->data = data;
+	job->begin = begin;
+	job->end = end;
+	job->counter = nullptr;
+	job->nextWaiting = nullptr;
+	return job;
+}
+
+///////////////////////////////////////////////////
+//	Run(Job*, JobCounter&)
+///////////////////////////////////////////////////
+void WorkerPool::Run(Job* job, JobCounter& counter)
+{
+	job->counter = &counter;
+	counter.mPending.fetch_add(1);
+	Push(job);
+}
+
+///////////////////////////////////////////////////
+//	RunAfter(Job*, JobCounter&, JobCounter&)
+//
+//	The check and the append share the lock Finish
+//	takes to release the waiting jobs, so a job is
+//	either queued here or released there
+///////////////////////////////////////////////////
+void WorkerPool::RunAfter(Job* job, JobCounter& counter, JobCounter& dependency)
+{
+	job->counter = &counter;
+	counter.mPending.fetch_add(1);
+
+	{
+		std::lock_guard<std::mutex> lock(dependency.mMutex);
+		if (dependency.mPending.load() != 0)
+		{
+			job->nextWaiting = dependency.mWaiting;
+			dependency.mWaiting = job;
+			return;
+		}
+	}
+	Push(job);
+}
+
+///////////////////////////////////////////////////
+//	Wait(JobCounter&)
+//
+//	The caller keeps running jobs, its own first,
+//	so a wait inside a job cannot starve the pool
+///////////////////////////////////////////////////
+void WorkerPool::Wait(JobCounter& counter)
+{
+	while (!counter.IsDone())
+	{
+		Job* job = FindJob();
+		if (job)
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+///////////////////////////////////////////////////
+//	GetChunkCount(size_t, size_t)
+///////////////////////////////////////////////////
+size_t WorkerPool::GetChunkCount(size_t count, size_t grain)
+{
+	return (count + grain - 1) / grain;
+}
+
+///////////////////////////////////////////////////
+//	ParallelFor(size_t, size_t, const Body&)
+//
+//	count: items of the loop
+//	grain: items per chunk, large enough that a
+//	chunk costs much more than a job
+//
+//	A loop of one chunk, or a pool without workers,
+//	runs inline without creating any job
+///////////////////////////////////////////////////
+void WorkerPool::ParallelFor(size_t count, size_t grain, const Body& body)
+{
+	grain = std::max(grain, (size_t)1);
+	const size_t chunks = GetChunkCount(count, grain);
+	if (mWorkers.empty() || chunks <= 1)
+	{
+		for (size_t c = 0; c < chunks; ++c)
+			body(c * grain, std::min(count, (c + 1) * grain), c);
+		return;
+	}
+
+	ParallelLoop loop = { &body, count, grain };
+	JobCounter counter;
+	Run(CreateJob(&WorkerPool::RunChunks, &loop, 0, chunks), counter);
+	Wait(counter);
+}
+
+///////////////////////////////////////////////////
+//	RunChunks(WorkerPool&, const Job&)
+//
+//	Job of ParallelFor over chunks [begin, end).
+//	Halving leaves large ranges at the top of the
+//	deque for thieves, and at most log2(chunks) jobs
+//	of a loop queued per thread.
+///////////////////////////////////////////////////
+void WorkerPool::RunChunks(WorkerPool& pool, const Job& job)
+{
+	const ParallelLoop& loop = *(const ParallelLoop*)job.data;
+	size_t begin = job.begin;
+	size_t end = job.end;
+	while (end - begin > 1)
+	{
+		const size_t middle = begin + (end - begin) / 2;
+		pool.Run(pool.CreateJob(&WorkerPool::RunChunks, job.data, middle, end), *job.counter);
+		end = middle;
+	}
+
+	(*loop.body)(begin * loop.grain, std::min(loop.count, (begin + 1) * loop.grain), begin);
+}
+
+///////////////////////////////////////////////////
+//	WorkerLoop(int)
+//
+//	Body of the worker threads: run jobs while any
+//	are queued, sleep otherwise
+///////////////////////////////////////////////////
+void WorkerPool::WorkerLoop(int index)
+{
+	tThreadIndex = index;
+	for (;;)
+	{
+		Job* job = FindJob();
+		if (job)
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		if (mQuit)
+			return;
+		mSleeping.fetch_add(1);
+		mWake.wait(lock, [this] { return mQueued.load() > 0 || mQuit; });
+		mSleeping.fetch_sub(1);
+		if (mQuit)
+			return;
+	}
+}
+
+///////////////////////////////////////////////////
+//	Push(Job*)
+//
+//	Queue on the calling thread's deque, or run
+//	right away when it is full. A sleeping worker
+//	is woken under the lock it checks mQueued with,
+//	so the wake-up cannot fall between its check
+//	and its wait.
+///////////////////////////////////////////////////
+void WorkerPool::Push(Job* job)
+{
+	if (!mThreads[tThreadIndex]->deque.Push(job))
+	{
+		Execute(job);
+		return;
+	}
+
+	mQueued.fetch_add(1);
+	if (mSleeping.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+		}
+		mWake.notify_one();
+	}
+}
+
+///////////////////////////////////////////////////
+//	FindJob()
+//
+//	Own deque first, then steal from the others,
+//	starting past the calling thread so thieves
+//	spread over the victims
+///////////////////////////////////////////////////
+Job* WorkerPool::FindJob()
+{
+	const size_t threads = mThreads.size();
+	const size_t self = (size_t)tThreadIndex;
+
+	Job* job = mThreads[self]->deque.Pop();
+	for (size_t i = 1; job == nullptr && i < threads; ++i)
+		job = mThreads[(self + i) % threads]->deque.Steal();
+
+	if (job)
+		mQueued.fetch_sub(1);
+	return job;
+}
+
+///////////////////////////////////////////////////
+//	Execute(Job*)
+//
+//	The slot is released before the counter, so a
+//	thread done waiting finds its slots free again
+///////////////////////////////////////////////////
+void WorkerPool::Execute(Job* job)
+{
+	JobCounter& counter = *job->counter;
+	job->function(*this, *job);
+	job->inUse.store(false, std::memory_order_release);
+	Finish(counter);
+}
+
+///////////////////////////////////////////////////
+//	Finish(JobCounter&)
+//
+//	mFinishing keeps IsDone false until the thread
+//	that made the count zero has released the jobs
+//	waiting on it. The counter may be destroyed as
+//	soon as mFinishing is decremented.
+///////////////////////////////////////////////////
+void WorkerPool::Finish(JobCounter& counter)
+{
+	counter.mFinishing.fetch_add(1);
+	if (counter.mPending.fetch_sub(1) == 1)
+	{
+		Job* waiting;
+		{
+			std::lock_guard<std::mutex> lock(counter.mMutex);
+			waiting = counter.mWaiting;
+			counter.mWaiting = nullptr;
+		}
+		while (waiting)
+		{
+			Job* next = waiting->nextWaiting;
+			Push(waiting);
+			waiting = next;
+		}
+	}
+	counter.mFinishing.fetch_sub(1);
+}
+
+///////////////////////////////////////////////////
+//	RunJobStressTest()
+//
+//	On 1 and 8 threads, check that each of more
+//	jobs than one ring holds, all queued before a
+//	single wait, runs exactly once, and that loops
+//	nested inside a loop add up. Both overflow the
+//	ring of the thread creating the jobs.
+///////////////////////////////////////////////////
+bool RunJobStressTest()
+{
+	const int threadCounts[] = { 1, 8 };
+	const size_t jobCount = WorkerPool::MAX_JOBS * 3 + 1;
+	const size_t outerCount = 100000;
+	const size_t outerGrain = 64;
+	const size_t innerCount = 256;
+	const size_t innerGrain = 16;
+
+	bool passed = true;
+	for (int threads : threadCounts)
+	{
+		WorkerPool pool;
+		pool.Start(threads);
+
+		std::vector<std::atomic<int>> runs(jobCount);
+		for (std::atomic<int>& run : runs)
+			run.store(0);
+		JobCounter counter;
+		for (size_t j = 0; j < jobCount; ++j)
+		{
+			pool.Run(pool.CreateJob([](WorkerPool&, const Job& job)
+			{
+				(*(std::vector<std::atomic<int>>*)job.data)[job.begin].fetch_add(1);
+			}, &runs, j, j + 1), counter);
+		}
+		pool.Wait(counter);
+
+		size_t wrongRuns = 0;
+		for (const std::atomic<int>& run : runs)
+			wrongRuns += run.load() != 1;
+
+		// Every outer item adds the sum of 0..innerCount-1
+		std::vector<uint64_t> chunkSums(WorkerPool::GetChunkCount(outerCount, outerGrain), 0);
+		pool.ParallelFor(outerCount, outerGrain, [&](size_t begin, size_t end, size_t chunk)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				std::vector<uint64_t> innerSums(WorkerPool::GetChunkCount(innerCount, innerGrain), 0);
+				pool.ParallelFor(innerCount, innerGrain, [&](size_t innerBegin, size_t innerEnd, size_t innerChunk)
+				{
+					for (size_t k = innerBegin; k < innerEnd; ++k)
+						innerSums[innerChunk] += k;
+				});
+				for (uint64_t sum : innerSums)
+					chunkSums[chunk] += sum;
+			}
+		});
+		uint64_t total = 0;
+		for (uint64_t sum : chunkSums)
+			total += sum;
+		const uint64_t expected = (uint64_t)outerCount * (innerCount * (innerCount - 1) / 2);
+
+		const bool ok = wrongRuns == 0 && total == expected;
+		std::cout << "Job system stress test on " << threads << " threads: " << wrongRuns << " of " << jobCount
+			<< " jobs not run exactly once, nested loops " << (total == expected ? "add up" : "WRONG") << std::endl;
+		if (!ok)
+			std::cout << "ERROR::JOBS::STRESS_TEST_FAILED" << std::endl;
+		passed = passed && ok;
+	}
+	return passed;
+}
+
+///////////////////////////////////////////////////
+//	RunJobBenchmark()
+//
+//	For 1, 2, 4, 8 and 16 threads, time batches of
+//	empty jobs started and waited for by the main
+//	thread, then a loop of 1M small transforms split
+//	in chunks of 1024. Thread counts above the core
+//	count only show the cost of oversubscription.
+///////////////////////////////////////////////////
+void RunJobBenchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const int threadCounts[] = { 1, 2, 4, 8, 16 };
+	const int batches = 200;
+	const int jobsPerBatch = 1000;
+	const size_t loopCount = 1000000;
+	const size_t loopGrain = 1024;
+	const int loops = 20;
+
+	std::vector<glm::vec4> points(loopCount, glm::vec4(1.0f, 2.0f, 3.0f, 1.0f));
+	std::vector<glm::vec4> results(loopCount);
+	const glm::mat4 transform(0.5f);
+
+	std::cout << "Job system benchmark, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(14) << "ns per job" << std::setw(16) << "ns per chunk"
+		<< std::setw(12) << "loop ms" << std::setw(10) << "speedup" << std::endl;
+
+	double singleThreadLoop = 0.0;
+	for (int threads : threadCounts)
+	{
+		WorkerPool pool;
+		pool.Start(threads);
+
+		// Job creation, queueing, stealing and the wait, with nothing to run
+		auto empty = [] {};
+		Clock::time_point start = Clock::now();
+		for (int b = 0; b < batches; ++b)
+		{
+			JobCounter counter;
+			for (int j = 0; j < jobsPerBatch; ++j)
+				pool.Run(pool.CreateJob(empty), counter);
+			pool.Wait(counter);
+		}
+		const double jobTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (batches * jobsPerBatch);
+
+		// Same through ParallelFor, one item per chunk
+		start = Clock::now();
+		for (int b = 0; b < batches; ++b)
+			pool.ParallelFor(jobsPerBatch, 1, [](size_t, size_t, size_t) {});
+		const double chunkTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (batches * jobsPerBatch);
+
+		start = Clock::now();
+		for (int l = 0; l < loops; ++l)
+		{
+			pool.ParallelFor(loopCount, loopGrain, [&](size_t begin, size_t end, size_t)
+			{
+				for (size_t i = begin; i < end; ++i)
+					results[i] = transform * (transform * points[i]);
+			});
+		}
+		const double loopTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / loops;
+		if (threads == 1)
+			singleThreadLoop = loopTime;
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< std::setw(8) << threads << std::setw(14) << jobTime << std::setw(16) << chunkTime
+			<< std::setw(12) << std::setprecision(2) << loopTime << std::setw(10) << singleThreadLoop / loopTime << std::endl;
+	}
+
+	// Keeps the loop from being optimized away
+	if (results[loopCount - 1].w != 0.25f)
+		std::cout << "WARNING: unexpected loop result" << std::endl;
+}
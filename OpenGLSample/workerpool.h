@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////
+// workerpool.h
+// ========
+// work-stealing job system running the frame stages on a fixed set of threads
+//
+//	Every thread of the pool, the one that started it included, owns a
+//	Chase-Lev deque of jobs. A thread pushes and pops the bottom of its own
+//	deque without locking, and threads out of work steal from the top of
+//	the others. Jobs are taken from a ring allocated per thread, so running
+//	one costs no heap allocation. A slot is only handed out again once its
+//	job has finished. A thread whose slots are all in use runs other jobs
+//	until one frees up, so any number of jobs may be outstanding, but jobs
+//	held back by RunAfter do not free up that way: no thread may have more
+//	than MAX_JOBS of them waiting at once.
+//
+//	A job counts itself on a JobCounter while it is queued or running. Run
+//	increments the counter, the end of the job decrements it, and Wait runs
+//	other jobs until the counter drops to zero, so the waiting thread helps
+//	instead of sleeping. RunAfter holds a job back until another counter
+//	drops to zero, which chains stages without a wait in between.
+//
+//	ParallelFor cuts a range of items into chunks and hands it to one job
+//	that keeps splitting off the upper half for thieves until one chunk is
+//	left. The chunk index is passed to the body, so results written per
+//	chunk can be merged in the same order whatever thread ran them. Bodies
+//	may start loops of their own.
+//
+//	Jobs may only be started and waited for from inside jobs and from the
+//	thread that started the pool, and only that thread may touch GL.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobCounter;
+class WorkerPool;
+struct Job;
+
+typedef void (*JobFunction)(WorkerPool& pool, const Job& job);
+
+struct Job
+{
+	JobFunction function;
+	void* data;
+	size_t begin;           // Range handed to the function, free to use
+	size_t end;
+	JobCounter* counter;    // Decremented once the function returned
+	Job* nextWaiting;       // Next job held back on the same counter
+	std::atomic<bool> inUse;    // Created and not yet finished, the ring slot cannot be handed out
+};
+
+// Jobs still to finish, and the jobs to start once there are none. A
+// counter must be waited for before it goes out of scope, the thread that
+// finished its last job may still be releasing the jobs held back on it.
+class JobCounter
+{
+public:
+	JobCounter();
+
+	bool IsDone() const { return mPending.load() == 0 && mFinishing.load() == 0; }
+
+private:
+	friend class WorkerPool;
+
+	std::atomic<int> mPending;      // Jobs queued or running
+	std::atomic<int> mFinishing;    // Threads still touching the counter after a decrement
+	std::mutex mMutex;
+	Job* mWaiting;                  // Jobs started by RunAfter, pushed once mPending reaches zero
+};
+
+class WorkerPool
+{
+public:
+	// Items [begin, end) of chunk number chunk
+	typedef std::function<void(size_t begin, size_t end, size_t chunk)> Body;
+
+	// Slots of the ring each thread creates its jobs in
+	static const size_t MAX_JOBS = 4096;
+
+	WorkerPool();
+	~WorkerPool();
+
+	// Start threads - 1 workers, the calling thread is the last one
+	void Start(int threads);
+
+	// Join the workers once no job is left, jobs then run on the calling thread alone
+	void Stop();
+
+	int GetThreadCount() const { return (int)mWorkers.size() + 1; }
+
+	// A job of the calling thread's ring, valid until it finished. Runs queued
+	// jobs while every slot of the ring holds an unfinished one.
+	Job* CreateJob(JobFunction function, void* data, size_t begin = 0, size_t end = 0);
+
+	// Job calling function(), which must outlive it
+	template<typename Function>
+	Job* CreateJob(Function& function) { return CreateJob(&CallFunction<Function>, &function); }
+
+	// Queue a job counted on counter
+	void Run(Job* job, JobCounter& counter);
+
+	// Count a job on counter now, but only queue it once dependency is done.
+	// No job may be added to dependency while jobs wait on it.
+	void RunAfter(Job* job, JobCounter& counter, JobCounter& dependency);
+
+	// Run queued jobs on the calling thread until counter is done
+	void Wait(JobCounter& counter);
+
+	// Chunks of grain items needed for count items
+	static size_t GetChunkCount(size_t count, size_t grain);
+
+	// Run body over [0, count) in chunks of grain items and wait for all of them
+	void ParallelFor(size_t count, size_t grain, const Body& body);
+
+private:
+	struct ThreadState;
+
+	template<typename Function>
+	static void CallFunction(WorkerPool&, const Job& job) { (*(Function*)job.data)(); }
+
+	static void RunChunks(WorkerPool& pool, const Job& job);
+
+	void WorkerLoop(int index);
+	void Push(Job* job);
+	Job* FindJob();
+	void Execute(Job* job);
+	void Finish(JobCounter& counter);
+
+	std::vector<std::unique_ptr<ThreadState>> mThreads;    // Index 0 is the thread that started the pool
+	std::vector<std::thread> mWorkers;
+
+	// Idle workers sleep until something is queued
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::atomic<int> mQueued;       // Jobs in the deques
+	std::atomic<int> mSleeping;     // Workers waiting on mWake
+	bool mQuit;
+};
+
+// Check jobs past the capacity of a ring and nested loops, false on a wrong result
+bool RunJobStressTest();
+
+// Time the cost of a job and the scaling of a loop on 1 to 16 threads
+void RunJobBenchmark();